@@ -0,0 +1,126 @@
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+
+#include "LoanArena.h"
+
+using namespace std;
+
+LoanArena::LoanArena(size_t blockSize) :
+  blockSize_(blockSize > 0 ? blockSize : 65536),
+  first_(NULL),
+  current_(NULL),
+  offset_(0),
+  used_(0),
+  numMallocs_(0)
+{
+}
+
+LoanArena::~LoanArena()
+{
+  while(first_ != NULL)
+  {
+    Block *next = first_->next;
+    free(first_);
+    first_ = next;
+  }
+}
+
+void LoanArena::nextBlock(size_t bytes)
+{
+  Block *next = (current_ == NULL ? first_ : current_->next);
+
+  if(next == NULL || next->size < bytes)
+  {
+    size_t size = (bytes > blockSize_ ? bytes : blockSize_);
+    Block *block = (Block *) malloc(sizeof(Block) + size);
+    if(block == NULL)
+    {
+      throw bad_alloc();
+    }
+    ++numMallocs_;
+
+    // Inserted before next, so next is still reused later on
+    block->size = size;
+    block->next = next;
+    if(current_ == NULL)
+    {
+      first_ = block;
+    }
+    else
+    {
+      current_->next = block;
+    }
+    next = block;
+  }
+
+  current_ = next;
+  offset_ = 0;
+}
+
+void *LoanArena::allocate(size_t bytes, size_t align)
+{
+  size_t start = (offset_ + align - 1) & ~(align - 1);
+  if(current_ == NULL || start + bytes > current_->size)
+  {
+    // The block data is aligned for any type
+    nextBlock(bytes);
+    start = 0;
+  }
+
+  offset_ = start + bytes;
+  used_ += bytes;
+
+  return blockData(current_) + start;
+}
+
+char *LoanArena::copy(const char *str, size_t length)
+{
+  char *result = (char *) allocate(length + 1, 1);
+  memcpy(result, str, length);
+  result[length] = '\0';
+
+  return result;
+}
+
+char *LoanArena::format(const char *fmt, ...)
+{
+  // Format straight into the current block when it fits
+  char *buffer = NULL;
+  size_t available = 0;
+  if(current_ != NULL)
+  {
+    buffer = blockData(current_) + offset_;
+    available = current_->size - offset_;
+  }
+
+  va_list args;
+  va_start(args, fmt);
+  int length = vsnprintf(buffer, available, fmt, args);
+  va_end(args);
+
+  if(length < 0)
+  {
+    return copy("", 0);
+  }
+
+  if((size_t) length >= available)
+  {
+    buffer = (char *) allocate(length + 1, 1);
+
+    va_start(args, fmt);
+    vsnprintf(buffer, length + 1, fmt, args);
+    va_end(args);
+
+    return buffer;
+  }
+
+  offset_ += length + 1;
+  used_ += length + 1;
+
+  return buffer;
+}
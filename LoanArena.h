@@ -0,0 +1,87 @@
+#ifndef LOANARENA_H_INCLUDED
+#define LOANARENA_H_INCLUDED
+
+/*
+Scratch memory for one request, as in the formatted results of a
+calculation or the rows of a schedule.
+
+Allocations are taken from large blocks by bumping a pointer, and are
+never freed individually. reset() makes all of the memory available
+again in O(1): the blocks are kept and reused in the same order, so once
+a request has been served, serving a request of the same size again
+allocates nothing. getNumMallocs() counts the blocks allocated from the
+heap, it stays constant in the steady state.
+
+Only trivially destructible types should be allocated, no destructors
+are called. An arena is not thread safe, use one per thread.
+*/
+
+#include <cstddef>
+#include <new>
+
+class LoanArena
+{
+public:
+  /**
+   * blockSize is the size of the blocks allocated from the heap,
+   * larger allocations get a block of their own size
+   */
+  LoanArena(size_t blockSize = 65536);
+  ~LoanArena();
+
+  /**
+   * Uninitialized memory, aligned to align which must be a power of 2
+   */
+  void *allocate(size_t bytes, size_t align = sizeof(double));
+
+  // An array of count default constructed objects
+  template <class T>
+  T *allocateArray(size_t count)
+  {
+    void *data = allocate(count*sizeof(T), alignof(T));
+    return new(data) T[count];
+  }
+
+  // A 0 terminated copy of a string
+  char *copy(const char *str, size_t length);
+
+  // A 0 terminated string formatted as with printf()
+  char *format(const char *fmt, ...)
+#ifdef __GNUC__
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+
+  // Make all of the memory available again, the blocks are kept
+  inline void reset() { current_ = first_; offset_ = 0; used_ = 0; }
+
+  // The bytes allocated since the last reset()
+  inline size_t getBytesUsed() const  { return used_; }
+  // The blocks allocated from the heap, ever
+  inline size_t getNumMallocs() const { return numMallocs_; }
+
+private:
+  LoanArena(const LoanArena &);
+  LoanArena &operator=(const LoanArena &);
+
+  struct Block
+  {
+    Block *next;
+    size_t size;
+    // followed by size bytes
+  };
+
+  static inline char *blockData(Block *block) { return (char *) (block + 1); }
+
+  // Move to a block with at least bytes free, reusing the next blocks if possible
+  void nextBlock(size_t bytes);
+
+  size_t blockSize_;
+  Block *first_;
+  Block *current_;
+  size_t offset_;     // in current_
+  size_t used_;
+  size_t numMallocs_;
+};
+
+#endif // LOANARENA_H_INCLUDED
@@ -0,0 +1,236 @@
+
+#include <stdint.h>
+#include <string.h>
+
+#include <stdexcept>
+
+#include "LoanBatch.h"
+#include "LoanFormulas.h"
+#include "LoanMathKernels.h"
+
+using namespace std;
+
+// The loans are calculated in blocks of this many loans, the
+// intermediate per-loan values of a block stay in the L1 cache
+static const size_t BLOCK_SIZE = 256;
+
+// The result of an edge case of the formulas if mask, else the result of
+// the formula, both calculated, and selected with the bits of the mask so
+// the loops of the block have no branches
+static inline float selectEdge(bool mask, float edge, float formula)
+{
+  uint32_t edgeBits, formulaBits;
+  memcpy(&edgeBits, &edge, sizeof(edgeBits));
+  memcpy(&formulaBits, &formula, sizeof(formulaBits));
+
+  uint32_t select = -(uint32_t) mask;
+  uint32_t bits = (edgeBits & select) | (formulaBits & ~select);
+
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+LoanBatch::LoanBatch()
+{
+  reset();
+}
+
+void LoanBatch::setInputs(size_t count,
+                          const float *amount,
+                          const float *interest,
+                          const int *periodTotal,
+                          const int *periodElapsed)
+{
+  count_ = count;
+  amount_ = amount;
+  interest_ = interest;
+  periodTotal_ = periodTotal;
+  periodElapsed_ = periodElapsed;
+}
+
+void LoanBatch::setOutputs(float *payment,
+                           float *balance,
+                           float *numberPayments,
+                           float *loanAmount,
+                           float *interestRate)
+{
+  outPayment_ = payment;
+  outBalance_ = balance;
+  outNumberPayments_ = numberPayments;
+  outLoanAmount_ = loanAmount;
+  outInterestRate_ = interestRate;
+}
+
+void LoanBatch::calculate()
+{
+  if(count_ == 0)
+  {
+    return;
+  }
+
+  if(amount_ == NULL || interest_ == NULL || periodTotal_ == NULL)
+  {
+    throw invalid_argument("Must set loan amount, interest, and total period for a batch calculation" );
+  }
+
+  if(outBalance_ != NULL && periodElapsed_ == NULL)
+  {
+    throw invalid_argument("Must set elapsed period for a batch balance calculation" );
+  }
+
+  for(size_t first = 0; first < count_; first += BLOCK_SIZE)
+  {
+    size_t last = first + BLOCK_SIZE;
+    calculateBlock(first, (last < count_ ? last : count_));
+  }
+}
+
+void LoanBatch::calculateBlock(size_t first, size_t last)
+{
+  float interestPeriodic[BLOCK_SIZE] = {};
+  float financedAmount[BLOCK_SIZE];
+  float payment[BLOCK_SIZE];
+  float exponent[BLOCK_SIZE] = {};
+  float powMinusOne[BLOCK_SIZE];
+  float logRemaining[BLOCK_SIZE];
+  float logGrowth[BLOCK_SIZE];
+  double discount[BLOCK_SIZE];
+  size_t blockSize = last - first;
+
+  // First pass: the per-loan factors shared by all of the calculations,
+  // (1+i)^-N is calculated for the whole block by the vectorized kernel,
+  // and whether the block has any of the edge cases
+  bool anyEdge = false;
+  for(size_t k = 0; k < blockSize; ++k)
+  {
+    interestPeriodic[k] = interest_[first + k]/100.0/12.0;
+    exponent[k] = -1*periodTotal_[first + k];
+
+    anyEdge |= (interestPeriodic[k] == 0.0f) | (periodTotal_[first + k] == 1);
+  }
+
+  // discount = 1 + ((1+i)^-N - 1), exact in double, so 1 - discount does not cancel
+  loanPowOnePlusMinusOne(interestPeriodic, exponent, powMinusOne, blockSize);
+  for(size_t k = 0; k < blockSize; ++k)
+  {
+    discount[k] = 1.0 + (double) powMinusOne[k];
+  }
+
+  for(size_t k = 0; k < blockSize; ++k)
+  {
+    size_t loan = first + k;
+    float initialPayment = (initialPayment_ == NULL ? 0.0 : initialPayment_[loan]);
+    float openingFee     = (openingFee_     == NULL ? 0.0 : openingFee_[loan]);
+    float openingPercent = (openingPercent_ == NULL ? 0.0 : openingPercent_[loan]);
+    financedAmount[k] = loanFinancedAmount(amount_[loan], initialPayment, openingFee, openingPercent);
+
+    float calculatedPayment = loanPaymentFormula(financedAmount[k], interestPeriodic[k], discount[k]);
+    payment[k] = (payment_ == NULL ? calculatedPayment : payment_[loan]);
+
+    if(outPayment_ != NULL)
+    {
+      outPayment_[loan] = calculatedPayment;
+    }
+  }
+
+  // The edge cases are calculated for every loan of a block that has any,
+  // and selected, so a block without them costs one test
+  if(anyEdge)
+  {
+    for(size_t k = 0; k < blockSize; ++k)
+    {
+      size_t loan = first + k;
+      float i = interestPeriodic[k];
+      float calculatedPayment = loanPaymentFormula(financedAmount[k], i, discount[k]);
+      calculatedPayment = selectEdge(i == 0.0f, financedAmount[k]/periodTotal_[loan], calculatedPayment);
+      calculatedPayment = selectEdge(periodTotal_[loan] == 1, financedAmount[k]*(1 + i), calculatedPayment);
+
+      payment[k] = (payment_ == NULL ? calculatedPayment : payment_[loan]);
+      if(outPayment_ != NULL)
+      {
+        outPayment_[loan] = calculatedPayment;
+      }
+    }
+  }
+
+  // Second pass: the results that depend on the payment
+  if(outBalance_ != NULL)
+  {
+    for(size_t k = 0; k < blockSize; ++k)
+    {
+      exponent[k] = periodElapsed_[first + k];
+    }
+    loanPowOnePlusMinusOne(interestPeriodic, exponent, powMinusOne, blockSize);
+
+    for(size_t k = 0; k < blockSize; ++k)
+    {
+      size_t loan = first + k;
+      outBalance_[loan] = loanBalanceFormula(amount_[loan], payment[k], interestPeriodic[k],
+                                             1.0 + (double) powMinusOne[k]);
+    }
+
+    if(anyEdge)
+    {
+      for(size_t k = 0; k < blockSize; ++k)
+      {
+        size_t loan = first + k;
+        outBalance_[loan] = selectEdge(interestPeriodic[k] == 0.0f, amount_[loan] - payment[k]*exponent[k],
+                                       outBalance_[loan]);
+      }
+    }
+  }
+
+  if(outNumberPayments_ != NULL)
+  {
+    for(size_t k = 0; k < blockSize; ++k)
+    {
+      logRemaining[k] = -1.0*interestPeriodic[k]*amount_[first + k]/payment[k];
+    }
+    loanLogOnePlus(logRemaining, logRemaining, blockSize);
+    loanLogOnePlus(interestPeriodic, logGrowth, blockSize);
+
+    for(size_t k = 0; k < blockSize; ++k)
+    {
+      outNumberPayments_[first + k] = loanNumberPaymentsFromLogs(logRemaining[k], logGrowth[k]);
+    }
+
+    if(anyEdge)
+    {
+      for(size_t k = 0; k < blockSize; ++k)
+      {
+        size_t loan = first + k;
+        outNumberPayments_[loan] = selectEdge(interestPeriodic[k] == 0.0f, amount_[loan]/payment[k],
+                                              outNumberPayments_[loan]);
+      }
+    }
+  }
+
+  if(outLoanAmount_ != NULL)
+  {
+    for(size_t k = 0; k < blockSize; ++k)
+    {
+      outLoanAmount_[first + k] = loanAmountFormula(payment[k], interestPeriodic[k], discount[k]);
+    }
+
+    if(anyEdge)
+    {
+      for(size_t k = 0; k < blockSize; ++k)
+      {
+        size_t loan = first + k;
+        float amount = selectEdge(interestPeriodic[k] == 0.0f, payment[k]*periodTotal_[loan], outLoanAmount_[loan]);
+        outLoanAmount_[loan] = selectEdge(periodTotal_[loan] == 1, payment[k]/(1 + interestPeriodic[k]), amount);
+      }
+    }
+  }
+
+  if(outInterestRate_ != NULL)
+  {
+    rateSolver_.solve(blockSize, amount_ + first, payment, periodTotal_ + first,
+                      outInterestRate_ + first, NULL);
+    for(size_t k = 0; k < blockSize; ++k)
+    {
+      outInterestRate_[first + k] *= 12*100;
+    }
+  }
+}
@@ -0,0 +1,127 @@
+#ifndef LOANBATCH_H_INCLUDED
+#define LOANBATCH_H_INCLUDED
+
+/*
+Batch version of LoanCalculator, used to calculate many loans at once.
+
+Instead of one LoanCalculator object per loan, the loans are passed as
+contiguous arrays (structure of arrays), one element per loan, and the
+results are written to contiguous output arrays. The same formulas as
+LoanCalculator are used, see LoanFormulas.h
+
+For each loan i in [0, count):
+  payment[i]        = LoanCalculator::calculatePayment()
+  balance[i]        = LoanCalculator::calculateLoanBalance()
+  numberPayments[i] = LoanCalculator::calculateNumberPayments()
+  loanAmount[i]     = LoanCalculator::calculateLoanAmount()
+  interestRate[i]   = LoanCalculator::calculateInterestRate()
+
+The edge cases of the formulas, 0% loans, loans of one payment and
+balances once every payment is made, are calculated as the calculator
+does, see LoanFormulas.h, but for every loan, and selected by masks
+instead of branches. Very small rates need no case of their own, as the
+kernels calculate (1+i)^n - 1 with expm1().
+
+The interest rates are solved exactly with LoanRateSolver, its iteration
+counters are available with getRateSolver().
+
+The balance, number of payments, loan amount and interest rate calculations
+need a payment. If setPayments() was called, those payments are used,
+otherwise the payment calculated for each loan is used.
+
+The arrays are not copied, they must remain valid until calculate() returns.
+*/
+
+#include <cstddef>
+
+#include "LoanRateSolver.h"
+
+class LoanBatch
+{
+public:
+  LoanBatch();
+  ~LoanBatch() {}
+
+  //
+  // Inputs, each array must have count elements
+  //
+
+  /**
+   * Mandatory inputs:
+   *   amount        Total loan amount A
+   *   interest      Yearly interest rate as in 6.75
+   *   periodTotal   Total payment periods N
+   *   periodElapsed Elapsed payment periods n, may be NULL if the balance is not calculated
+   */
+  void setInputs(size_t count,
+                 const float *amount,
+                 const float *interest,
+                 const int *periodTotal,
+                 const int *periodElapsed);
+
+  /**
+   * Optional inputs, if not set (or set to NULL) they are taken as 0.0
+   * as in LoanCalculator
+   */
+  inline void setInitialPayments(const float *initialPayment) { initialPayment_ = initialPayment; }
+  inline void setOpeningFees(const float *openingFee)         { openingFee_ = openingFee; }
+  inline void setOpeningPercents(const float *openingPercent) { openingPercent_ = openingPercent; }
+
+  /**
+   * Optional payment P, if not set the calculated payment is used
+   */
+  inline void setPayments(const float *payment) { payment_ = payment; }
+
+  //
+  // Outputs, each array must have count elements, or be NULL
+  // in which case that result will not be calculated
+  //
+
+  void setOutputs(float *payment,
+                  float *balance,
+                  float *numberPayments,
+                  float *loanAmount,
+                  float *interestRate);
+
+  inline size_t getCount() const { return count_; }
+
+  inline const LoanRateSolver &getRateSolver() const { return rateSolver_; }
+  inline void resetRateSolverCounters() { rateSolver_.resetCounters(); }
+
+  inline void reset() {
+    count_ = 0;
+    amount_ = interest_ = initialPayment_ = openingFee_ = openingPercent_ = payment_ = NULL;
+    periodTotal_ = periodElapsed_ = NULL;
+    outPayment_ = outBalance_ = outNumberPayments_ = outLoanAmount_ = outInterestRate_ = NULL;
+  }
+
+  /**
+   * Calculate all of the loans, throws invalid_argument
+   * if the inputs needed for the requested outputs are not set
+   */
+  void calculate();
+
+private:
+  void calculateBlock(size_t first, size_t last);
+
+  size_t count_;
+
+  const float *amount_;
+  const float *interest_;
+  const int *periodTotal_;
+  const int *periodElapsed_;
+  const float *initialPayment_;
+  const float *openingFee_;
+  const float *openingPercent_;
+  const float *payment_;
+
+  float *outPayment_;
+  float *outBalance_;
+  float *outNumberPayments_;
+  float *outLoanAmount_;
+  float *outInterestRate_;
+
+  LoanRateSolver rateSolver_;
+};
+
+#endif // LOANBATCH_H_INCLUDED
@@ -0,0 +1,767 @@
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+#include "LoanBulk.h"
+#include "LoanCalculator.h"
+#include "LoanPortfolio.h"
+#include "LoanRecord.h"
+#include "LoanStats.h"
+#include "LoanTerms.h"
+#include "LoanValidation.h"
+
+using namespace std;
+
+// The input is calculated in chunks of about this many bytes, which
+// bounds the size of the output buffers for very large files
+static const size_t CHUNK_BYTES = 64*1024*1024;
+
+// The records of a thread are validated this many at a time, see LoanValidation.h
+static const size_t BLOCK_RECORDS = 256;
+
+// Exact powers of 10 as doubles
+static const double POWERS_OF_10[] =
+{
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+LoanBulk::LoanBulk(CALC_TYPE calcType, PRECISION precision, int numThreads) :
+  calcType_(calcType),
+  precision_(precision),
+  pool_(numThreads),
+  data_(NULL),
+  size_(0),
+  numRecords_(0),
+  rateTable_(NULL),
+  outputs_(pool_.getNumThreads())
+{
+  for(size_t thread = 0; thread < outputs_.size(); ++thread)
+  {
+    outputs_[thread].records = outputs_[thread].errors = 0;
+  }
+}
+
+void LoanBulk::loadFile(const string &fileName)
+{
+  if(fileName == "-")
+  {
+    load(cin);
+    return;
+  }
+
+  file_.open(fileName);
+  data_ = file_.getData();
+  size_ = file_.getSize();
+}
+
+void LoanBulk::load(istream &is)
+{
+  file_.read(is);
+  data_ = file_.getData();
+  size_ = file_.getSize();
+}
+
+void LoanBulk::load(const char *data, size_t size)
+{
+  file_.close();
+  data_ = data;
+  size_ = size;
+}
+
+size_t LoanBulk::nextLine(size_t offset) const
+{
+  const void *newline = memchr(data_ + offset, '\n', size_ - offset);
+  return (newline == NULL ? size_ : ((const char *) newline - data_) + 1);
+}
+
+static inline bool isBlank(char c)
+{
+  return (c == ' ' || c == '\t' || c == '\r');
+}
+
+static inline bool isDigit(char c)
+{
+  return (c >= '0' && c <= '9');
+}
+
+//
+// Parse a decimal number in place, as in -1234.5 or 6.75e-2, and move pos
+// past it. Returns false if there is no number at pos. Up to 19 significant
+// digits are used; money amounts and rates have far fewer, and are
+// converted exactly, as strtod() would
+//
+static bool parseNumber(const char *&pos, const char *end, double &value)
+{
+  const char *p = pos;
+
+  bool negative = false;
+  if(p < end && (*p == '-' || *p == '+'))
+  {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  unsigned long long mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool anyDigits = false;
+
+  for(; p < end && isDigit(*p); ++p)
+  {
+    anyDigits = true;
+    if(digits < 19)
+    {
+      mantissa = mantissa*10 + (*p - '0');
+      digits += (mantissa != 0);
+    }
+    else
+    {
+      ++exponent;
+    }
+  }
+
+  if(p < end && *p == '.')
+  {
+    for(++p; p < end && isDigit(*p); ++p)
+    {
+      anyDigits = true;
+      if(digits < 19)
+      {
+        mantissa = mantissa*10 + (*p - '0');
+        digits += (mantissa != 0);
+        --exponent;
+      }
+    }
+  }
+
+  if(!anyDigits)
+  {
+    return false;
+  }
+
+  if(p < end && (*p == 'e' || *p == 'E'))
+  {
+    const char *e = p + 1;
+    bool negativeExponent = false;
+    if(e < end && (*e == '-' || *e == '+'))
+    {
+      negativeExponent = (*e == '-');
+      ++e;
+    }
+
+    if(e < end && isDigit(*e))
+    {
+      int value = 0;
+      for(; e < end && isDigit(*e); ++e)
+      {
+        value = (value < 10000 ? value*10 + (*e - '0') : value);
+      }
+      exponent += (negativeExponent ? -value : value);
+      p = e;
+    }
+  }
+
+  // Both the mantissa and the power of 10 are exact, so one
+  // multiplication or division rounds correctly
+  double result = (double) mantissa;
+  if(mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22)
+  {
+    result = (exponent < 0 ? result/POWERS_OF_10[-exponent] : result*POWERS_OF_10[exponent]);
+  }
+  else if(mantissa != 0)
+  {
+    result *= pow(10.0, exponent);
+  }
+
+  value = (negative ? -result : result);
+  pos = p;
+
+  return true;
+}
+
+//
+// Parse the fields of the record [begin, end) in place into
+// values, returns false if a field is not a number
+//
+static bool parseRecord(const char *begin, const char *end, double values[LOAN_RECORD_FIELDS])
+{
+  LOAN_STATS_SCOPE(LOAN_OP_PARSE);
+
+  for(int field = 0; field < LOAN_RECORD_FIELDS; ++field)
+  {
+    values[field] = 0.0;
+  }
+
+  const char *pos = begin;
+  for(int field = 0; pos < end; ++field)
+  {
+    while(pos < end && isBlank(*pos))
+    {
+      ++pos;
+    }
+
+    if(pos == end)
+    {
+      break;
+    }
+
+    // An empty field
+    if(*pos == ',' || *pos == ';')
+    {
+      ++pos;
+      continue;
+    }
+
+    if(field >= LOAN_RECORD_FIELDS || !parseNumber(pos, end, values[field]))
+    {
+      return false;
+    }
+
+    // The number must be followed by a separator
+    const char *number = pos;
+    while(pos < end && isBlank(*pos))
+    {
+      ++pos;
+    }
+    if(pos < end && (*pos == ',' || *pos == ';'))
+    {
+      ++pos;
+    }
+    else if(pos < end && pos == number)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+vector<uint32_t> LoanBulk::getResultColumns(CALC_TYPE calcType)
+{
+  vector<uint32_t> columns;
+
+  if(calcType == CALC_BALANCE)
+  {
+    columns.push_back(COLUMN_BALANCE);
+  }
+  else if(calcType == CALC_PAYMENT)
+  {
+    columns.push_back(COLUMN_PAYMENT);
+    columns.push_back(COLUMN_TOTAL_PAID);
+  }
+  else if(calcType == CALC_NUMPAYMENTS)
+  {
+    columns.push_back(COLUMN_NUMBER_PAYMENTS);
+  }
+  else if(calcType == CALC_AMOUNT)
+  {
+    columns.push_back(COLUMN_AMOUNT);
+  }
+  else if(calcType == CALC_INTEREST)
+  {
+    columns.push_back(COLUMN_RATE);
+  }
+
+  return columns;
+}
+
+//
+// Append the results of a record as one line of text
+//
+static void formatResults(const vector<uint32_t> &columns,
+                          const double results[LOAN_RECORD_MAX_RESULTS],
+                          string &output)
+{
+  char buffer[128];
+  size_t length = 0;
+
+  for(size_t c = 0; c < columns.size(); ++c)
+  {
+    // Rates with 4 decimals, money and number of payments with 2
+    int written = snprintf(buffer + length, sizeof(buffer) - length,
+                           (columns[c] == COLUMN_RATE ? "%s%.4f" : "%s%.2f"),
+                           (c == 0 ? "" : ","), results[c]);
+    if(written <= 0 || (size_t) written >= sizeof(buffer) - length)
+    {
+      throw invalid_argument("Result out of range");
+    }
+    length += written;
+  }
+
+  output.append(buffer, length).append("\n");
+}
+
+// The stats operation of the calculation of a record
+static int getRecordStatsOp(CALC_TYPE calcType)
+{
+  switch(calcType)
+  {
+    case CALC_BALANCE:     return LOAN_OP_BALANCE;
+    case CALC_NUMPAYMENTS: return LOAN_OP_NUMPAYMENTS;
+    case CALC_AMOUNT:      return LOAN_OP_AMOUNT;
+    case CALC_INTEREST:    return LOAN_OP_INTEREST;
+    default:               return LOAN_OP_PAYMENT;
+  }
+}
+
+//
+// Calculate a valid record with the functions of LoanTerms.h, which have
+// no setters to check and dont throw, or with calculator if it has a rate
+// table, that LoanTerms.h doesnt look up. Returns the message of a result
+// that cant be calculated, NULL if none
+//
+template <class Calculator>
+static const char *calculateValidRecord(CALC_TYPE calcType,
+                                        Calculator &calculator,
+                                        const double values[LOAN_RECORD_FIELDS],
+                                        double results[LOAN_RECORD_MAX_RESULTS])
+{
+  typedef typename Calculator::NumericPolicy Policy;
+
+  if(calculator.getRateTable() != NULL)
+  {
+    calculateLoanRecord(calcType, calculator, values, results);
+    return NULL;
+  }
+
+  LOAN_STATS_SCOPE(getRecordStatsOp(calcType));
+  LOAN_STATUS status;
+  calculateLoanTerms(calcType, loanRecordTerms<Policy>(values), results, status);
+  return getLoanStatusMessage(status);
+}
+
+//
+// Add a valid record to a portfolio, as aggregateRecord(), with the
+// functions of LoanTerms.h. Returns the message of a result that cant be
+// calculated, NULL if none
+//
+template <class Policy>
+static const char *aggregateTerms(const double values[LOAN_RECORD_FIELDS], LoanPortfolio &portfolio)
+{
+  typedef typename Policy::Money Money;
+
+  BasicLoanTerms<Policy> terms(loanRecordTerms<Policy>(values));
+  Money financed = loanFinancedAmount(terms);
+  if(values[3] == 0.0)
+  {
+    LoanResult<Money> payment = loanPayment(terms);
+    if(!payment.isOk())
+    {
+      return getLoanStatusMessage(payment.status);
+    }
+    terms.payment = payment.value;
+  }
+
+  // The balance of the financed amount
+  double balance = 0.0;
+  if(terms.periodElapsed < terms.periodTotal)
+  {
+    terms.amount = financed;
+    terms.initialPayment = Money();
+    terms.openingFee = Money();
+    terms.openingPercent = 0.0;
+
+    LoanResult<Money> remaining = loanBalance(terms);
+    if(!remaining.isOk())
+    {
+      return getLoanStatusMessage(remaining.status);
+    }
+    balance = Policy::toDouble(remaining.value);
+  }
+
+  portfolio.addLoan(Policy::toDouble(financed), values[1], terms.periodTotal, terms.periodElapsed,
+                    Policy::toDouble(terms.payment), balance);
+  return NULL;
+}
+
+//
+// Add a record to a portfolio: its financed amount, its payment, calculated
+// if not set, and its balance after the elapsed periods
+//
+template <class Calculator>
+static void aggregateRecord(Calculator &calculator,
+                            const double values[LOAN_RECORD_FIELDS],
+                            LoanPortfolio &portfolio)
+{
+  typedef typename Calculator::NumericPolicy Policy;
+  typedef typename Calculator::Money Money;
+
+  int periodTotal = (int) values[2];
+  int periodElapsed = (int) values[4];
+  if(periodTotal < 1 || periodElapsed < 0)
+  {
+    throw invalid_argument("Must set the total period of a loan of a portfolio");
+  }
+
+  calculator.reset();
+  calculator.setAmount(Policy::fromDouble(values[0]));
+  calculator.setInterest(values[1]);
+  calculator.setPeriodTotal(periodTotal);
+  calculator.setInitialPayment(Policy::fromDouble(values[5]));
+  calculator.setOpeningFee(Policy::fromDouble(values[6]));
+  calculator.setOpeningPercent(values[7]);
+
+  Money financed = calculator.calculateFinancedAmount();
+  Money payment = (values[3] != 0.0 ? Policy::fromDouble(values[3]) : calculator.calculatePayment());
+
+  // The balance of the financed amount
+  calculator.setAmount(financed);
+  calculator.setInitialPayment(Money());
+  calculator.setOpeningFee(Money());
+  calculator.setOpeningPercent(0.0);
+  calculator.setPayment(payment);
+  calculator.setPeriodElapsed(periodElapsed);
+  double balance = (periodElapsed < periodTotal ? Policy::toDouble(calculator.calculateLoanBalance()) : 0.0);
+
+  if(!isfinite(Policy::toDouble(payment)) || !isfinite(balance))
+  {
+    throw invalid_argument("Result out of range");
+  }
+
+  portfolio.addLoan(Policy::toDouble(financed), values[1], periodTotal, periodElapsed,
+                    Policy::toDouble(payment), balance);
+}
+
+template <class Calculator>
+size_t LoanBulk::calculateAll(ostream *os, LoanColumnWriter *writer, vector<LoanPortfolio> *partials)
+{
+  const vector<uint32_t> columns(getResultColumns(calcType_));
+  if(writer != NULL)
+  {
+    writer->writeHeader(columns);
+  }
+
+  typedef typename Calculator::NumericPolicy Policy;
+
+  // The checks of the calculation type, or of the payment and balance of
+  // a portfolio
+  const uint32_t checks = (partials != NULL ? LOAN_CHECK_RATE | LOAN_CHECK_TERM | LOAN_CHECK_ELAPSED :
+                                              getLoanRecordChecks(calcType_));
+
+  size_t errors = 0;
+  numRecords_ = 0;
+
+  size_t chunkBegin = 0;
+  while(chunkBegin < size_)
+  {
+    size_t chunkEnd = (size_ - chunkBegin > CHUNK_BYTES ? nextLine(chunkBegin + CHUNK_BYTES - 1) : size_);
+
+    pool_.parallelFor(chunkEnd - chunkBegin, [&] (size_t begin, size_t end, int thread)
+    {
+      // Each thread has its own calculator, output buffers and block of records
+      Calculator calculator;
+      calculator.setRateTable(rateTable_);
+      ThreadOutput &output = outputs_[thread];
+
+      double fields[LOAN_RECORD_FIELDS][BLOCK_RECORDS];
+      const double *blockFields[LOAN_RECORD_FIELDS];
+      for(int field = 0; field < LOAN_RECORD_FIELDS; ++field)
+      {
+        blockFields[field] = fields[field];
+      }
+      size_t offsets[BLOCK_RECORDS];
+      uint8_t invalid[BLOCK_RECORDS];
+      size_t count = 0;
+
+      auto addError = [&] (const char *message, size_t offset)
+      {
+        if(partials != NULL)
+        {
+          (*partials)[thread].addError();
+        }
+        else if(writer != NULL)
+        {
+          for(size_t c = 0; c < columns.size(); ++c)
+          {
+            output.columns[c].push_back(NAN);
+          }
+          output.status.push_back(1);
+        }
+        else
+        {
+          char buffer[64];
+          snprintf(buffer, sizeof(buffer), "error: byte %lu: ", (unsigned long) offset);
+          output.text.append(buffer).append(message).append("\n");
+        }
+        ++output.errors;
+      };
+
+      // Validate the block, then calculate the valid records and report the
+      // others, in input order
+      auto calculateBlock = [&]
+      {
+        {
+          LOAN_STATS_SCOPE(LOAN_OP_VALIDATE);
+          validateLoanRecords(checks, Policy::getMaxAmount(), count, blockFields, invalid);
+        }
+
+        // Only the results out of range of the cents, or too long to
+        // format, and the calculator of a rate table can still throw, so the
+        // block has one try, resumed after the record that threw
+        size_t k = 0;
+        while(k < count)
+        {
+          try
+          {
+            for(; k < count; ++k)
+            {
+              if(invalid[k] != LOAN_VALID)
+              {
+                addError(getLoanInvalidMessage(invalid[k]), offsets[k]);
+                continue;
+              }
+
+              double values[LOAN_RECORD_FIELDS];
+              double results[MAX_RESULTS];
+              for(int field = 0; field < LOAN_RECORD_FIELDS; ++field)
+              {
+                values[field] = fields[field][k];
+              }
+
+              if(partials != NULL)
+              {
+                const char *message = NULL;
+                if(rateTable_ != NULL)
+                {
+                  aggregateRecord(calculator, values, (*partials)[thread]);
+                }
+                else
+                {
+                  message = aggregateTerms<Policy>(values, (*partials)[thread]);
+                }
+
+                if(message != NULL)
+                {
+                  addError(message, offsets[k]);
+                }
+                continue;
+              }
+
+              const char *message = calculateValidRecord(calcType_, calculator, values, results);
+              if(message != NULL)
+              {
+                addError(message, offsets[k]);
+                continue;
+              }
+
+              LOAN_STATS_SCOPE(LOAN_OP_OUTPUT);
+              if(writer != NULL)
+              {
+                for(size_t c = 0; c < columns.size(); ++c)
+                {
+                  output.columns[c].push_back(results[c]);
+                }
+                output.status.push_back(0);
+              }
+              else
+              {
+                formatResults(columns, results, output.text);
+              }
+            }
+          }
+          catch(const exception &e)
+          {
+            addError(e.what(), offsets[k]);
+            ++k;
+          }
+        }
+
+        count = 0;
+      };
+
+      // Take the lines that start in [begin, end)
+      size_t lineBegin = chunkBegin + begin;
+      if(lineBegin > 0)
+      {
+        lineBegin = nextLine(lineBegin - 1);
+      }
+      // Only the first line of the input can be a CSV header
+      bool headerAllowed = (lineBegin == 0);
+
+      while(lineBegin < chunkBegin + end)
+      {
+        size_t lineEnd = nextLine(lineBegin);
+        const char *first = data_ + lineBegin;
+        const char *last = data_ + lineEnd;
+        size_t offset = lineBegin;
+        lineBegin = lineEnd;
+
+        if(last > first && last[-1] == '\n')
+        {
+          --last;
+        }
+        while(first < last && isBlank(*first))
+        {
+          ++first;
+        }
+
+        // Skip blank lines, comments and the CSV header
+        if(first == last || *first == '#')
+        {
+          continue;
+        }
+        if(headerAllowed)
+        {
+          headerAllowed = false;
+          if(!isDigit(*first) && *first != '.' && *first != '-' && *first != '+')
+          {
+            continue;
+          }
+        }
+
+        ++output.records;
+        double values[LOAN_RECORD_FIELDS];
+        invalid[count] = (parseRecord(first, last, values) ? LOAN_VALID : LOAN_INVALID_RECORD);
+        for(int field = 0; field < LOAN_RECORD_FIELDS; ++field)
+        {
+          fields[field][count] = values[field];
+        }
+        offsets[count] = offset;
+
+        if(++count == BLOCK_RECORDS)
+        {
+          calculateBlock();
+        }
+      }
+
+      if(count > 0)
+      {
+        calculateBlock();
+      }
+    });
+
+    // The ranges are in order, so are the buffers
+    LOAN_STATS_SCOPE(LOAN_OP_WRITE);
+    size_t rows = 0;
+    for(size_t thread = 0; thread < outputs_.size(); ++thread)
+    {
+      rows += outputs_[thread].records;
+    }
+
+    if(writer != NULL && rows > 0)
+    {
+      writer->beginBlock(rows);
+      for(size_t c = 0; c < columns.size(); ++c)
+      {
+        for(size_t thread = 0; thread < outputs_.size(); ++thread)
+        {
+          const vector<double> &column = outputs_[thread].columns[c];
+          writer->addColumnData(column.data(), column.size()*sizeof(double));
+        }
+        writer->endColumn();
+      }
+      for(size_t thread = 0; thread < outputs_.size(); ++thread)
+      {
+        writer->addColumnData(outputs_[thread].status.data(), outputs_[thread].status.size());
+      }
+      writer->endColumn();
+      writer->endBlock();
+    }
+
+    for(size_t thread = 0; thread < outputs_.size(); ++thread)
+    {
+      ThreadOutput &output = outputs_[thread];
+      if(os != NULL)
+      {
+        os->write(output.text.data(), output.text.size());
+      }
+
+      numRecords_ += output.records;
+      errors += output.errors;
+
+      output.text.clear();
+      for(int c = 0; c < MAX_RESULTS; ++c)
+      {
+        output.columns[c].clear();
+      }
+      output.status.clear();
+      output.records = output.errors = 0;
+    }
+
+    chunkBegin = chunkEnd;
+  }
+
+  if(os != NULL)
+  {
+    os->flush();
+  }
+
+  return errors;
+}
+
+void LoanBulk::checkCalcType() const
+{
+  if(calcType_ == CALC_SCHEDULE)
+  {
+    throw invalid_argument("The amortization schedule cant be calculated in bulk mode");
+  }
+  if(calcType_ == CALC_UNKNOWN)
+  {
+    throw invalid_argument("Must set the calculation type for bulk mode");
+  }
+}
+
+size_t LoanBulk::calculate(ostream &os)
+{
+  checkCalcType();
+
+  if(precision_ == PRECISION_CENTS)
+  {
+    return calculateAll<LoanCalculatorCents>(&os, NULL, NULL);
+  }
+  else if(precision_ == PRECISION_DOUBLE)
+  {
+    return calculateAll<LoanCalculatorDouble>(&os, NULL, NULL);
+  }
+
+  return calculateAll<LoanCalculator>(&os, NULL, NULL);
+}
+
+size_t LoanBulk::calculate(LoanColumnWriter &writer)
+{
+  checkCalcType();
+
+  if(precision_ == PRECISION_CENTS)
+  {
+    return calculateAll<LoanCalculatorCents>(NULL, &writer, NULL);
+  }
+  else if(precision_ == PRECISION_DOUBLE)
+  {
+    return calculateAll<LoanCalculatorDouble>(NULL, &writer, NULL);
+  }
+
+  return calculateAll<LoanCalculator>(NULL, &writer, NULL);
+}
+
+size_t LoanBulk::aggregate(LoanPortfolio &portfolio)
+{
+  // Each thread reduces into its own partial, merged in thread order
+  vector<LoanPortfolio> partials(pool_.getNumThreads(), LoanPortfolio(portfolio.getBucketPeriods()));
+
+  size_t errors;
+  if(precision_ == PRECISION_CENTS)
+  {
+    errors = calculateAll<LoanCalculatorCents>(NULL, NULL, &partials);
+  }
+  else if(precision_ == PRECISION_DOUBLE)
+  {
+    errors = calculateAll<LoanCalculatorDouble>(NULL, NULL, &partials);
+  }
+  else
+  {
+    errors = calculateAll<LoanCalculator>(NULL, NULL, &partials);
+  }
+
+  for(size_t thread = 0; thread < partials.size(); ++thread)
+  {
+    portfolio.merge(partials[thread]);
+  }
+
+  return errors;
+}
@@ -0,0 +1,158 @@
+#ifndef LOANBULK_H_INCLUDED
+#define LOANBULK_H_INCLUDED
+
+/*
+Bulk mode of the command line calculator, calculates one loan per record
+of a CSV or newline delimited file, with a LoanThreadPool.
+
+Each record is one line, with the fields separated by commas, semicolons,
+tabs or spaces, in this order:
+  amount, interest, periodTotal, payment, periodElapsed,
+  initialPayment, openingFee, openingPercent
+Missing or empty fields are taken as 0.0, see LoanRecord.h
+Blank lines and lines starting with # are skipped, as is a first line
+that does not start with a number (a CSV header).
+
+The input is memory mapped, see LoanMappedFile.h, and is never copied.
+It is split in chunks of bytes, and each chunk is split in contiguous byte
+ranges, one per thread. Each thread moves the start of its range to the
+next line boundary and takes every line that starts in its range, so
+there is no serial pass to find the lines. Each thread parses its records
+in place, calculates them with its own calculator and formats the results
+into its own buffer, so the threads share nothing but the input. The
+buffers are then written in thread order, so the results are in input
+order, one line per record. A record that cant be calculated gives a line
+starting with "error:" and the byte offset of the record.
+
+The results can also be written as a binary column file, see
+LoanColumnFile.h, in which case the threads write their results to their
+own column buffers instead of formatting them, one block per chunk.
+
+Or the loans can be aggregated into the totals of a LoanPortfolio, in
+which case each thread reduces its loans into its own partial portfolio
+as they are calculated, and the partials are merged in thread order once
+all of the chunks are done, so nothing is written per loan.
+*/
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "LoanCalcType.h"
+#include "LoanColumnFile.h"
+#include "LoanMappedFile.h"
+#include "LoanRecord.h"
+
+#include "LoanThreadPool.h"
+
+class LoanPortfolio;
+class LoanRateTable;
+
+class LoanBulk
+{
+public:
+  enum PRECISION
+  {
+    PRECISION_FLOAT=0,  // LoanCalculator
+    PRECISION_DOUBLE,   // LoanCalculatorDouble
+    PRECISION_CENTS     // LoanCalculatorCents
+  };
+
+  /**
+   * numThreads <= 0 uses one thread per core
+   */
+  LoanBulk(CALC_TYPE calcType, PRECISION precision, int numThreads);
+  ~LoanBulk() {}
+
+  /**
+   * Set the records, replacing any previously set. A fileName of "-"
+   * reads stdin, throws runtime_error if the file cant be read
+   */
+  void loadFile(const std::string &fileName);
+  void load(std::istream &is);
+
+  /**
+   * Use records already in memory, they are not copied and
+   * must remain valid until calculate() returns
+   */
+  void load(const char *data, size_t size);
+
+  // The number of records of the last calculate()
+  inline size_t getNumRecords() const { return numRecords_; }
+  inline int getNumThreads() const    { return pool_.getNumThreads(); }
+
+  /**
+   * Calculate the loans on the grid of table with its factors, see
+   * LoanCalculator::setRateTable(), NULL by default
+   */
+  inline void setRateTable(const LoanRateTable *table) { rateTable_ = table; }
+
+  /**
+   * Calculate all of the records and write the results to os, in input
+   * order. Returns the number of records that could not be calculated.
+   * Throws invalid_argument if the calculation type cant be done in bulk
+   */
+  size_t calculate(std::ostream &os);
+
+  /**
+   * As above, writing the header and the results to a column file
+   * already opened. Throws runtime_error if the file cant be written
+   */
+  size_t calculate(LoanColumnWriter &writer);
+
+  /**
+   * Calculate the payment, if not set, and the balance after the elapsed
+   * periods of every record, and add them to portfolio, whatever the
+   * calculation type. Returns the number of records that could not be
+   * calculated, also counted in the errors of portfolio
+   */
+  size_t aggregate(LoanPortfolio &portfolio);
+
+  // The result columns of a calculation type, LOAN_COLUMN
+  static std::vector<uint32_t> getResultColumns(CALC_TYPE calcType);
+
+  // The most results of one calculation
+  static const int MAX_RESULTS = LOAN_RECORD_MAX_RESULTS;
+
+private:
+  LoanBulk(); // Cant initialize default version
+  LoanBulk(const LoanBulk &);
+  LoanBulk &operator=(const LoanBulk &);
+
+  void checkCalcType() const;
+
+  // One of os, writer or partials, one portfolio per thread, is set
+  template <class Calculator>
+  size_t calculateAll(std::ostream *os, LoanColumnWriter *writer, std::vector<LoanPortfolio> *partials);
+
+  // The end of the line containing offset, including its newline
+  size_t nextLine(size_t offset) const;
+
+  CALC_TYPE calcType_;
+  PRECISION precision_;
+  LoanThreadPool pool_;
+
+  LoanMappedFile file_;
+  const char *data_;
+  size_t size_;
+  size_t numRecords_;
+  const LoanRateTable *rateTable_;
+
+  // The output of one thread for one chunk
+  struct ThreadOutput
+  {
+    std::string text;
+    std::vector<double> columns[MAX_RESULTS];
+    std::vector<uint8_t> status;
+    size_t records;
+    size_t errors;
+  };
+
+  // Per thread outputs, reused for every chunk
+  std::vector<ThreadOutput> outputs_;
+};
+
+#endif // LOANBULK_H_INCLUDED
@@ -1,10 +1,20 @@
 
 #include <QtGui>
 
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
 #include "LoanCalculator.h"
 #include "LoanCalcQtMainWindow.h"
-
-LoanCalcQtMainWindow::LoanCalcQtMainWindow(LoanCalculator *calculator) : calculator_(calculator)
+#include "LoanSchedule.h"
+
+LoanCalcQtMainWindow::LoanCalcQtMainWindow(LoanCalculator *calculator) :
+  calculator_(calculator),
+  scheduleAmount_(0.0),
+  scheduleInterest_(0.0),
+  schedulePeriodTotal_(-1),
+  schedulePayment_(0.0)
 {
   mainWidget_ = new QWidget();
   setCentralWidget(mainWidget_);
@@ -32,7 +42,8 @@ LoanCalcQtMainWindow::~LoanCalcQtMainWindow()
   deleteButtons();
 }
 
-// Get the input fields and set the values on the calculator
+// Get the input fields and set the values on the calculator. The calculator
+// only calculates again the derived values whose inputs changed, see reset()
 void LoanCalcQtMainWindow::getInputFields()
 {
   calculator_->reset();
@@ -135,6 +146,14 @@ QWidget *LoanCalcQtMainWindow::createInputFields()
   labelPayment_->setBuddy(lineEditPayment_);
   labelMonths_->setBuddy(lineEditMonths_);
 
+  // Recalculate as the fields are edited
+  connect(lineEditAmount_,         SIGNAL(textEdited(const QString &)), this, SLOT(changedInput()));
+  connect(lineEditInitialPayment_, SIGNAL(textEdited(const QString &)), this, SLOT(changedInput()));
+  connect(lineEditLoanFeePercent_, SIGNAL(textEdited(const QString &)), this, SLOT(changedInput()));
+  connect(lineEditInterest_,       SIGNAL(textEdited(const QString &)), this, SLOT(changedInput()));
+  connect(lineEditPayment_,        SIGNAL(textEdited(const QString &)), this, SLOT(changedInput()));
+  connect(lineEditMonths_,         SIGNAL(textEdited(const QString &)), this, SLOT(changedInput()));
+
   layoutGridInputFields_ = new QGridLayout();
   layoutGridInputFields_->addWidget(labelAmount_,             0, 0);
   layoutGridInputFields_->addWidget(lineEditAmount_,          0, 1);
@@ -157,11 +176,28 @@ QWidget *LoanCalcQtMainWindow::createInputFields()
 
 QWidget *LoanCalcQtMainWindow::createCalcResults()
 {
-  textEditCalcResults_ = new QTextEdit();
+  // A plain text edit only lays out the visible lines,
+  // so even a 40 year amortization table is set quickly
+  QFont fixedFont("Monospace");
+  fixedFont.setStyleHint(QFont::TypeWriter);
+
+  textEditCalcResults_ = new QPlainTextEdit();
   textEditCalcResults_->setReadOnly(true);
+  textEditCalcResults_->setLineWrapMode(QPlainTextEdit::NoWrap);
+  textEditCalcResults_->setFont(fixedFont);
+
+  checkBoxSchedule_ = new QCheckBox(tr("Amortization &Table"));
 
   layoutVboxCalcResults_ = new QVBoxLayout();
   layoutVboxCalcResults_->addWidget(textEditCalcResults_);
+  layoutVboxCalcResults_->addWidget(checkBoxSchedule_);
+
+  timerRecalculate_ = new QTimer(this);
+  timerRecalculate_->setSingleShot(true);
+  timerRecalculate_->setInterval(0);
+
+  connect(checkBoxSchedule_, SIGNAL(toggled(bool)), this, SLOT(changedInput()));
+  connect(timerRecalculate_, SIGNAL(timeout()),     this, SLOT(recalculate()));
 
   groupBoxCalcResults_ = new QGroupBox(tr("Calculation Results"));
   groupBoxCalcResults_->setLayout(layoutVboxCalcResults_);
@@ -228,6 +264,8 @@ void LoanCalcQtMainWindow::deleteInputFields()
 
 void LoanCalcQtMainWindow::deleteCalcResults()
 {
+  delete timerRecalculate_;
+  delete checkBoxSchedule_;
   delete textEditCalcResults_;
   delete layoutVboxCalcResults_;
   delete groupBoxCalcResults_;
@@ -335,43 +373,7 @@ void LoanCalcQtMainWindow::pressedRadioBalance()
 
 void LoanCalcQtMainWindow::pressedButtonCalculate()
 {
-  getInputFields(); // resets the calculator and set it with input fields
-  QString result;
-
-  if(radioMonthlyPayment_->isChecked()) {
-    double payment = calculator_->calculatePayment();
-    result.append("Monthly Payment = ");
-    result.append(QString::number((double) payment, 'f', 2)); // 'f' is the float format, with 2 decimal places
-    result.append("\nTotal amt paid = ");
-    result.append(QString::number((double) (payment*calculator_->getPeriodTotal()), 'f', 2));
-
-    if(calculator_->getOpeningPercent() != 0.0 || calculator_->getOpeningFee() != 0.0)
-    {
-      result.append("\nInterest with fees = ");
-      result.append(QString::number((double) calculator_->calculateEffectiveInterestRate(), 'f', 2));
-      result.append("%");
-    }
-  }
-  else if(radioAmount_->isChecked()) {
-    result.append("Initial Loan amount = ");
-    result.append(QString::number((double) calculator_->calculateLoanAmount(), 'f', 2));
-  }
-  else if(radioInterest_->isChecked()) {
-    result.append("Yearly Interest Rate = ");
-    result.append(QString::number((double) calculator_->calculateInterestRate(), 'f', 2));
-  }
-  else if(radioNumPayments_->isChecked()) {
-    result.append("Number of payments = ");
-    result.append(QString::number((double) calculator_->calculateNumberPayments(), 'f', 2));
-  }
-  else if(radioBalance_->isChecked()) {
-    result.append("Loan Balance = ");
-    result.append(QString::number((double) calculator_->calculateLoanBalance(), 'f', 2));
-  }
-  // else this is impossible, one of them has to be selected
-
-  //textEditCalcResults_->setText(QString::fromStdString(calculator_->toString()));
-  textEditCalcResults_->setText(result);
+  calculateResults(true);
 }
 
 void LoanCalcQtMainWindow::pressedButtonClearEntries()
@@ -386,3 +388,110 @@ void LoanCalcQtMainWindow::pressedButtonClearEntries()
   textEditCalcResults_->clear();
 }
 
+//
+// Live recalculation SLOTs
+//
+
+void LoanCalcQtMainWindow::changedInput()
+{
+  // Several edits may be queued, only the last one is calculated
+  timerRecalculate_->start();
+}
+
+void LoanCalcQtMainWindow::recalculate()
+{
+  // The fields are usually incomplete while they are typed,
+  // so the errors are only shown by the Calculate button
+  calculateResults(false);
+}
+
+//
+// Calculation of the results
+//
+
+void LoanCalcQtMainWindow::calculateResults(bool showErrors)
+{
+  getInputFields(); // resets the calculator and set it with input fields
+  QString result;
+
+  try
+  {
+    if(radioMonthlyPayment_->isChecked()) {
+      double payment = calculator_->calculatePayment();
+      result.append("Monthly Payment = ");
+      result.append(QString::number((double) payment, 'f', 2)); // 'f' is the float format, with 2 decimal places
+      result.append("\nTotal amt paid = ");
+      result.append(QString::number((double) (payment*calculator_->getPeriodTotal()), 'f', 2));
+
+      if(calculator_->getOpeningPercent() != 0.0 || calculator_->getOpeningFee() != 0.0)
+      {
+        result.append("\nInterest with fees = ");
+        result.append(QString::number((double) calculator_->calculateEffectiveInterestRate(), 'f', 2));
+        result.append("%");
+      }
+
+      if(checkBoxSchedule_->isChecked()) {
+        result.append("\n\n");
+        result.append(getScheduleText(calculator_->calculateFinancedAmount(),
+                                      calculator_->getInterest(),
+                                      calculator_->getPeriodTotal(),
+                                      payment));
+      }
+    }
+    else if(radioAmount_->isChecked()) {
+      result.append("Initial Loan amount = ");
+      result.append(QString::number((double) calculator_->calculateLoanAmount(), 'f', 2));
+    }
+    else if(radioInterest_->isChecked()) {
+      result.append("Yearly Interest Rate = ");
+      result.append(QString::number((double) calculator_->calculateInterestRate(), 'f', 2));
+    }
+    else if(radioNumPayments_->isChecked()) {
+      result.append("Number of payments = ");
+      result.append(QString::number((double) calculator_->calculateNumberPayments(), 'f', 2));
+    }
+    else if(radioBalance_->isChecked()) {
+      result.append("Loan Balance = ");
+      result.append(QString::number((double) calculator_->calculateLoanBalance(), 'f', 2));
+    }
+    // else this is impossible, one of them has to be selected
+  }
+  catch(const std::exception &e)
+  {
+    if(!showErrors) {
+      textEditCalcResults_->clear();
+      return;
+    }
+
+    result = QString::fromLatin1(e.what());
+  }
+
+  //textEditCalcResults_->setPlainText(QString::fromStdString(calculator_->toString()));
+  textEditCalcResults_->setPlainText(result);
+}
+
+// The amortization table of the loan, formatted as by loanCalculatorCli -cs.
+// Only formatted again if the loan changed, as when the fees are edited
+// while the interest with fees is calculated
+const QString &LoanCalcQtMainWindow::getScheduleText(double amount, double interest, int periodTotal, double payment)
+{
+  if(amount != scheduleAmount_ || interest != scheduleInterest_ ||
+     periodTotal != schedulePeriodTotal_ || payment != schedulePayment_)
+  {
+    std::ostringstream os;
+    LoanScheduleTextSink sink(os);
+    sink.writeHeader();
+
+    LoanSchedule schedule(amount, interest, periodTotal, payment);
+    schedule.generate(sink);
+
+    std::string text(os.str());
+    scheduleText_ = QString::fromLatin1(text.data(), text.size());
+    scheduleAmount_ = amount;
+    scheduleInterest_ = interest;
+    schedulePeriodTotal_ = periodTotal;
+    schedulePayment_ = payment;
+  }
+
+  return scheduleText_;
+}
@@ -25,10 +25,16 @@ public slots:
   void pressedButtonCalculate();
   void pressedButtonClearEntries();
 
+  // Live recalculation SLOTs, as the input fields are edited
+  void changedInput();
+  void recalculate();
+
 private:
   LoanCalcQtMainWindow(); // Cant initialize default version
 
   void getInputFields();
+  void calculateResults(bool showErrors);
+  const QString &getScheduleText(double amount, double interest, int periodTotal, double payment);
   void enableFields(bool enableAmount,
                     bool enableInitialPayment,
                     bool enableLoanFee,
@@ -82,7 +88,18 @@ private:
   // Calulation Results
   QVBoxLayout *layoutVboxCalcResults_;
   QGroupBox *groupBoxCalcResults_;
-  QTextEdit *textEditCalcResults_;
+  QPlainTextEdit *textEditCalcResults_;
+  QCheckBox *checkBoxSchedule_;
+
+  // Coalesces the edits of one pass of the event loop into one recalculation
+  QTimer *timerRecalculate_;
+
+  // The last amortization table, formatted again only when its loan changes
+  QString scheduleText_;
+  double scheduleAmount_;
+  double scheduleInterest_;
+  int schedulePeriodTotal_;
+  double schedulePayment_;
 
   // Buttons
   QHBoxLayout *layoutHboxButtons_;
@@ -0,0 +1,31 @@
+#ifndef LOANCALCTYPE_H_INCLUDED
+#define LOANCALCTYPE_H_INCLUDED
+
+/*
+The calculation types, as selected on the command line
+*/
+
+enum CALC_TYPE
+{
+  CALC_UNKNOWN=0,
+  CALC_BALANCE=100,
+  CALC_PAYMENT,
+  CALC_NUMPAYMENTS,
+  CALC_AMOUNT,
+  CALC_INTEREST,
+  CALC_SCHEDULE
+};
+
+/*
+The payment frequencies, the number of payments a year
+*/
+
+enum LOAN_FREQUENCY
+{
+  LOAN_WEEKLY=52,
+  LOAN_BIWEEKLY=26,
+  LOAN_MONTHLY=12,
+  LOAN_QUARTERLY=4
+};
+
+#endif // LOANCALCTYPE_H_INCLUDED
@@ -1,25 +1,98 @@
 
-#include <iostream>
 #include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+
 #include <stdexcept>
-#include <sstream>
 #include <string>
-#include <math.h>
 
 #include "LoanCalculator.h"
+#include "LoanFormulas.h"
+#include "LoanRateSchedule.h"
+#include "LoanRateTable.h"
+#include "LoanStats.h"
 
 using namespace std;
 
-LoanCalculator::LoanCalculator() :
+template <class Policy>
+BasicLoanCalculator<Policy>::BasicLoanCalculator() :
   amountSet_(false),
-  initialPayment_(0.0),
+  initialPayment_(),
   interestSet_(false),
+  periodsPerYear_(LOAN_MONTHLY),
   paymentSet_(false),
   periodTotalSet_(false),
   periodElapsedSet_(false),
-  openingFee_(0.0),
-  openingPercent_(0.0)
+  openingFee_(),
+  openingPercent_(),
+  rateTable_(NULL),
+  rateSchedule_(NULL),
+  discountValid_(false),
+  growthValid_(false),
+  solvedValid_(false)
+{
+}
+
+template <class Policy>
+void BasicLoanCalculator<Policy>::setPeriodsPerYear(int periodsPerYear)
+{
+  if(periodsPerYear < 1)
+  {
+    throw invalid_argument("Must make at least 1 payment per year");
+  }
+
+  periodsPerYear_ = periodsPerYear;
+  if(interestSet_)
+  {
+    interestPeriodic_ = interest_/100.0/periodsPerYear_;
+  }
+}
+
+//
+// The derived values, see LoanCalculator.h
+//
+
+template <class Policy>
+double BasicLoanCalculator<Policy>::getDiscountFactor()
+{
+  if(!discountValid_ || discountInterest_ != interestPeriodic_ || discountPeriods_ != periodTotal_)
+  {
+    discountFactor_ = loanGrowthFactor(interestPeriodic_, -1*periodTotal_);
+    discountInterest_ = interestPeriodic_;
+    discountPeriods_ = periodTotal_;
+    discountValid_ = true;
+  }
+
+  return discountFactor_;
+}
+
+template <class Policy>
+double BasicLoanCalculator<Policy>::getGrowthFactor()
 {
+  if(!growthValid_ || growthInterest_ != interestPeriodic_ || growthPeriods_ != periodElapsed_)
+  {
+    growthFactor_ = loanGrowthFactor(interestPeriodic_, periodElapsed_);
+    growthInterest_ = interestPeriodic_;
+    growthPeriods_ = periodElapsed_;
+    growthValid_ = true;
+  }
+
+  return growthFactor_;
+}
+
+template <class Policy>
+typename Policy::Real BasicLoanCalculator<Policy>::solveRate(double A, double P, int N)
+{
+  if(!solvedValid_ || solvedAmount_ != A || solvedPayment_ != P || solvedPeriods_ != N)
+  {
+    solvedRate_ = rateSolver_.solve(A, P, N);
+    solvedAmount_ = A;
+    solvedPayment_ = P;
+    solvedPeriods_ = N;
+    solvedValid_ = true;
+  }
+
+  return solvedRate_;
 }
 
 //
@@ -30,33 +103,73 @@ LoanCalculator::LoanCalculator() :
  * Loan balance after n payments have been made:
  *   B_n = A*(1+i)^n - (P/i)*((1+i)^n - 1)
  */
-float LoanCalculator::calculateLoanBalance()
+template <class Policy>
+typename Policy::Money BasicLoanCalculator<Policy>::calculateLoanBalance()
 {
+  LOAN_STATS_SCOPE(LOAN_OP_BALANCE);
+
+  if(rateSchedule_ != NULL)
+  {
+    if(!amountSet_ || !interestSet_ || !periodElapsedSet_ || !periodTotalSet_)
+    {
+      throw invalid_argument("Must set loan amount, interest, total and elapsed period for this calculation" );
+    }
+
+    // The loan that calculatePayment() and the -cs schedule amortize
+    return Policy::fromDouble(
+             rateSchedule_->calculateBalance(Policy::toDouble(calculateFinancedAmount()), interest_, periodTotal_,
+                                             periodsPerYear_, periodElapsed_));
+  }
+
   if(!amountSet_ || !interestSet_ || !periodElapsedSet_ || !paymentSet_)
   {
     throw invalid_argument("Must set loan amount, interest, and elapsed period for this calculation" );
   }
 
-  return (amount_*pow((1+interestPeriodic_), periodElapsed_)) -
-         (payment_/interestPeriodic_)*(pow((1+interestPeriodic_), periodElapsed_)-1);
+  double growth, accumulation;
+  if(rateTable_ != NULL && periodsPerYear_ == LOAN_MONTHLY &&
+     rateTable_->getGrowth(interest_, periodElapsed_, growth, accumulation))
+  {
+    return Policy::fromDouble(Policy::toDouble(amount_)*growth - Policy::toDouble(payment_)*accumulation);
+  }
+
+  return Policy::fromDouble(
+           loanBalance(Policy::toDouble(amount_), Policy::toDouble(payment_), interestPeriodic_, periodElapsed_,
+                       getGrowthFactor()));
 }
 
 /**
  * Payment amount on a loan:
  *   P = i*A / (1 - (1+i)^-N)
  */
-float LoanCalculator::calculatePayment()
+template <class Policy>
+typename Policy::Money BasicLoanCalculator<Policy>::calculatePayment()
 {
+  LOAN_STATS_SCOPE(LOAN_OP_PAYMENT);
+
   if(!amountSet_ || !interestSet_ || !periodTotalSet_)
   {
     throw invalid_argument("Must set loan amount, interest, and total period for this calculation" );
   }
 
-  float totalAmount = amount_ - initialPayment_;
-  totalAmount = totalAmount + openingFee_ + (totalAmount * (openingPercent_/100.0));
+  Money totalAmount = calculateFinancedAmount();
+
+  if(rateSchedule_ != NULL)
+  {
+    return Policy::fromDouble(
+             rateSchedule_->calculatePayment(Policy::toDouble(totalAmount), interest_, periodTotal_,
+                                             periodsPerYear_, (periodElapsedSet_ ? periodElapsed_ : 0)));
+  }
+
+  double annuity;
+  if(rateTable_ != NULL && periodsPerYear_ == LOAN_MONTHLY &&
+     rateTable_->getAnnuity(interest_, periodTotal_, annuity))
+  {
+    return Policy::fromDouble(Policy::toDouble(totalAmount)*annuity);
+  }
 
-  return (interestPeriodic_*totalAmount) /
-         (1 - pow((1+interestPeriodic_), (-1*periodTotal_)));
+  return Policy::fromDouble(
+           loanPayment(Policy::toDouble(totalAmount), interestPeriodic_, periodTotal_, getDiscountFactor()));
 }
 
 /**
@@ -67,115 +180,212 @@ float LoanCalculator::calculatePayment()
  *      If you pay her back $100 a month, how long will it take?
  *      Solution:  6% per year is 0.5% per month, or 0.005. P = 100 and A = 3500. N = 38.57
  */
-float LoanCalculator::calculateNumberPayments()
+template <class Policy>
+typename Policy::Real BasicLoanCalculator<Policy>::calculateNumberPayments()
 {
+  LOAN_STATS_SCOPE(LOAN_OP_NUMPAYMENTS);
+
   if(!amountSet_ || !interestSet_ || !paymentSet_)
   {
     throw invalid_argument("Must set loan amount, interest, and payment for this calculation" );
   }
+  if(rateSchedule_ != NULL)
+  {
+    throw invalid_argument("Cant calculate the number of payments with a rate schedule" );
+  }
 
-  return (-1.0*log10(1.0-(interestPeriodic_*amount_/payment_))) /
-         log10(1.0 + interestPeriodic_);
+  return loanNumberPayments(Policy::toDouble(amount_), Policy::toDouble(payment_), interestPeriodic_);
 }
 
 /**
  * Original loan amount:
  *   A = (P/i)*(1 - (1+i)^-N)
  */
-float LoanCalculator::calculateLoanAmount()
+template <class Policy>
+typename Policy::Money BasicLoanCalculator<Policy>::calculateLoanAmount()
 {
+  LOAN_STATS_SCOPE(LOAN_OP_AMOUNT);
+
   if(!paymentSet_ || !interestSet_ || !periodTotalSet_)
   {
     throw invalid_argument("Must set payment, interest, and total period for this calculation" );
   }
+  if(rateSchedule_ != NULL)
+  {
+    throw invalid_argument("Cant calculate the loan amount with a rate schedule" );
+  }
 
-  return (payment_/interestPeriodic_) *
-         (1 - pow((1+interestPeriodic_), (-1*periodTotal_)));
+  double presentValue;
+  if(rateTable_ != NULL && periodsPerYear_ == LOAN_MONTHLY &&
+     rateTable_->getPresentValue(interest_, periodTotal_, presentValue))
+  {
+    return Policy::fromDouble(Policy::toDouble(payment_)*presentValue);
+  }
+
+  return Policy::fromDouble(
+           loanAmount(Policy::toDouble(payment_), interestPeriodic_, periodTotal_, getDiscountFactor()));
 }
 
 /**
- * Interest Rate:
- *   i = (((1 + P/A)^(1/q) - 1 )^q - 1)  NOTICE: This is an approximate not an exact solution
+ * Interest Rate, solving P = i*A / (1 - (1+i)^-N) for i with LoanRateSolver,
+ * seeded with the approximation:
+ *   i = (((1 + P/A)^(1/q) - 1 )^q - 1)
  *   where q = log(1+1/N) / log(2)
 */
-float LoanCalculator::calculateInterestRate()
+template <class Policy>
+typename Policy::Real BasicLoanCalculator<Policy>::calculateInterestRate()
 {
+  LOAN_STATS_SCOPE(LOAN_OP_INTEREST);
+
   if(!amountSet_ || !paymentSet_ || !periodTotalSet_)
   {
     throw invalid_argument("Must set amount, payment, and total period for this calculation" );
   }
 
-  float q = log10(1.0 + 1.0/periodTotal_) / log10(2.0);
-  float monthlyInterest = pow((pow((1.0 + payment_/amount_), 1.0/q) -1.0), q) -1.0;
+  Real periodicInterest = solveRate(Policy::toDouble(amount_), Policy::toDouble(payment_), periodTotal_);
 
-  return monthlyInterest*12*100;
+  return periodicInterest*periodsPerYear_*100;
 }
 
-float LoanCalculator::calculateEffectiveInterestRate()
+template <class Policy>
+typename Policy::Real BasicLoanCalculator<Policy>::calculateEffectiveInterestRate()
 {
+  LOAN_STATS_SCOPE(LOAN_OP_EFFECTIVE_INTEREST);
+
   if(!amountSet_ || !periodTotalSet_)
   {
     throw invalid_argument("Must set amount and total period for this calculation" );
   }
 
-  float payment = calculatePayment();
-  float totalAmount = amount_ - initialPayment_;
+  Money payment = calculatePayment();
+  Money totalAmount = amount_ - initialPayment_;
+
+  Real periodicInterest = solveRate(Policy::toDouble(totalAmount), Policy::toDouble(payment), periodTotal_);
+
+  return periodicInterest*periodsPerYear_*100;
+}
+
+template <class Policy>
+typename Policy::Money BasicLoanCalculator<Policy>::calculateFinancedAmount()
+{
+  LOAN_STATS_SCOPE(LOAN_OP_FINANCED_AMOUNT);
+
+  if(!amountSet_)
+  {
+    throw invalid_argument("Must set loan amount for this calculation" );
+  }
+
+  Money totalAmount = amount_ - initialPayment_;
+  return totalAmount + openingFee_ + Policy::percentOf(totalAmount, openingPercent_);
+}
+
+// Append to buffer as with printf(), truncating if it doesnt fit
+static void appendFormat(char *buffer, size_t size, size_t &length, const char *fmt, ...)
+#ifdef __GNUC__
+  __attribute__((format(printf, 4, 5)))
+#endif
+  ;
 
-  float q = log10(1.0 + 1.0/periodTotal_) / log10(2.0);
-  float monthlyInterest = pow((pow((1.0 + payment/totalAmount), 1.0/q) -1.0), q) -1.0;
+static void appendFormat(char *buffer, size_t size, size_t &length, const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  int written = vsnprintf(buffer + length, size - length, fmt, args);
+  va_end(args);
 
-  return monthlyInterest*12*100;
+  if(written > 0)
+  {
+    length += ((size_t) written < size - length ? written : size - length - 1);
+  }
+}
+
+template <class Policy>
+std::string BasicLoanCalculator<Policy>::toString()
+{
+  LoanArena arena(1024);
+  return toString(arena);
 }
 
-std::string LoanCalculator::toString()
+template <class Policy>
+const char *BasicLoanCalculator<Policy>::toString(LoanArena &arena) const
 {
-  stringstream ss;
+  // Formatted on the stack, only the result is copied to the arena
+  char buffer[1024];
+  size_t length = 0;
+  char money[64];
+  char money2[64];
 
-  //ss << "LoanCalculator set values:\n";
+  //appendFormat(buffer, sizeof(buffer), length, "LoanCalculator set values:\n");
 
   if(amountSet_)
   {
-    ss << "Initial Amount:      " << amount_ << "\n";
+    snprintf(money, sizeof(money), Policy::printfFormat(), Policy::toDouble(amount_));
+    appendFormat(buffer, sizeof(buffer), length, "Initial Amount:      %s\n", money);
   }
 
-  if(initialPayment_ != 0.0)
+  if(initialPayment_ != Money())
   {
-    ss << "Initial Payment:     " << initialPayment_ << "\n";
-    ss << "Actual Loan Amount:  " << (amount_ - initialPayment_) << "\n";
+    snprintf(money, sizeof(money), Policy::printfFormat(), Policy::toDouble(initialPayment_));
+    snprintf(money2, sizeof(money2), Policy::printfFormat(), Policy::toDouble(amount_ - initialPayment_));
+    appendFormat(buffer, sizeof(buffer), length, "Initial Payment:     %s\n", money);
+    appendFormat(buffer, sizeof(buffer), length, "Actual Loan Amount:  %s\n", money2);
   }
 
   if(interestSet_)
   {
-    ss << "Yearly Interest:     " << interest_ << "%\n";
-    //ss << "Yearly Interest:     " << interest_
-    //   << "\nMonthly Interest:    " << interestPeriodic_ << "\n";
+    appendFormat(buffer, sizeof(buffer), length, "Yearly Interest:     %g%%\n", (double) interest_);
+  }
+
+  if(rateSchedule_ != NULL)
+  {
+    appendFormat(buffer, sizeof(buffer), length, "Rate Resets:         %d\n", (int) rateSchedule_->getNumResets());
+  }
+
+  // Monthly, unless another frequency is set
+  const char *period = (periodsPerYear_ == LOAN_MONTHLY ? "months" : "payments");
+  if(periodsPerYear_ != LOAN_MONTHLY)
+  {
+    appendFormat(buffer, sizeof(buffer), length, "Payments per Year:   %d\n", periodsPerYear_);
   }
 
   if(paymentSet_)
   {
-    ss << "Monthly payment:     " << payment_ << "\n";
+    snprintf(money, sizeof(money), Policy::printfFormat(), Policy::toDouble(payment_));
+    appendFormat(buffer, sizeof(buffer), length, "%-21s%s\n",
+                 (periodsPerYear_ == LOAN_MONTHLY ? "Monthly payment:" : "Periodic payment:"), money);
   }
 
   if(periodTotalSet_)
   {
-    ss << "Loan Period:         " << periodTotal_ << " months\n";
+    appendFormat(buffer, sizeof(buffer), length, "Loan Period:         %d %s\n", periodTotal_, period);
   }
 
   if(periodElapsedSet_)
   {
-    ss << "Elapsed Period:      " << periodElapsed_ << " months\n";
+    appendFormat(buffer, sizeof(buffer), length, "Elapsed Period:      %d %s\n", periodElapsed_, period);
   }
 
-  if(openingFee_ != 0.0)
+  if(openingFee_ != Money())
   {
-      ss << "Opening Fee:       " << openingFee_ << "\n";
+    snprintf(money, sizeof(money), Policy::printfFormat(), Policy::toDouble(openingFee_));
+    appendFormat(buffer, sizeof(buffer), length, "Opening Fee:       %s\n", money);
   }
 
   if(openingPercent_ != 0.0)
   {
-    ss << "Opening Fee %:       " << openingPercent_ << "% = "
-       << openingPercent_/100*(amount_ - initialPayment_) << "\n";
+    snprintf(money, sizeof(money), Policy::printfFormat(),
+             Policy::toDouble(Policy::percentOf(amount_ - initialPayment_, openingPercent_)));
+    appendFormat(buffer, sizeof(buffer), length, "Opening Fee %%:       %g%% = %s\n",
+                 (double) openingPercent_, money);
   }
 
-  return ss.str();
+  return arena.copy(buffer, length);
 }
+
+//
+// The numeric policy instantiations, see LoanNumericPolicy.h
+//
+
+template class BasicLoanCalculator<LoanFloatPolicy>;
+template class BasicLoanCalculator<LoanDoublePolicy>;
+template class BasicLoanCalculator<LoanCentsPolicy>;
@@ -1,5 +1,5 @@
-#ifndef LOANCALCULATOR_H_INCLUDED
-#define LOANCALCULATOR_H_INCLUDED
+#ifndef LOANCALCULATOR_H_INCLUDED
+#define LOANCALCULATOR_H_INCLUDED
 
 /*
 Formulas from: http://oakroadsystems.com/math/loan.htm
@@ -26,6 +26,13 @@ Original loan amount:
 Interest Rate:
   i = (((1 + P/A)^(1/q) - 1 )^q - 1)  NOTICE: This is an approximate not an exact solution
   where q = log(1+1/N) / log(2)
+  The approximation is only used to seed LoanRateSolver, which solves
+  P = i*A / (1 - (1+i)^-N) for i exactly, see LoanRateSolver.h
+
+
+0% loans are calculated as the limits of the formulas, as P = A/N, very
+small rates without the cancellation of (1+i)^N - 1, and a loan of one
+payment exactly, see LoanFormulas.h
 
 
 Variables:
@@ -35,16 +42,38 @@ i   	the interest rate per period, not per year
       (For instance, if the loan payments are made monthly and the interest rate is 9%, then i = 9%/12 = 0.75% = 0.0075.)
 n   	the number of time periods elapsed at any given point
 N   	the total number of payments for the entire loan or investment
-P   	the amount of each equal payment
-*/
+P   	the amount of each equal payment
+*/
 
 #include <string>
 
-class LoanCalculator
+#include "LoanArena.h"
+#include "LoanCalcType.h"
+#include "LoanNumericPolicy.h"
+#include "LoanRateSolver.h"
+
+class LoanRateSchedule;
+class LoanRateTable;
+
+/**
+ * The calculator is templated on a numeric policy, see LoanNumericPolicy.h
+ * The money amounts are of type Money and the rates and percentages of
+ * type Real. All of the policies share the formulas in LoanFormulas.h
+ *
+ *   LoanCalculator        float, LoanFloatPolicy
+ *   LoanCalculatorDouble  double, LoanDoublePolicy
+ *   LoanCalculatorCents   exact fixed point cents, LoanCentsPolicy
+ */
+template <class Policy>
+class BasicLoanCalculator
 {
 public:
-  LoanCalculator();
-  ~LoanCalculator() {}
+  typedef Policy NumericPolicy;
+  typedef typename Policy::Money Money;
+  typedef typename Policy::Real Real;
+
+  BasicLoanCalculator();
+  ~BasicLoanCalculator() {}
 
   //
   // Setters and Getters
@@ -53,28 +82,36 @@ public:
   /**
    * Total loan amount A
    */
-  inline void setAmount(float A) { amount_ = A; amountSet_ = true; }
-  inline float getAmount() const { return amount_; }
+  inline void setAmount(Money A) { amount_ = A; amountSet_ = true; }
+  inline Money getAmount() const { return amount_; }
 
   /**
    * Initial down payment
    */
-  inline void setInitialPayment(float initialA)  { initialPayment_ = initialA; }
-  inline float getInitialPayment() const         { return initialPayment_; }
+  inline void setInitialPayment(Money initialA)  { initialPayment_ = initialA; }
+  inline Money getInitialPayment() const         { return initialPayment_; }
 
   /**
    * Yearly interest rate i as in 6.75
-   * Internally .0675/12 will be used
+   * Internally .0675/12 will be used, for monthly payments
    * If 6.75 is passed to setInterest()
    *    getInterest() will return 6.75
    *    getPeriodicInterest() will return .0675/12.0
    */
-  void setInterest(float i) { interest_ = i; interestPeriodic_ = i/100.0/12.0; interestSet_ = true; }
-  inline float getInterest() const         { return interest_; }
-  inline float getPeriodicInterest() const { return interestPeriodic_; }
+  void setInterest(Real i) { interest_ = i; interestPeriodic_ = i/100.0/periodsPerYear_; interestSet_ = true; }
+  inline Real getInterest() const         { return interest_; }
+  inline Real getPeriodicInterest() const { return interestPeriodic_; }
+
+  /**
+   * The number of payments a year, LOAN_MONTHLY by default, the periods
+   * and the payment are of this frequency. Throws invalid_argument if
+   * less than 1
+   */
+  void setPeriodsPerYear(int periodsPerYear);
+  inline int getPeriodsPerYear() const { return periodsPerYear_; }
 
-  void setPayment(float P)        { payment_ = P; paymentSet_ = true; }
-  inline float getPayment() const { return payment_; }
+  void setPayment(Money P)        { payment_ = P; paymentSet_ = true; }
+  inline Money getPayment() const { return payment_; }
 
   void setPeriodTotal(int N)        { periodTotal_ = N; periodTotalSet_ = true; }
   inline int getPeriodTotal() const { return periodTotal_; }
@@ -82,15 +119,21 @@ public:
   void setPeriodElapsed(int n)         { periodElapsed_ = n; periodElapsedSet_ = true; }
   inline int getPeriodElapsed() const  { return periodElapsed_; }
 
-  inline void setOpeningFee(float fee) { openingFee_ = fee; }
-  inline float getOpeningFee() const   { return openingFee_; }
+  inline void setOpeningFee(Money fee) { openingFee_ = fee; }
+  inline Money getOpeningFee() const   { return openingFee_; }
 
-  inline void setOpeningPercent(float percent) { openingPercent_ = percent; }
-  inline float getOpeningPercent() const       { return openingPercent_; }
+  inline void setOpeningPercent(Real percent) { openingPercent_ = percent; }
+  inline Real getOpeningPercent() const       { return openingPercent_; }
 
+  /**
+   * Clears the inputs, the derived values below are kept, so setting
+   * the same inputs again, as the GUI does on each change, reuses them
+   */
   inline void reset() {
-    amount_ = initialPayment_ = interest_ = interestPeriodic_ = payment_ = openingFee_ = openingPercent_ = 0.0;
+    amount_ = initialPayment_ = payment_ = openingFee_ = Money();
+    interest_ = interestPeriodic_ = openingPercent_ = Real();
     periodTotal_ = periodElapsed_ = 0;
+    periodsPerYear_ = LOAN_MONTHLY;
     amountSet_ = interestSet_ = paymentSet_ = periodTotalSet_ = periodElapsedSet_ = false;
   }
 
@@ -98,27 +141,72 @@ public:
   // The actual calculation methods
   //
 
-  float calculateLoanBalance();
-  float calculatePayment();
-  float calculateNumberPayments();
-  float calculateLoanAmount();
-  float calculateInterestRate();
+  Money calculateLoanBalance();
+  Money calculatePayment();
+  Real calculateNumberPayments();
+  Money calculateLoanAmount();
+  Real calculateInterestRate();
   // The effective interest rate, once fees have been applied
-  float calculateEffectiveInterestRate();
+  Real calculateEffectiveInterestRate();
+  // The amount financed: amount - initial payment + opening fees
+  Money calculateFinancedAmount();
+
+  // The solver used for the interest rates, with its iteration counters,
+  // which dont count the rates reused as the inputs didnt change
+  inline const LoanRateSolver &getRateSolver() const { return rateSolver_; }
+
+  /**
+   * Look up the payment, loan amount and balance factors of rates and terms
+   * on the grid of table, NULL by default, the exact formulas are used for
+   * the others, and for payments that arent monthly. The table isnt
+   * copied, and isnt cleared by reset()
+   */
+  inline void setRateTable(const LoanRateTable *table) { rateTable_ = table; }
+  inline const LoanRateTable *getRateTable() const     { return rateTable_; }
+
+  /**
+   * Adjust the rate set with setInterest() at the resets of schedule, NULL
+   * by default. The balance is calculated segment by segment, the payment
+   * recast at each reset, and calculatePayment() is the payment of the
+   * period after the elapsed period, if set, else the first. Both amortize
+   * the financed amount, see calculateFinancedAmount(). The set payment
+   * isnt used, and the number of payments and the loan amount cant
+   * be calculated. The interest rate calculations solve the fixed rate.
+   * The schedule isnt copied, and isnt cleared by reset()
+   */
+  inline void setRateSchedule(const LoanRateSchedule *schedule) { rateSchedule_ = schedule; }
+  inline const LoanRateSchedule *getRateSchedule() const        { return rateSchedule_; }
 
   std::string toString();
+  // As above, the string is allocated in arena, so no heap memory is used
+  const char *toString(LoanArena &arena) const;
 
 private:
-  float amount_;        // loan amount
+  //
+  // The derived values, each calculated again only when one of the inputs
+  // it depends on has changed since it was last calculated:
+  //   getDiscountFactor()  (1+i)^-N   i and N
+  //   getGrowthFactor()    (1+i)^n    i and n
+  //   solveRate()          the rate   A, P and N
+  // so changing the amount doesnt recalculate the pow() of the rate and
+  // term, and changing the fees doesnt solve the rate again
+  //
+  double getDiscountFactor();
+  double getGrowthFactor();
+  Real solveRate(double A, double P, int N);
+
+  Money amount_;        // loan amount
   bool amountSet_;
 
-  float initialPayment_;     // initial down payment
+  Money initialPayment_;     // initial down payment
 
-  float interest_;          // interest rate, something like 6.75
-  float interestPeriodic_;  // this will be .0675/12
+  Real interest_;          // interest rate, something like 6.75
+  Real interestPeriodic_;  // this will be .0675/12
   bool interestSet_;
 
-  float payment_;       // payment amount
+  int periodsPerYear_;     // 12, monthly payments
+
+  Money payment_;       // payment amount
   bool paymentSet_;
 
   int periodTotal_;     // total payment periods
@@ -128,9 +216,34 @@ private:
   bool periodElapsedSet_;
 
   // These two are used if loans charge a fee opening fee or percentage
-  float openingFee_;
-  float openingPercent_;
-
+  Money openingFee_;
+  Real openingPercent_;
+
+  LoanRateSolver rateSolver_;
+  const LoanRateTable *rateTable_;
+  const LoanRateSchedule *rateSchedule_;
+
+  // The derived values, and the inputs they were calculated with
+  double discountFactor_;
+  Real discountInterest_;
+  int discountPeriods_;
+  bool discountValid_;
+
+  double growthFactor_;
+  Real growthInterest_;
+  int growthPeriods_;
+  bool growthValid_;
+
+  Real solvedRate_;
+  double solvedAmount_;
+  double solvedPayment_;
+  int solvedPeriods_;
+  bool solvedValid_;
 };
-
-#endif // LOANCALCULATOR_H_INCLUDED
+
+// The instantiations, defined in LoanCalculator.cpp
+typedef BasicLoanCalculator<LoanFloatPolicy>  LoanCalculator;
+typedef BasicLoanCalculator<LoanDoublePolicy> LoanCalculatorDouble;
+typedef BasicLoanCalculator<LoanCentsPolicy>  LoanCalculatorCents;
+
+#endif // LOANCALCULATOR_H_INCLUDED
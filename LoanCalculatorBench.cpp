@@ -0,0 +1,1378 @@
+
+//
+// Micro and macro benchmarks of the loan calculations, reported as
+// ns/loan and loans/sec, and optionally written as JSON, in the format
+// of Google Benchmark, so runs of different versions can be compared.
+//
+// Each calculation is measured in 3 modes:
+//   single    one LoanCalculator call per loan
+//   batch     LoanBatch over all of the loans
+//   threads   one LoanCalculator per thread of a LoanThreadPool,
+//             as in the bulk mode of loanCalculator
+//
+// The payment, balance and loan amount are also measured with the factors
+// of the default LoanRateTable, for loans on its grid, and the build time
+// and memory of the table are reported.
+//
+// The payment of the products of the catalog, calculated with pow(), and
+// with the annuity factors of LoanProducts.h, calculated by the compiler.
+//
+// The payment is also calculated from LoanTerms with the functions of
+// LoanTerms.h, single and with the threads sharing the terms.
+//
+// The validation of the records of the bulk mode, LoanValidation.h, for
+// the payment, the time per loan of the checks alone.
+//
+// The payment is also measured with the instrumentation of LoanStats.h
+// enabled, the cost of counting and timing a call, compared to the
+// disabled calculatePayment/single.
+//
+// The payment is also measured as the GUI recalculates it while the
+// amount is typed, the rate and term unchanged, alone and with the text
+// of an amortization table, the time per keystroke.
+//
+// The balance of an adjustable rate loan, a 5/1 ARM, calculated segment
+// by segment with the closed forms, and row by row as the amortization
+// table does, the time per loan.
+//
+// A sweep of the payment over rates, terms and initial payments is
+// measured, to a column file written to /dev/null, the time per point.
+//
+// The portfolio totals of the loans are measured as the bulk mode
+// aggregates them from CSV in memory, parsing included, the time per loan.
+//
+// The interest rate is also measured through a LoanQuoteCache holding all
+// of the loans, single and threaded, the cost of a hit. The cached rates
+// are checked to be the calculated ones. The balances, not cached, are
+// checked to be the calculated ones at N = n and with payments left, and
+// with a payment of only the interest, to be the amount.
+//
+// The payment is also measured through a LoanWorkerPool, the loans
+// submitted one by one by each thread of the LoanThreadPool, the time per
+// loan until all of them are completed, with the mean batch size.
+//
+// The queue of the LoanWorkerPool is also checked with 4 producers and
+// 4 workers. The producers submit every calculation type in every
+// precision, in bursts, so the workers go to sleep and are woken up. Each
+// result must be that of the calculator, single threaded.
+//
+// The quotes of a LoanServer of this process, pipelined, one in 8 of
+// them failing, checking that the scratch arenas of the server allocate
+// nothing once warmed up.
+//
+// With -server, the quotes of a running "loanCalculator -server" are
+// measured too, one request at a time, with the latency percentiles,
+// and pipelined
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <LoanBatch.h>
+#include <LoanBulk.h>
+#include <LoanCalculator.h>
+#include <LoanPortfolio.h>
+#include <LoanProducts.h>
+#include <LoanQuoteCache.h>
+#include <LoanRateSchedule.h>
+#include <LoanRateTable.h>
+#include <LoanSchedule.h>
+#include <LoanServer.h>
+#include <LoanSimulation.h>
+#include <LoanStats.h>
+#include <LoanSweep.h>
+#include <LoanTerms.h>
+#include <LoanValidation.h>
+#include <LoanThreadPool.h>
+#include <LoanWorkerPool.h>
+
+using namespace std;
+
+enum BENCH_CALC
+{
+  BENCH_PAYMENT=0,
+  BENCH_BALANCE,
+  BENCH_NUMPAYMENTS,
+  BENCH_AMOUNT,
+  BENCH_INTEREST,
+  BENCH_EFFECTIVE_INTEREST,
+  BENCH_NUM_CALCS
+};
+
+static const char *BENCH_CALC_NAMES[BENCH_NUM_CALCS] =
+{
+  "calculatePayment",
+  "calculateLoanBalance",
+  "calculateNumberPayments",
+  "calculateLoanAmount",
+  "calculateInterestRate",
+  "calculateEffectiveInterestRate"
+};
+
+// The loans, as arrays so they can be passed to LoanBatch as they are
+struct BenchLoans
+{
+  size_t count;
+  vector<float> amount;
+  vector<float> interest;
+  vector<float> payment;
+  vector<float> openingPercent;
+  vector<int> periodTotal;
+  vector<int> periodElapsed;
+};
+
+struct BenchResult
+{
+  string name;
+  size_t iterations;
+  size_t loans;      // per iteration
+  double seconds;    // total
+  double p50Ns;      // latency percentiles, 0 if not measured
+  double p99Ns;
+
+  inline double getNsPerLoan() const     { return seconds*1e9/(iterations*(double) loans); }
+  inline double getLoansPerSecond() const { return (iterations*(double) loans)/seconds; }
+};
+
+// Keeps the compiler from removing the calculations
+static volatile float benchSink;
+
+//
+// Deterministic loans of varied amounts, rates and periods, with payments
+// 5% above the calculated payment, so that every calculation has a solution
+//
+static void createLoans(size_t count, BenchLoans &loans)
+{
+  loans.count = count;
+  loans.amount.resize(count);
+  loans.interest.resize(count);
+  loans.payment.resize(count);
+  loans.openingPercent.resize(count);
+  loans.periodTotal.resize(count);
+  loans.periodElapsed.resize(count);
+
+  unsigned int seed = 12345;
+  LoanCalculator calculator;
+  for(size_t loan = 0; loan < count; ++loan)
+  {
+    seed = seed*1103515245 + 12345;
+    loans.amount[loan] = 5000 + (seed >> 8)%45000;
+    loans.interest[loan] = 1.0 + ((seed >> 4)%1400)/100.0;
+    loans.periodTotal[loan] = 12*(1 + (seed >> 12)%30);
+    loans.periodElapsed[loan] = loans.periodTotal[loan]/3;
+    loans.openingPercent[loan] = ((seed >> 16)%300)/100.0;
+
+    calculator.reset();
+    calculator.setAmount(loans.amount[loan]);
+    calculator.setInterest(loans.interest[loan]);
+    calculator.setPeriodTotal(loans.periodTotal[loan]);
+    loans.payment[loan] = calculator.calculatePayment()*1.05;
+  }
+}
+
+//
+// One calculator call per loan in [begin, end), Calc is known at compile
+// time so the benchmark loop only contains the calculation itself
+//
+template <int Calc>
+static float calculateRange(LoanCalculator &calculator, const BenchLoans &loans, size_t begin, size_t end)
+{
+  float sum = 0.0;
+
+  for(size_t loan = begin; loan < end; ++loan)
+  {
+    calculator.setAmount(loans.amount[loan]);
+    calculator.setInterest(loans.interest[loan]);
+    calculator.setPeriodTotal(loans.periodTotal[loan]);
+    calculator.setPeriodElapsed(loans.periodElapsed[loan]);
+    calculator.setPayment(loans.payment[loan]);
+
+    if(Calc == BENCH_PAYMENT)
+    {
+      sum += calculator.calculatePayment();
+    }
+    else if(Calc == BENCH_BALANCE)
+    {
+      sum += calculator.calculateLoanBalance();
+    }
+    else if(Calc == BENCH_NUMPAYMENTS)
+    {
+      sum += calculator.calculateNumberPayments();
+    }
+    else if(Calc == BENCH_AMOUNT)
+    {
+      sum += calculator.calculateLoanAmount();
+    }
+    else if(Calc == BENCH_INTEREST)
+    {
+      sum += calculator.calculateInterestRate();
+    }
+    else if(Calc == BENCH_EFFECTIVE_INTEREST)
+    {
+      calculator.setOpeningPercent(loans.openingPercent[loan]);
+      sum += calculator.calculateEffectiveInterestRate();
+    }
+  }
+
+  return sum;
+}
+
+//
+// The payment of the products of the catalog, cycling through them, with
+// their constant factors or calculated as any other loan
+//
+static float calculateProducts(LoanCalculatorDouble &calculator, const BenchLoans &loans, bool factors)
+{
+  float sum = 0.0;
+
+  for(size_t loan = 0; loan < loans.count; ++loan)
+  {
+    const LoanProduct &product = LOAN_PRODUCTS[loan%LOAN_NUM_PRODUCTS];
+    if(factors)
+    {
+      sum += loans.amount[loan]*product.annuity;
+    }
+    else
+    {
+      calculator.setAmount(loans.amount[loan]);
+      calculator.setInterest(product.interest);
+      calculator.setPeriodTotal(product.periodTotal);
+      sum += calculator.calculatePayment();
+    }
+  }
+
+  return sum;
+}
+
+typedef float (*RangeFunction)(LoanCalculator &, const BenchLoans &, size_t, size_t);
+
+static const RangeFunction RANGE_FUNCTIONS[BENCH_NUM_CALCS] =
+{
+  calculateRange<BENCH_PAYMENT>,
+  calculateRange<BENCH_BALANCE>,
+  calculateRange<BENCH_NUMPAYMENTS>,
+  calculateRange<BENCH_AMOUNT>,
+  calculateRange<BENCH_INTEREST>,
+  calculateRange<BENCH_EFFECTIVE_INTEREST>
+};
+
+//
+// The 3 modes, each runs one iteration over all of the loans
+//
+
+static void runSingle(int calc, const BenchLoans &loans, const LoanRateTable *table = NULL)
+{
+  LoanCalculator calculator;
+  calculator.setRateTable(table);
+  benchSink = RANGE_FUNCTIONS[calc](calculator, loans, 0, loans.count);
+}
+
+static void runBatch(int calc, const BenchLoans &loans, vector<float> &output)
+{
+  LoanBatch batch;
+  batch.setInputs(loans.count, &loans.amount[0], &loans.interest[0],
+                  &loans.periodTotal[0], &loans.periodElapsed[0]);
+
+  float *out = &output[0];
+  if(calc == BENCH_PAYMENT)
+  {
+    batch.setOutputs(out, NULL, NULL, NULL, NULL);
+  }
+  else if(calc == BENCH_BALANCE)
+  {
+    batch.setPayments(&loans.payment[0]);
+    batch.setOutputs(NULL, out, NULL, NULL, NULL);
+  }
+  else if(calc == BENCH_NUMPAYMENTS)
+  {
+    batch.setPayments(&loans.payment[0]);
+    batch.setOutputs(NULL, NULL, out, NULL, NULL);
+  }
+  else if(calc == BENCH_AMOUNT)
+  {
+    batch.setPayments(&loans.payment[0]);
+    batch.setOutputs(NULL, NULL, NULL, out, NULL);
+  }
+  else if(calc == BENCH_INTEREST)
+  {
+    batch.setPayments(&loans.payment[0]);
+    batch.setOutputs(NULL, NULL, NULL, NULL, out);
+  }
+  else if(calc == BENCH_EFFECTIVE_INTEREST)
+  {
+    // Without payments the rate of the calculated payment, fees included, is
+    // solved, which is the effective interest rate when there is no initial payment
+    batch.setOpeningPercents(&loans.openingPercent[0]);
+    batch.setOutputs(NULL, NULL, NULL, NULL, out);
+  }
+
+  batch.calculate();
+  benchSink = output[loans.count/2];
+}
+
+static void runThreads(int calc, const BenchLoans &loans, LoanThreadPool &pool, vector<float> &sums)
+{
+  pool.parallelFor(loans.count, [&] (size_t begin, size_t end, int thread)
+  {
+    LoanCalculator calculator;
+    sums[thread] = RANGE_FUNCTIONS[calc](calculator, loans, begin, end);
+  });
+  benchSink = sums[0];
+}
+
+//
+// The payments of the terms in [begin, end), with no calculator
+//
+static float calculateTermsRange(const vector<LoanTerms> &terms, size_t begin, size_t end)
+{
+  float sum = 0.0;
+  for(size_t loan = begin; loan < end; ++loan)
+  {
+    sum += loanPayment(terms[loan]).value;
+  }
+
+  return sum;
+}
+
+static void runTermsThreads(const vector<LoanTerms> &terms, LoanThreadPool &pool, vector<float> &sums)
+{
+  pool.parallelFor(terms.size(), [&] (size_t begin, size_t end, int thread)
+  {
+    sums[thread] = calculateTermsRange(terms, begin, end);
+  });
+  benchSink = sums[0];
+}
+
+//
+// The results of calcType of the loans in [begin, end) through cache
+//
+static float calculateCachedRange(CALC_TYPE calcType, LoanQuoteCache &cache, const BenchLoans &loans,
+                                  size_t begin, size_t end)
+{
+  LoanCalculator calculator;
+  double values[LOAN_RECORD_FIELDS] = {0.0};
+  double results[LOAN_RECORD_MAX_RESULTS];
+  float sum = 0.0;
+
+  for(size_t loan = begin; loan < end; ++loan)
+  {
+    values[0] = loans.amount[loan];
+    values[1] = loans.interest[loan];
+    values[2] = loans.periodTotal[loan];
+    values[3] = loans.payment[loan];
+    calculateLoanRecordCached(&cache, 0, calcType, calculator, values, results);
+    sum += results[0];
+  }
+
+  return sum;
+}
+
+//
+// The balances of the loans through a cache, at N = n, then with payments
+// left, N = n + 12, then with a payment of only the interest, A*i, that
+// leaves the amount owed after any n, none of them looked up. Then the
+// interest rates of the loans, twice, the second time all hits. Throws
+// runtime_error if a result through the cache isnt the calculated one, an
+// interest only balance isnt the amount, or a balance is looked up
+//
+static void checkCachedQuotes(const BenchLoans &loans)
+{
+  LoanQuoteCache cache(4*loans.count);
+  LoanCalculatorDouble calculator;
+  double values[LOAN_RECORD_FIELDS] = {0.0};
+  double cached[LOAN_RECORD_MAX_RESULTS];
+  double calculated[LOAN_RECORD_MAX_RESULTS];
+
+  for(int pass = 0; pass < 3; ++pass)
+  {
+    for(size_t loan = 0; loan < loans.count; ++loan)
+    {
+      values[0] = loans.amount[loan];
+      values[1] = loans.interest[loan];
+      values[2] = loans.periodElapsed[loan] + (pass == 1 ? 12 : 0);
+      values[3] = (pass == 2 ? values[0]*values[1]/100.0/12.0 : loans.payment[loan]);
+      values[4] = loans.periodElapsed[loan];
+      calculateLoanRecordCached(&cache, 1, CALC_BALANCE, calculator, values, cached);
+      calculateLoanRecord(CALC_BALANCE, calculator, values, calculated);
+
+      if(cached[0] != calculated[0] || (pass == 2 && fabs(cached[0] - values[0]) > 1e-6*values[0]))
+      {
+        char message[128];
+        snprintf(message, sizeof(message), "Cached balance %.2f of loan %lu, calculated %.2f, amount %.2f",
+                 cached[0], (unsigned long) loan, calculated[0], values[0]);
+        throw runtime_error(message);
+      }
+    }
+  }
+
+  if(cache.getHits() + cache.getMisses() > 0)
+  {
+    throw runtime_error("Balances looked up in the cache");
+  }
+
+  uint64_t firstHits = 0;
+  for(int pass = 0; pass < 2; ++pass)
+  {
+    firstHits = (pass == 1 ? cache.getHits() : 0);
+    for(size_t loan = 0; loan < loans.count; ++loan)
+    {
+      values[0] = loans.amount[loan];
+      values[1] = 0.0;
+      values[2] = loans.periodTotal[loan];
+      values[3] = loans.payment[loan];
+      values[4] = 0.0;
+      calculateLoanRecordCached(&cache, 1, CALC_INTEREST, calculator, values, cached);
+      calculateLoanRecord(CALC_INTEREST, calculator, values, calculated);
+
+      if(cached[0] != calculated[0])
+      {
+        char message[128];
+        snprintf(message, sizeof(message), "Cached interest rate %.6f of loan %lu, calculated %.6f",
+                 cached[0], (unsigned long) loan, calculated[0]);
+        throw runtime_error(message);
+      }
+    }
+  }
+
+  if(cache.getHits() - firstHits != loans.count)
+  {
+    throw runtime_error("Interest rates not found in the cache");
+  }
+}
+
+static void runCachedThreads(CALC_TYPE calcType, LoanQuoteCache &cache, const BenchLoans &loans,
+                             LoanThreadPool &pool, vector<float> &sums)
+{
+  pool.parallelFor(loans.count, [&] (size_t begin, size_t end, int thread)
+  {
+    sums[thread] = calculateCachedRange(calcType, cache, loans, begin, end);
+  });
+  benchSink = sums[0];
+}
+
+//
+// Edits of the amount of one loan, the rate, term and fee staying those of
+// the first loan, recalculated as the GUI does on each edit: the inputs set
+// again after a reset(), and the payment, or the payment and its 30 year
+// amortization table formatted as text
+//
+static float calculateEdits(LoanCalculator &calculator, const BenchLoans &loans, size_t count, bool schedule)
+{
+  float sum = 0.0;
+
+  for(size_t edit = 0; edit < count; ++edit)
+  {
+    calculator.reset();
+    calculator.setAmount(loans.amount[edit]);
+    calculator.setInterest(loans.interest[0]);
+    calculator.setPeriodTotal(schedule ? 360 : loans.periodTotal[0]);
+    calculator.setOpeningPercent(loans.openingPercent[0]);
+
+    float payment = calculator.calculatePayment();
+    sum += payment;
+
+    if(schedule)
+    {
+      ostringstream os;
+      LoanScheduleTextSink sink(os);
+      sink.writeHeader();
+
+      LoanSchedule amortization(calculator.calculateFinancedAmount(), calculator.getInterest(), 360, payment);
+      amortization.generate(sink);
+      sum += os.tellp();
+    }
+  }
+
+  return sum;
+}
+
+//
+// The balance of each loan as a 30 year 5/1 ARM, at its rate for 5 years, after
+// its elapsed periods, with the closed forms, or with the rows of the schedule
+//
+static double calculateArmBalances(LoanCalculatorDouble &calculator, const BenchLoans &loans, bool rows)
+{
+  double sum = 0.0;
+
+  for(size_t k = 0; k < loans.count; ++k)
+  {
+    calculator.reset();
+    calculator.setAmount(loans.amount[k]);
+    calculator.setInterest(loans.interest[k]);
+    calculator.setPeriodTotal(360);
+    calculator.setPeriodElapsed(loans.periodElapsed[k]);
+
+    if(!rows)
+    {
+      sum += calculator.calculateLoanBalance();
+      continue;
+    }
+
+    LoanSchedule schedule(loans.amount[k], loans.interest[k], 360, calculator.calculatePayment());
+    schedule.setRateSchedule(calculator.getRateSchedule());
+
+    LoanScheduleRow row[1];
+    row[0].balance = loans.amount[k];
+    for(int n = 0; n < loans.periodElapsed[k]; ++n)
+    {
+      schedule.generate(row, 1);
+    }
+    sum += row[0].balance;
+  }
+
+  return sum;
+}
+
+//
+// Run function until at least minTime seconds have elapsed
+//
+template <class Function>
+static BenchResult measure(const string &name, size_t loans, double minTime, Function function)
+{
+  typedef chrono::steady_clock Clock;
+
+  // Warm up the caches and the thread pool
+  function();
+
+  BenchResult result;
+  result.name = name;
+  result.loans = loans;
+  result.iterations = 0;
+  result.seconds = 0.0;
+  result.p50Ns = result.p99Ns = 0.0;
+
+  Clock::time_point start = Clock::now();
+  do
+  {
+    function();
+    ++result.iterations;
+    result.seconds = chrono::duration<double>(Clock::now() - start).count();
+  } while(result.seconds < minTime);
+
+  return result;
+}
+
+//
+// The payments of the loans submitted to workers by the threads of pool,
+// waiting for all of them to be completed
+//
+static void countQueuedResult(const LoanWorkResult &result, void *context)
+{
+  benchSink = (float) result.results[0];
+  ((atomic<size_t> *) context)->fetch_sub(1, memory_order_release);
+}
+
+static void runQueued(const BenchLoans &loans, LoanThreadPool &pool, LoanWorkerPool &workers)
+{
+  atomic<size_t> pending(loans.count);
+  pool.parallelFor(loans.count, [&] (size_t begin, size_t end, int)
+  {
+    LoanWorkRequest request;
+    memset(&request, 0, sizeof(request));
+    request.calcType = CALC_PAYMENT;
+    for(size_t loan = begin; loan < end; ++loan)
+    {
+      request.fields[0] = loans.amount[loan];
+      request.fields[1] = loans.interest[loan];
+      request.fields[2] = loans.periodTotal[loan];
+      workers.submit(request, countQueuedResult, &pending);
+    }
+  });
+
+  while(pending.load(memory_order_acquire) > 0)
+  {
+    this_thread::yield();
+  }
+}
+
+//
+// A request of the queue check, and its result once completed
+//
+struct QueueCheckSlot
+{
+  LoanWorkResult result;
+  atomic<size_t> *pending;
+};
+
+static void storeQueuedResult(const LoanWorkResult &result, void *context)
+{
+  QueueCheckSlot *slot = (QueueCheckSlot *) context;
+  slot->result = result;
+  slot->pending->fetch_sub(1, memory_order_release);
+}
+
+//
+// The result of request as a worker completes it, single threaded
+//
+static void calculateQueueCheck(const LoanWorkRequest &request, LoanWorkResult &result)
+{
+  static LoanCalculator floatCalculator;
+  static LoanCalculatorDouble doubleCalculator;
+  static LoanCalculatorCents centsCalculator;
+
+  result.status = 0;
+  result.numResults = 0;
+  result.message.clear();
+  try
+  {
+    CALC_TYPE calcType = (CALC_TYPE) request.calcType;
+    if(request.precision == 2)
+    {
+      result.numResults = calculateLoanRecord(calcType, centsCalculator, request.fields, result.results);
+    }
+    else if(request.precision == 1)
+    {
+      result.numResults = calculateLoanRecord(calcType, doubleCalculator, request.fields, result.results);
+    }
+    else
+    {
+      result.numResults = calculateLoanRecord(calcType, floatCalculator, request.fields, result.results);
+    }
+  }
+  catch(const exception &)
+  {
+    result.status = 1;
+    result.numResults = 0;
+  }
+
+  for(uint32_t r = 0; r < result.numResults; ++r)
+  {
+    if(!isfinite(result.results[r]))
+    {
+      result.status = 1;
+      result.numResults = 0;
+    }
+  }
+}
+
+//
+// Submit all of the requests from numProducers threads, in bursts, then
+// compare each result with the calculator. The float requests are
+// calculated with LoanBatch, so within a few float ulp. Throws
+// runtime_error on the first difference
+//
+static void runQueueCheck(const BenchLoans &loans, LoanWorkerPool &workers, int numProducers)
+{
+  static const uint32_t CALC_TYPES[] = {CALC_BALANCE, CALC_PAYMENT, CALC_NUMPAYMENTS, CALC_AMOUNT, CALC_INTEREST};
+  static const size_t BURST = 256;
+
+  vector<LoanWorkRequest> requests(loans.count);
+  for(size_t loan = 0; loan < loans.count; ++loan)
+  {
+    LoanWorkRequest &request = requests[loan];
+    memset(&request, 0, sizeof(request));
+    request.calcType = CALC_TYPES[loan%5];
+    request.precision = (loan/5)%3;
+    request.fields[0] = loans.amount[loan];
+    request.fields[1] = loans.interest[loan];
+    request.fields[2] = loans.periodTotal[loan];
+    // One in 16 cant be paid off, so their number of payments is NaN
+    request.fields[3] = (loan%16 == 15 ? 1.0 : loans.payment[loan]);
+    request.fields[4] = loans.periodElapsed[loan];
+    request.fields[7] = loans.openingPercent[loan];
+  }
+
+  vector<QueueCheckSlot> slots(loans.count);
+  atomic<size_t> pending(loans.count);
+  vector<thread> producers;
+  for(int producer = 0; producer < numProducers; ++producer)
+  {
+    producers.push_back(thread([&, producer]
+    {
+      size_t begin = loans.count*producer/numProducers;
+      size_t end = loans.count*(producer + 1)/numProducers;
+      for(size_t loan = begin; loan < end; ++loan)
+      {
+        slots[loan].pending = &pending;
+        workers.submit(requests[loan], storeQueuedResult, &slots[loan]);
+        if((loan - begin)%BURST == BURST - 1)
+        {
+          this_thread::sleep_for(chrono::microseconds(200));
+        }
+      }
+    }));
+  }
+  for(size_t producer = 0; producer < producers.size(); ++producer)
+  {
+    producers[producer].join();
+  }
+  while(pending.load(memory_order_acquire) > 0)
+  {
+    this_thread::yield();
+  }
+
+  LoanWorkResult expected;
+  for(size_t loan = 0; loan < loans.count; ++loan)
+  {
+    calculateQueueCheck(requests[loan], expected);
+    const LoanWorkResult &result = slots[loan].result;
+
+    bool same = (result.status == expected.status && result.numResults == expected.numResults);
+    for(uint32_t r = 0; same && r < expected.numResults; ++r)
+    {
+      double tolerance = (requests[loan].precision == 0 ? 1e-5*max(1.0, fabs(expected.results[r])) : 0.0);
+      same = (fabs(result.results[r] - expected.results[r]) <= tolerance);
+    }
+
+    if(!same)
+    {
+      char message[256];
+      snprintf(message, sizeof(message),
+               "Queued request %lu of type %u and precision %u is %u %.9g, calculated %u %.9g",
+               (unsigned long) loan, requests[loan].calcType, requests[loan].precision,
+               result.status, result.results[0], expected.status, expected.results[0]);
+      throw runtime_error(message);
+    }
+  }
+}
+
+//
+// Quotes of a server, numLoans requests per iteration, either one
+// request at a time, recording the latency of each, or pipelined
+//
+static BenchResult measureServer(const string &address,
+                                 const BenchLoans &loans,
+                                 double minTime,
+                                 size_t pipeline)
+{
+  typedef chrono::steady_clock Clock;
+
+  LoanServerClient client;
+  client.connect(address);
+
+  vector<LoanServerRequest> requests(loans.count);
+  for(size_t loan = 0; loan < loans.count; ++loan)
+  {
+    LoanServerRequest &request = requests[loan];
+    memset(&request, 0, sizeof(request));
+    request.id = loan;
+    request.calcType = CALC_PAYMENT;
+    request.fields[0] = loans.amount[loan];
+    request.fields[1] = loans.interest[loan];
+    request.fields[2] = loans.periodTotal[loan];
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), (pipeline > 1 ? "server/pipelined:%lu" : "server/latency"),
+           (unsigned long) pipeline);
+
+  BenchResult result;
+  result.name = name;
+  result.loans = loans.count;
+  result.iterations = 0;
+  result.seconds = 0.0;
+  result.p50Ns = result.p99Ns = 0.0;
+
+  vector<double> latencies;
+  LoanServerResponse response;
+  string message;
+
+  Clock::time_point start = Clock::now();
+  do
+  {
+    for(size_t loan = 0; loan < loans.count; loan += pipeline)
+    {
+      size_t count = (loans.count - loan < pipeline ? loans.count - loan : pipeline);
+
+      Clock::time_point sent = Clock::now();
+      client.send(&requests[loan], count);
+      for(size_t r = 0; r < count; ++r)
+      {
+        client.receive(response, message);
+        if(response.status != 0)
+        {
+          throw runtime_error("The server could not calculate a quote: " + message);
+        }
+      }
+
+      if(pipeline == 1)
+      {
+        latencies.push_back(chrono::duration<double, nano>(Clock::now() - sent).count());
+      }
+    }
+
+    ++result.iterations;
+    result.seconds = chrono::duration<double>(Clock::now() - start).count();
+  } while(result.seconds < minTime);
+
+  if(!latencies.empty())
+  {
+    sort(latencies.begin(), latencies.end());
+    result.p50Ns = latencies[latencies.size()/2];
+    result.p99Ns = latencies[(latencies.size()*99)/100];
+  }
+
+  return result;
+}
+
+//
+// Pipelined quotes of a server of this process, one in 8 of them of an
+// unsupported calculation type, so the error messages use the arena of
+// the server. Throws runtime_error if the arena allocates once warmed up
+//
+static BenchResult measureServerArena(const BenchLoans &loans, double minTime, size_t &numMallocs)
+{
+  char address[64];
+  snprintf(address, sizeof(address), "/tmp/loanCalculatorBench.%d.sock", (int) getpid());
+
+  LoanServer server(1);
+  server.listen(address);
+  thread serverThread(&LoanServer::run, &server);
+
+  vector<LoanServerRequest> requests(loans.count);
+  for(size_t loan = 0; loan < loans.count; ++loan)
+  {
+    LoanServerRequest &request = requests[loan];
+    memset(&request, 0, sizeof(request));
+    request.id = loan;
+    request.calcType = (loan % 8 == 7 ? CALC_SCHEDULE : CALC_PAYMENT);
+    request.fields[0] = loans.amount[loan];
+    request.fields[1] = loans.interest[loan];
+    request.fields[2] = loans.periodTotal[loan];
+  }
+
+  const size_t pipeline = 64;
+  LoanServerClient client;
+  LoanServerResponse response;
+  string message;
+  size_t warmMallocs = 0;
+  BenchResult result;
+
+  try
+  {
+    client.connect(address);
+
+    result = measure("arena/server/pipelined:64", loans.count, minTime, [&]
+    {
+      for(size_t loan = 0; loan < loans.count; loan += pipeline)
+      {
+        size_t count = (loans.count - loan < pipeline ? loans.count - loan : pipeline);
+        client.send(&requests[loan], count);
+        for(size_t r = 0; r < count; ++r)
+        {
+          client.receive(response, message);
+          if((response.status != 0) != (requests[response.id].calcType == CALC_SCHEDULE))
+          {
+            throw runtime_error("Unexpected status of a server quote: " + message);
+          }
+        }
+      }
+
+      // The first run warms up the arena
+      if(warmMallocs == 0)
+      {
+        warmMallocs = server.getNumMallocs();
+      }
+    });
+  }
+  catch(...)
+  {
+    server.stop();
+    serverThread.join();
+    throw;
+  }
+
+  client.close();
+  server.stop();
+  serverThread.join();
+
+  numMallocs = server.getNumMallocs();
+  if(numMallocs != warmMallocs)
+  {
+    throw runtime_error("The arena of the server allocated once warmed up");
+  }
+
+  return result;
+}
+
+static void printResult(const BenchResult &result)
+{
+  printf("%-46s %10lu %12.2f ns/loan %14.0f loans/sec",
+         result.name.c_str(), (unsigned long) result.iterations,
+         result.getNsPerLoan(), result.getLoansPerSecond());
+  if(result.p99Ns > 0.0)
+  {
+    printf("   p50 %.1f us  p99 %.1f us", result.p50Ns/1000.0, result.p99Ns/1000.0);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+static void writeJson(const string &fileName,
+                      const vector<BenchResult> &results,
+                      size_t loans,
+                      int threads)
+{
+  ofstream os(fileName.c_str());
+  if(!os)
+  {
+    throw runtime_error("Cant create " + fileName);
+  }
+
+  char date[64];
+  time_t now = time(NULL);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+  char buffer[512];
+  snprintf(buffer, sizeof(buffer),
+           "{\n"
+           "  \"context\": {\n"
+           "    \"date\": \"%s\",\n"
+           "    \"executable\": \"loanCalculatorBench\",\n"
+           "    \"num_cpus\": %d,\n"
+           "    \"threads\": %d,\n"
+           "    \"loans\": %lu\n"
+           "  },\n"
+           "  \"benchmarks\": [\n",
+           date, LoanThreadPool::getHardwareThreads(), threads, (unsigned long) loans);
+  os << buffer;
+
+  for(size_t r = 0; r < results.size(); ++r)
+  {
+    const BenchResult &result = results[r];
+    snprintf(buffer, sizeof(buffer),
+             "    {\n"
+             "      \"name\": \"%s\",\n"
+             "      \"iterations\": %lu,\n"
+             "      \"real_time\": %.4f,\n"
+             "      \"time_unit\": \"ns\",\n"
+             "      \"ns_per_loan\": %.4f,\n"
+             "      \"loans_per_second\": %.1f,\n"
+             "      \"items_per_second\": %.1f,\n"
+             "      \"p50_ns\": %.1f,\n"
+             "      \"p99_ns\": %.1f\n"
+             "    }%s\n",
+             result.name.c_str(), (unsigned long) result.iterations,
+             result.seconds*1e9/result.iterations,
+             result.getNsPerLoan(), result.getLoansPerSecond(), result.getLoansPerSecond(),
+             result.p50Ns, result.p99Ns,
+             (r + 1 < results.size() ? "," : ""));
+    os << buffer;
+  }
+
+  os << "  ]\n}\n";
+}
+
+void printUsage(const char *program)
+{
+  cerr << "Usage: " << program << " [options]\n"
+       << "   -n Set the number of loans per iteration. Default 100000\n"
+       << "   -threads Set the number of threads of the threads mode. Default 0, one per core\n"
+       << "   -min-time Set the minimum time of each benchmark in seconds. Default 0.5\n"
+       << "   -filter Only run the benchmarks whose name contains this text\n"
+       << "   -json Write the results to this JSON file\n"
+       << "   -server Also measure the quotes of a loanCalculator server at this address" << endl;
+}
+
+int main(int argc, char **argv)
+{
+  size_t numLoans(100000);
+  int numThreads(0);
+  double minTime(0.5);
+  string filter;
+  string jsonFile;
+  string serverAddress;
+
+  for(int arg = 1; arg < argc; ++arg)
+  {
+    bool hasValue = (arg + 1 < argc);
+    if(hasValue && strcmp(argv[arg], "-n") == 0)
+    {
+      numLoans = strtoul(argv[++arg], NULL, 10);
+    }
+    else if(hasValue && strcmp(argv[arg], "-threads") == 0)
+    {
+      numThreads = atoi(argv[++arg]);
+    }
+    else if(hasValue && strcmp(argv[arg], "-min-time") == 0)
+    {
+      minTime = atof(argv[++arg]);
+    }
+    else if(hasValue && strcmp(argv[arg], "-filter") == 0)
+    {
+      filter = argv[++arg];
+    }
+    else if(hasValue && strcmp(argv[arg], "-json") == 0)
+    {
+      jsonFile = argv[++arg];
+    }
+    else if(hasValue && strcmp(argv[arg], "-server") == 0)
+    {
+      serverAddress = argv[++arg];
+    }
+    else
+    {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if(numLoans == 0)
+  {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  try
+  {
+    BenchLoans loans;
+    createLoans(numLoans, loans);
+
+    LoanThreadPool pool(numThreads);
+    vector<float> output(numLoans);
+    vector<float> sums(pool.getNumThreads());
+    vector<BenchResult> results;
+
+    printf("%lu loans per iteration, %d threads\n\n",
+           (unsigned long) numLoans, pool.getNumThreads());
+
+    for(int calc = 0; calc < BENCH_NUM_CALCS; ++calc)
+    {
+      string name(BENCH_CALC_NAMES[calc]);
+
+      if(filter.empty() || (name + "/single").find(filter) != string::npos)
+      {
+        results.push_back(measure(name + "/single", numLoans, minTime,
+                                  [&] { runSingle(calc, loans); }));
+        printResult(results.back());
+      }
+
+      if(filter.empty() || (name + "/batch").find(filter) != string::npos)
+      {
+        results.push_back(measure(name + "/batch", numLoans, minTime,
+                                  [&] { runBatch(calc, loans, output); }));
+        printResult(results.back());
+      }
+
+      char threadsName[64];
+      snprintf(threadsName, sizeof(threadsName), "/threads:%d", pool.getNumThreads());
+      if(filter.empty() || (name + threadsName).find(filter) != string::npos)
+      {
+        results.push_back(measure(name + threadsName, numLoans, minTime,
+                                  [&] { runThreads(calc, loans, pool, sums); }));
+        printResult(results.back());
+      }
+    }
+
+    LoanCalculatorDouble productCalculator;
+    const char *productNames[] = {"products/calculatePayment/single", "products/annuity/single"};
+    for(int factors = 0; factors < 2; ++factors)
+    {
+      if(filter.empty() || string(productNames[factors]).find(filter) != string::npos)
+      {
+        results.push_back(measure(productNames[factors], numLoans, minTime,
+                                  [&] { benchSink = calculateProducts(productCalculator, loans, factors != 0); }));
+        printResult(results.back());
+      }
+    }
+
+    vector<LoanTerms> terms(numLoans);
+    for(size_t loan = 0; loan < numLoans; ++loan)
+    {
+      terms[loan].amount = loans.amount[loan];
+      terms[loan].interest = loans.interest[loan];
+      terms[loan].periodTotal = loans.periodTotal[loan];
+      terms[loan].periodElapsed = loans.periodElapsed[loan];
+      terms[loan].payment = loans.payment[loan];
+    }
+
+    if(filter.empty() || string("terms/calculatePayment/single").find(filter) != string::npos)
+    {
+      results.push_back(measure("terms/calculatePayment/single", numLoans, minTime,
+                                [&] { benchSink = calculateTermsRange(terms, 0, numLoans); }));
+      printResult(results.back());
+    }
+
+    char termsName[64];
+    snprintf(termsName, sizeof(termsName), "terms/calculatePayment/threads:%d", pool.getNumThreads());
+    if(filter.empty() || string(termsName).find(filter) != string::npos)
+    {
+      results.push_back(measure(termsName, numLoans, minTime,
+                                [&] { runTermsThreads(terms, pool, sums); }));
+      printResult(results.back());
+    }
+
+    // The records of the loans as the bulk mode validates them before
+    // calculating the payments, in blocks of one array per field
+    vector<double> recordFields[LOAN_RECORD_FIELDS];
+    const double *recordPointers[LOAN_RECORD_FIELDS];
+    for(int field = 0; field < LOAN_RECORD_FIELDS; ++field)
+    {
+      recordFields[field].assign(numLoans, 0.0);
+      recordPointers[field] = &recordFields[field][0];
+    }
+    for(size_t loan = 0; loan < numLoans; ++loan)
+    {
+      recordFields[0][loan] = loans.amount[loan];
+      recordFields[1][loan] = loans.interest[loan];
+      recordFields[2][loan] = loans.periodTotal[loan];
+      recordFields[3][loan] = loans.payment[loan];
+      recordFields[4][loan] = loans.periodElapsed[loan];
+      recordFields[7][loan] = loans.openingPercent[loan];
+    }
+    vector<uint8_t> invalid(numLoans);
+
+    if(filter.empty() || string("validate/calculatePayment/single").find(filter) != string::npos)
+    {
+      results.push_back(measure("validate/calculatePayment/single", numLoans, minTime,
+                                [&]
+                                {
+                                  validateLoanRecords(getLoanRecordChecks(CALC_PAYMENT), LoanFloatPolicy::getMaxAmount(),
+                                                      numLoans, recordPointers, &invalid[0]);
+                                  benchSink = invalid[numLoans - 1];
+                                }));
+      printResult(results.back());
+    }
+
+    // Each call timed with 2 reads of the clock, the payment calls
+    // calculateFinancedAmount() too, so it is 2 timed operations
+    if(LoanStats::isCompiled() &&
+       (filter.empty() || string("stats/calculatePayment/single").find(filter) != string::npos))
+    {
+      LoanStats::setEnabled(true);
+      results.push_back(measure("stats/calculatePayment/single", numLoans, minTime,
+                                [&] { runSingle(BENCH_PAYMENT, loans); }));
+      LoanStats::setEnabled(false);
+      LoanStats::clear();
+      printResult(results.back());
+    }
+
+    // The closed form calculations with a rate table, on loans
+    // whose rates are rounded to the grid of the table
+    LoanRateTable table;
+    table.build();
+    printf("%-46s %d rates x %d terms, built in %.2f ms, %lu KB\n", "rate table",
+           table.getNumRates(), table.getMaxTerm(), table.getBuildSeconds()*1000.0,
+           (unsigned long) (table.getMemoryBytes()/1024));
+
+    BenchLoans gridLoans(loans);
+    for(size_t loan = 0; loan < numLoans; ++loan)
+    {
+      float rate = floor(loans.interest[loan]/table.getRateStep() + 0.5)*table.getRateStep();
+      gridLoans.interest[loan] = max(rate, (float) table.getMinRate());
+    }
+
+    const int tableCalcs[] = {BENCH_PAYMENT, BENCH_BALANCE, BENCH_AMOUNT};
+    for(int tableCalc = 0; tableCalc < 3; ++tableCalc)
+    {
+      int calc(tableCalcs[tableCalc]);
+      string name(string("table/") + BENCH_CALC_NAMES[calc] + "/single");
+      if(filter.empty() || name.find(filter) != string::npos)
+      {
+        results.push_back(measure(name, numLoans, minTime,
+                                  [&] { runSingle(calc, gridLoans, &table); }));
+        printResult(results.back());
+      }
+    }
+
+    // As the amount is typed, the GUI only calculates the pow() of the rate
+    // and term once, and formatting the table is most of the keystroke
+    LoanCalculator editCalculator;
+    if(filter.empty() || string("edits/calculatePayment/single").find(filter) != string::npos)
+    {
+      results.push_back(measure("edits/calculatePayment/single", numLoans, minTime,
+                                [&] { benchSink = calculateEdits(editCalculator, loans, loans.count, false); }));
+      printResult(results.back());
+    }
+
+    size_t numEdits = min(numLoans, (size_t) 100);
+    if(filter.empty() || string("edits/schedule/single").find(filter) != string::npos)
+    {
+      results.push_back(measure("edits/schedule/single", numEdits, minTime,
+                                [&] { benchSink = calculateEdits(editCalculator, loans, numEdits, true); }));
+      printResult(results.back());
+    }
+
+    // Resets every year from the 61st month, at the caps, 25 segments at most
+    LoanRateSchedule armSchedule;
+    armSchedule.addResets(61, 12, 360, 9.5);
+    armSchedule.setCaps(2.0, 1.0, 5.0);
+    LoanCalculatorDouble armCalculator;
+    armCalculator.setRateSchedule(&armSchedule);
+    const char *armNames[] = {"arm/calculateLoanBalance/single", "arm/scheduleRows/single"};
+    for(int rows = 0; rows < 2; ++rows)
+    {
+      if(filter.empty() || string(armNames[rows]).find(filter) != string::npos)
+      {
+        results.push_back(measure(armNames[rows], numLoans, minTime,
+                                  [&] { benchSink = calculateArmBalances(armCalculator, loans, rows != 0); }));
+        printResult(results.back());
+      }
+    }
+
+    // 100 rates x 360 terms x 10 initial payments, the initial payments varying
+    // fastest so that the factors of each rate and term are calculated once
+    LoanSweep sweep(CALC_PAYMENT, LoanBulk::PRECISION_FLOAT, numThreads);
+    double sweepValues[LOAN_RECORD_FIELDS] = {250000.0};
+    sweep.setValues(sweepValues);
+    sweep.addAxis(1, 2.0, 11.9, 0.1);
+    sweep.addAxis(2, 1.0, 360.0, 1.0);
+    sweep.addAxis(5, 0.0, 45000.0, 5000.0);
+
+    char sweepName[64];
+    snprintf(sweepName, sizeof(sweepName), "sweep/calculatePayment/threads:%d", sweep.getNumThreads());
+    if(filter.empty() || string(sweepName).find(filter) != string::npos)
+    {
+      LoanColumnWriter writer;
+      writer.open("/dev/null");
+      results.push_back(measure(sweepName, sweep.getNumPoints(), minTime,
+                                [&] { sweep.calculate(writer); }));
+      printResult(results.back());
+    }
+
+    // Paths of a 30 year loan with prepayments, defaults and rate volatility,
+    // the time per path is of its 360 periods
+    LoanSimulation simulation(numThreads);
+    simulation.setLoan(250000.0, 6.5, 360);
+    simulation.setPrepaymentRate(8.0);
+    simulation.setDefaultRate(2.0);
+    simulation.setSeverity(40.0);
+    simulation.setRateVolatility(0.3);
+
+    char simulateName[64];
+    snprintf(simulateName, sizeof(simulateName), "simulate/paths/threads:%d", simulation.getNumThreads());
+    if(filter.empty() || string(simulateName).find(filter) != string::npos)
+    {
+      size_t numPaths = 16*LoanSimulation::BLOCK_SIZE*simulation.getNumThreads();
+      results.push_back(measure(simulateName, numPaths, minTime,
+                                [&] { simulation.run(numPaths); }));
+      printResult(results.back());
+    }
+
+    // The loans as the CSV of the bulk mode, payments calculated
+    string csv;
+    for(size_t k = 0; k < loans.count; ++k)
+    {
+      char line[128];
+      snprintf(line, sizeof(line), "%.2f,%.3f,%d,0,%d\n", loans.amount[k], loans.interest[k],
+               loans.periodTotal[k], loans.periodElapsed[k]);
+      csv += line;
+    }
+
+    LoanBulk portfolioBulk(CALC_BALANCE, LoanBulk::PRECISION_FLOAT, numThreads);
+    portfolioBulk.load(csv.data(), csv.size());
+    char portfolioName[64];
+    snprintf(portfolioName, sizeof(portfolioName), "portfolio/aggregate/threads:%d", portfolioBulk.getNumThreads());
+    if(filter.empty() || string(portfolioName).find(filter) != string::npos)
+    {
+      results.push_back(measure(portfolioName, loans.count, minTime, [&]
+      {
+        LoanPortfolio portfolio(12);
+        portfolioBulk.aggregate(portfolio);
+        benchSink = portfolio.getTotalBalance();
+      }));
+      printResult(results.back());
+    }
+
+    // Every quote a hit once the first iteration has filled the cache, with
+    // room to spare as the loans dont spread exactly evenly over the shards.
+    // Only the interest rate is cached, see isLoanQuoteCached()
+    LoanQuoteCache cache(4*numLoans);
+    string cachedName("cache/calculateInterestRate");
+    if(filter.empty() || (cachedName + "/single").find(filter) != string::npos)
+    {
+      results.push_back(measure(cachedName + "/single", numLoans, minTime,
+                                [&] { benchSink = calculateCachedRange(CALC_INTEREST, cache, loans, 0, loans.count); }));
+      printResult(results.back());
+    }
+
+    char cachedThreadsName[64];
+    snprintf(cachedThreadsName, sizeof(cachedThreadsName), "/threads:%d", pool.getNumThreads());
+    if(filter.empty() || (cachedName + cachedThreadsName).find(filter) != string::npos)
+    {
+      results.push_back(measure(cachedName + cachedThreadsName, numLoans, minTime,
+                                [&] { runCachedThreads(CALC_INTEREST, cache, loans, pool, sums); }));
+      printResult(results.back());
+    }
+
+    if(cache.getHits() + cache.getMisses() > 0)
+    {
+      printf("%-46s %lu hits, %lu misses, %lu evictions\n", "cache",
+             (unsigned long) cache.getHits(), (unsigned long) cache.getMisses(),
+             (unsigned long) cache.getEvictions());
+    }
+
+    if(filter.empty() || string("cache/check").find(filter) != string::npos)
+    {
+      checkCachedQuotes(loans);
+      printf("%-46s %lu balances not cached, %lu interest rates cached, as calculated\n", "cache/check",
+             (unsigned long) (3*loans.count), (unsigned long) loans.count);
+    }
+
+    LoanWorkerPool workers(numThreads);
+    char queueName[64];
+    snprintf(queueName, sizeof(queueName), "queue/calculatePayment/threads:%d", workers.getNumThreads());
+    if(filter.empty() || string(queueName).find(filter) != string::npos)
+    {
+      results.push_back(measure(queueName, numLoans, minTime,
+                                [&] { runQueued(loans, pool, workers); }));
+      printResult(results.back());
+
+      LoanWorkerPoolMetrics metrics;
+      workers.getMetrics(metrics);
+      printf("%-46s %lu batches, %.1f loans per batch\n", "queue",
+             (unsigned long) metrics.batches, metrics.getMeanBatchSize());
+    }
+
+    if(filter.empty() || string("arena/server/pipelined:64").find(filter) != string::npos)
+    {
+      size_t numMallocs;
+      results.push_back(measureServerArena(loans, minTime, numMallocs));
+      printResult(results.back());
+      printf("%-46s %lu blocks allocated, none once warmed up\n", "arena", (unsigned long) numMallocs);
+    }
+
+    if(filter.empty() || string("queue/check").find(filter) != string::npos)
+    {
+      LoanWorkerPool checkWorkers(4, 1024);
+      runQueueCheck(loans, checkWorkers, 4);
+
+      LoanWorkerPoolMetrics metrics;
+      checkWorkers.getMetrics(metrics);
+      printf("%-46s %lu requests of 4 producers, %.1f per batch of 4 workers, as calculated\n", "queue/check",
+             (unsigned long) metrics.completed, metrics.getMeanBatchSize());
+    }
+
+    if(!serverAddress.empty())
+    {
+      if(filter.empty() || string("server/latency").find(filter) != string::npos)
+      {
+        results.push_back(measureServer(serverAddress, loans, minTime, 1));
+        printResult(results.back());
+      }
+      if(filter.empty() || string("server/pipelined").find(filter) != string::npos)
+      {
+        results.push_back(measureServer(serverAddress, loans, minTime, 64));
+        printResult(results.back());
+      }
+    }
+
+    if(!jsonFile.empty())
+    {
+      writeJson(jsonFile, results, numLoans, pool.getNumThreads());
+    }
+  }
+  catch(const exception &e)
+  {
+    cerr << "Error executing the benchmarks: " << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
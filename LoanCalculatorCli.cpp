@@ -0,0 +1,1005 @@
+
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <CmdLineParser.h>
+#include <LoanBulk.h>
+#include <LoanCalcType.h>
+#include <LoanCalculator.h>
+#include <LoanCalculatorCli.h>
+#include <LoanPortfolio.h>
+#include <LoanQuoteCache.h>
+#include <LoanRateSchedule.h>
+#include <LoanRateTable.h>
+#include <LoanSchedule.h>
+#include <LoanServer.h>
+#include <LoanSimulation.h>
+#include <LoanStats.h>
+#include <LoanSweep.h>
+
+using namespace std;
+
+const string ARG_CALC_BALANCE      = "-cb";
+const string ARG_CALC_PAYMENT      = "-cp";
+const string ARG_CALC_NUMPAYMENTS  = "-cn";
+const string ARG_CALC_AMOUNT       = "-ca";
+const string ARG_CALC_INTEREST     = "-ci";
+const string ARG_CALC_SCHEDULE     = "-cs";
+
+const string ARG_PAYMENT           = "-p";
+const string ARG_PERIOD_TOTAL      = "-N";
+const string ARG_PERIOD_ELAPSED    = "-n";
+const string ARG_AMOUNT            = "-a";
+const string ARG_INITIAL_PAYMENT   = "-ai";
+const string ARG_INTEREST          = "-i";
+const string ARG_OPENFEE           = "-of";
+const string ARG_OPENPERCENT       = "-op";
+
+const string ARG_PERIODS_PER_YEAR  = "-ppy";
+const string ARG_RATE_RESETS       = "-rates";
+const string ARG_RATE_CAPS         = "-caps";
+const string ARG_RATE_FLOOR        = "-floor";
+
+const string ARG_PRECISION_DOUBLE  = "-dp";
+const string ARG_PRECISION_CENTS   = "-cents";
+
+const string ARG_BULK_FILE         = "-bulk";
+const string ARG_BULK_THREADS      = "-threads";
+const string ARG_BULK_BINARY       = "-binary";
+const string ARG_BULK_PORTFOLIO    = "-portfolio";
+
+const string ARG_SWEEP             = "-sweep";
+
+const string ARG_RATE_TABLE        = "-ratetable";
+const string ARG_BUILD_RATE_TABLE  = "-build-rate-table";
+
+const string ARG_SERVER            = "-server";
+const string ARG_SERVER_CACHE      = "-cache";
+
+const string ARG_SIMULATE          = "-simulate";
+const string ARG_SIM_CPR           = "-cpr";
+const string ARG_SIM_CDR           = "-cdr";
+const string ARG_SIM_SEVERITY      = "-severity";
+const string ARG_SIM_VOLATILITY    = "-volatility";
+const string ARG_SIM_SEED          = "-seed";
+
+const string ARG_STATS             = "-stats";
+
+void loadCmdLine(CmdLineParser &clp, bool withGui)
+{
+  clp.setMainHelpText("A simple loan calculator");
+  if(withGui)
+  {
+    clp.setMainHelpTextEnd("With no options set, a GUI will be launched");
+  }
+
+  // Calculation types
+  clp.addMutExclCmdLineOption(new CmdLineOptionFlag(ARG_CALC_BALANCE,
+         "Calculate the loan balance after making several payments, given:\n"
+         "\t\t loan amount, interest, monthly payment and number of monthly payments made so far",
+         false, CALC_BALANCE));
+  clp.addMutExclCmdLineOption(new CmdLineOptionFlag(ARG_CALC_PAYMENT,
+         "Calculate the monthly loan payment, given: loan amount, loan period, and interest",
+         false, CALC_PAYMENT));
+  clp.addMutExclCmdLineOption(new CmdLineOptionFlag(ARG_CALC_NUMPAYMENTS,
+         "Calculate the number of payments needed to pay a loan, given: loan amount, monthly payment, interest",
+         false, CALC_NUMPAYMENTS));
+  clp.addMutExclCmdLineOption(new CmdLineOptionFlag(ARG_CALC_AMOUNT,
+         "Calculate the initial loan amount, given: monthly payment, loan period, and interest",
+         false, CALC_AMOUNT));
+  clp.addMutExclCmdLineOption(new CmdLineOptionFlag(ARG_CALC_INTEREST,
+         "Calculate the loan interest, given: loan amount, loan period, and monthly payment",
+         false, CALC_INTEREST));
+  clp.addMutExclCmdLineOption(new CmdLineOptionFlag(ARG_CALC_SCHEDULE,
+         "Calculate the monthly amortization schedule, given: loan amount, loan period, and interest.\n"
+         "\t\t If the monthly payment is not set, it will be calculated",
+         false, CALC_SCHEDULE));
+  clp.setMutExclUsageText("Calculations");
+
+  // Different values
+  // The money amounts are parsed as text, so with -cents they are exact
+  clp.addCmdLineOption(new CmdLineOptionStr(   ARG_PAYMENT, "Set the monthly loan payment. Ej: 325.67"));
+  clp.addCmdLineOption(new CmdLineOptionInt(   ARG_PERIOD_TOTAL, "Set the total loan period in months. Ej: 60"));
+  clp.addCmdLineOption(new CmdLineOptionInt(   ARG_PERIOD_ELAPSED, "Set the elapsed period in months. Ej: 32"));
+  clp.addCmdLineOption(new CmdLineOptionInt(   ARG_AMOUNT, "Set the initial amount. Ej: 19300"));
+  clp.addCmdLineOption(new CmdLineOptionStr(   ARG_INITIAL_PAYMENT,
+         "Set the initial payment, loan will be for (initial amount - initial payment) Ej: 1000, Default 0.0"));
+  clp.addCmdLineOption(new CmdLineOptionFloat( ARG_INTEREST, "Set the yearly interest rate. Ej: 6.75"));
+  clp.addCmdLineOption(new CmdLineOptionStr(   ARG_OPENFEE, "Set fees for opening the loan. Ej: 100, Default 0.0"));
+  clp.addCmdLineOption(new CmdLineOptionFloat( ARG_OPENPERCENT,
+         "Set fees for opening the loan, charged as a percentage. Ej: 2.75%, Default 0.0%"));
+
+  // Payment frequency and adjustable rates, see LoanRateSchedule.h
+  clp.addCmdLineOption(new CmdLineOptionInt(   ARG_PERIODS_PER_YEAR,
+         "Set the number of payments per year, the periods and the payment are of this frequency.\n"
+         "\t\t Ej: 52 weekly, 26 biweekly, 4 quarterly, Default 12, monthly"));
+  clp.addCmdLineOption(new CmdLineOptionStr(   ARG_RATE_RESETS,
+         "Reset the yearly interest rate from these periods, as period:rate[:interval], the\n"
+         "\t\t interval repeating the reset to the end of the loan. The payment is recast at\n"
+         "\t\t each reset. Ej: a 5/1 ARM of a 3.5% teaser rate, index and margin 6.5%:\n"
+         "\t\t -i 3.5 -rates 61:6.5:12"));
+  clp.addCmdLineOption(new CmdLineOptionStr(   ARG_RATE_CAPS,
+         "Cap the rate resets, as initial/periodic/lifetime percentage points. Ej: 2/1/5"));
+  clp.addCmdLineOption(new CmdLineOptionFloat( ARG_RATE_FLOOR,
+         "Set the minimum rate of the rate resets. Ej: 2.5, Default 0.0"));
+
+  // Numeric precision, float by default
+  clp.addCmdLineOption(new CmdLineOptionFlag(  ARG_PRECISION_DOUBLE, "Calculate in double precision"));
+  clp.addCmdLineOption(new CmdLineOptionFlag(  ARG_PRECISION_CENTS,
+         "Calculate money amounts exactly in fixed point cents"));
+
+  // Bulk mode
+  clp.addCmdLineOption(new CmdLineOptionStr(   ARG_BULK_FILE,
+         "Calculate one loan per line of a CSV file, with the fields:\n"
+         "\t\t amount,interest,N,payment,n,initial payment,opening fee,opening percent\n"
+         "\t\t The results are printed one line per loan, in input order. Use - for stdin"));
+  clp.addCmdLineOption(new CmdLineOptionInt(   ARG_BULK_THREADS,
+         "Set the number of threads for the bulk mode. Default 0, one per core"));
+  clp.addCmdLineOption(new CmdLineOptionStr(   ARG_BULK_BINARY,
+         "Write the bulk results to this binary column file instead of as text.\n"
+         "\t\t Use loanColumnReader to convert it to text"));
+  clp.addCmdLineOption(new CmdLineOptionInt(   ARG_BULK_PORTFOLIO,
+         "Print the portfolio totals of the bulk file instead of the results of each loan:\n"
+         "\t\t the total balance, the weighted average rate and term, and the projected cash\n"
+         "\t\t flow in buckets of this many periods. Ej: 12 for yearly cash flows"));
+
+  // Sweep mode, see LoanSweep.h
+  clp.addCmdLineOption(new CmdLineOptionStr(   ARG_SWEEP,
+         "Calculate the grid of ranges of the values, as in i=2:11.99:0.01,N=1:360,ai=0:49000:1000\n"
+         "\t\t each value of a range as its option without the -, the step is 1 if not set.\n"
+         "\t\t The other values are as set. The results are printed as CSV, or written to the\n"
+         "\t\t -binary file, the last range varying fastest. Uses the -threads of the bulk mode"));
+
+  // Precomputed factors, see LoanRateTable.h
+  clp.addCmdLineOption(new CmdLineOptionStr(   ARG_RATE_TABLE,
+         "Look up the factors of the rates and terms of this table, written with:\n"
+         "\t\t -build-rate-table <file> [minRate maxRate rateStep maxTerm]"));
+
+  // Instrumentation, see LoanStats.h. Taken out of the arguments before they
+  // are parsed, so any mode, as -server or -simulate, accepts it
+  clp.addCmdLineOption(new CmdLineOptionStr(   ARG_STATS,
+         "Count the calculations and their latencies, written to this file on exit and on\n"
+         "\t\t SIGUSR1, as JSON for a .json file, else as Prometheus text. Use - for stderr"));
+  
+  clp.setMinNumberArgs(3);
+}
+
+// Map the rate table of the command line, if any, returns false if it cant
+bool loadRateTable(CmdLineParser &clp, LoanRateTable &table, bool &loaded)
+{
+  string fileName(((CmdLineOptionStr*) clp.getCmdLineOption(ARG_RATE_TABLE))->getValue());
+  loaded = false;
+  if(fileName.empty())
+  {
+    return true;
+  }
+
+  try
+  {
+    table.load(fileName);
+    loaded = true;
+  }
+  catch(const exception &e)
+  {
+    cerr << "Error loading the rate table: " << e.what() << endl;
+    return false;
+  }
+
+  return true;
+}
+
+// Add the rate resets and caps of the command line, if any, to schedule,
+// returns false if they cant be parsed
+bool loadRateSchedule(CmdLineParser &clp, LoanRateSchedule &schedule, bool &loaded)
+{
+  string resets(((CmdLineOptionStr*) clp.getCmdLineOption(ARG_RATE_RESETS))->getValue());
+  string caps(((CmdLineOptionStr*) clp.getCmdLineOption(ARG_RATE_CAPS))->getValue());
+  loaded = false;
+  if(resets.empty())
+  {
+    return true;
+  }
+
+  try
+  {
+    int periodTotal(((CmdLineOptionInt*) clp.getCmdLineOption(ARG_PERIOD_TOTAL))->getValue());
+
+    size_t start = 0;
+    while(start <= resets.size())
+    {
+      size_t end = resets.find(',', start);
+      string reset(resets.substr(start, end == string::npos ? string::npos : end - start));
+      start = (end == string::npos ? resets.size() + 1 : end + 1);
+
+      int period, interval;
+      double rate;
+      int fields = sscanf(reset.c_str(), "%d:%lf:%d", &period, &rate, &interval);
+      if(fields == 3)
+      {
+        schedule.addResets(period, interval, periodTotal, rate);
+      }
+      else if(fields == 2)
+      {
+        schedule.addReset(period, rate);
+      }
+      else
+      {
+        throw invalid_argument("Invalid rate reset: " + reset);
+      }
+    }
+
+    if(!caps.empty())
+    {
+      double initialCap, periodicCap, lifetimeCap;
+      if(sscanf(caps.c_str(), "%lf/%lf/%lf", &initialCap, &periodicCap, &lifetimeCap) != 3)
+      {
+        throw invalid_argument("Invalid rate caps: " + caps);
+      }
+      schedule.setCaps(initialCap, periodicCap, lifetimeCap);
+    }
+    schedule.setFloor(((CmdLineOptionFloat*) clp.getCmdLineOption(ARG_RATE_FLOOR))->getValue());
+    loaded = true;
+  }
+  catch(const exception &e)
+  {
+    cerr << "Error loading the rate schedule: " << e.what() << endl;
+    return false;
+  }
+
+  return true;
+}
+
+//
+// Simple Command line parser
+//
+CALC_TYPE parseCommandLine(int argc, char **argv, CmdLineParser &clp)
+{
+  CALC_TYPE ct(CALC_UNKNOWN);
+
+  if(!clp.parseCmdLine(argc, argv))
+  {
+    clp.printUsage();
+    return ct;
+  }
+
+  CmdLineOption *option(clp.getMutExclOption());
+  if(option != NULL) // cant be NULL, else the parser mutExcl checking didnt work
+  {
+    ct = (CALC_TYPE) ((CmdLineOptionFlag*) option)->getValueKey();
+  }
+
+  return ct;
+}
+
+// A money amount of the command line, 0.0 if not set
+static double getMoneyOption(CmdLineParser &clp, const string &name)
+{
+  string text(((CmdLineOptionStr*) clp.getCmdLineOption(name))->getValue());
+  if(text.empty())
+  {
+    return 0.0;
+  }
+
+  char *end;
+  double amount = strtod(text.c_str(), &end);
+  if(*end != '\0')
+  {
+    throw invalid_argument("Invalid amount: " + text);
+  }
+
+  return amount;
+}
+
+// As the Money of the policy, the cents parsed from the text so they are
+// exact, not rounded to a float or double first
+template <class Policy>
+static typename Policy::Money getMoneyOption(CmdLineParser &clp, const string &name)
+{
+  return Policy::fromDouble(getMoneyOption(clp, name));
+}
+
+template <>
+LoanCents getMoneyOption<LoanCentsPolicy>(CmdLineParser &clp, const string &name)
+{
+  string text(((CmdLineOptionStr*) clp.getCmdLineOption(name))->getValue());
+  return (text.empty() ? LoanCents() : LoanCents::fromString(text));
+}
+
+// Set the parsed command line values on the calculator
+template <class Calculator>
+void setCalculatorInputs(CmdLineParser &clp, Calculator &calculator)
+{
+  typedef typename Calculator::NumericPolicy Policy;
+
+  int periodsPerYear(((CmdLineOptionInt*) clp.getCmdLineOption(ARG_PERIODS_PER_YEAR))->getValue());
+  if(periodsPerYear != 0)
+  {
+    calculator.setPeriodsPerYear(periodsPerYear);
+  }
+
+  calculator.setAmount(Policy::fromDouble(
+       ((CmdLineOptionInt*)   clp.getCmdLineOption(ARG_AMOUNT))->getValue()));
+  calculator.setInitialPayment(getMoneyOption<Policy>(clp, ARG_INITIAL_PAYMENT));
+  calculator.setInterest(
+       ((CmdLineOptionFloat*) clp.getCmdLineOption(ARG_INTEREST))->getValue());
+  calculator.setPayment(getMoneyOption<Policy>(clp, ARG_PAYMENT));
+  calculator.setPeriodTotal(
+       ((CmdLineOptionInt*)   clp.getCmdLineOption(ARG_PERIOD_TOTAL))->getValue());
+  calculator.setPeriodElapsed(
+       ((CmdLineOptionInt*)   clp.getCmdLineOption(ARG_PERIOD_ELAPSED))->getValue());
+  calculator.setOpeningFee(getMoneyOption<Policy>(clp, ARG_OPENFEE));
+  calculator.setOpeningPercent(
+       ((CmdLineOptionFloat*) clp.getCmdLineOption(ARG_OPENPERCENT))->getValue());
+}
+
+//
+// Execute the calculation and print the results, with the
+// precision of the calculator's numeric policy
+//
+template <class Calculator>
+int runCalculation(CALC_TYPE ct, CmdLineParser &clp, Calculator &calculator)
+{
+  typedef typename Calculator::Money Money;
+
+  try
+  {
+    cout << endl;
+
+    if(ct == CALC_UNKNOWN)
+    {
+      // most likely the case that help was selected
+      return 1;
+    }
+
+    setCalculatorInputs(clp, calculator);
+
+    if(ct == CALC_BALANCE)
+    {
+        cout << "Loan Balance = " << calculator.calculateLoanBalance() << endl;
+    }
+    else if(ct == CALC_PAYMENT)
+    {
+      // Monthly, unless another frequency is set, as in toString()
+      Money payment = calculator.calculatePayment();
+      cout << (calculator.getPeriodsPerYear() == LOAN_MONTHLY ? "Monthly Payment    = " : "Periodic Payment   = ")
+           << payment << "\n"
+           << "Total amt paid     = " << (payment*calculator.getPeriodTotal())
+           << endl;
+
+      if(calculator.getOpeningPercent() != 0.0 || calculator.getOpeningFee() != Money())
+      {
+        cout << "Interest with fees = "
+             << calculator.calculateEffectiveInterestRate()
+             << "%"
+             << endl;
+      }
+    }
+    else if(ct == CALC_NUMPAYMENTS)
+    {
+      cout << "Number of payments = " << calculator.calculateNumberPayments() << endl;
+    }
+    else if(ct == CALC_AMOUNT)
+    {
+      cout << "Initial Loan amount = " << calculator.calculateLoanAmount() << endl;
+    }
+    else if(ct == CALC_INTEREST)
+    {
+      cout << "Yearly Interest Rate = " << calculator.calculateInterestRate() << "%" << endl;
+    }
+    else if(ct == CALC_SCHEDULE)
+    {
+      typedef typename Calculator::NumericPolicy Policy;
+
+      Money payment = calculator.getPayment();
+      if(payment == Money())
+      {
+        payment = calculator.calculatePayment();
+        calculator.setPayment(payment);
+      }
+
+      LoanSchedule schedule(Policy::toDouble(calculator.calculateFinancedAmount()),
+                            calculator.getInterest(),
+                            calculator.getPeriodTotal(),
+                            Policy::toDouble(payment),
+                            calculator.getPeriodsPerYear());
+      schedule.setRateSchedule(calculator.getRateSchedule());
+      schedule.setRoundToCents(
+           ((CmdLineOptionFlag*) clp.getCmdLineOption(ARG_PRECISION_CENTS))->getValue());
+
+      LoanScheduleTextSink sink(cout);
+      sink.writeHeader();
+      schedule.generate(sink);
+      cout << endl;
+    }
+    else
+    {
+      cerr << "Unrecognized calculation type, exiting" << endl;
+      return 0;
+    }
+
+    // print the values set on the calculator
+    LoanArena arena(1024);
+    cout << calculator.toString(arena) << endl;
+  }
+  catch(const exception &e)
+  {
+    cerr << "Error executing loan calculator: " << + e.what() << endl;
+    //printUsage();
+    //return 0;
+  }
+
+  cout << endl;
+
+  return 0;
+}
+
+//
+// Calculate every loan in the bulk file, with the precision set on the command line
+//
+int runBulkCalculation(CALC_TYPE ct, CmdLineParser &clp)
+{
+  LoanBulk::PRECISION precision(LoanBulk::PRECISION_FLOAT);
+  if(((CmdLineOptionFlag*) clp.getCmdLineOption(ARG_PRECISION_CENTS))->getValue())
+  {
+    precision = LoanBulk::PRECISION_CENTS;
+  }
+  else if(((CmdLineOptionFlag*) clp.getCmdLineOption(ARG_PRECISION_DOUBLE))->getValue())
+  {
+    precision = LoanBulk::PRECISION_DOUBLE;
+  }
+
+  try
+  {
+    LoanRateTable table;
+    bool tableLoaded;
+    if(!loadRateTable(clp, table, tableLoaded))
+    {
+      return 1;
+    }
+
+    LoanBulk bulk(ct, precision,
+                  ((CmdLineOptionInt*) clp.getCmdLineOption(ARG_BULK_THREADS))->getValue());
+    bulk.setRateTable(tableLoaded ? &table : NULL);
+    bulk.loadFile(((CmdLineOptionStr*) clp.getCmdLineOption(ARG_BULK_FILE))->getValue());
+
+    size_t errors;
+    int bucketPeriods(((CmdLineOptionInt*) clp.getCmdLineOption(ARG_BULK_PORTFOLIO))->getValue());
+    string binaryFile(((CmdLineOptionStr*) clp.getCmdLineOption(ARG_BULK_BINARY))->getValue());
+    if(bucketPeriods != 0)
+    {
+      LoanPortfolio portfolio(bucketPeriods);
+      errors = bulk.aggregate(portfolio);
+      portfolio.write(cout);
+    }
+    else if(!binaryFile.empty())
+    {
+      LoanColumnWriter writer;
+      writer.open(binaryFile);
+      errors = bulk.calculate(writer);
+    }
+    else
+    {
+      errors = bulk.calculate(cout);
+    }
+
+    if(errors > 0)
+    {
+      cerr << errors << " of " << bulk.getNumRecords() << " loans could not be calculated" << endl;
+    }
+  }
+  catch(const exception &e)
+  {
+    cerr << "Error executing loan calculator: " << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+//
+// Sweep the ranges of the command line, as in i=2:11.99:0.01,N=1:360,ai=0:49000:1000
+//
+static void addSweepAxes(const string &ranges, LoanSweep &sweep)
+{
+  // The options of the fields of LoanRecord.h
+  const string *FIELD_OPTIONS[LOAN_RECORD_FIELDS] =
+  {
+    &ARG_AMOUNT, &ARG_INTEREST, &ARG_PERIOD_TOTAL, &ARG_PAYMENT,
+    &ARG_PERIOD_ELAPSED, &ARG_INITIAL_PAYMENT, &ARG_OPENFEE, &ARG_OPENPERCENT
+  };
+
+  size_t begin = 0;
+  while(begin < ranges.size())
+  {
+    size_t end = ranges.find(',', begin);
+    end = (end == string::npos ? ranges.size() : end);
+    string range(ranges.substr(begin, end - begin));
+    begin = end + 1;
+
+    size_t equals = range.find('=');
+    string name(range.substr(0, equals));
+    int field = 0;
+    while(field < LOAN_RECORD_FIELDS && FIELD_OPTIONS[field]->compare(1, string::npos, name) != 0)
+    {
+      ++field;
+    }
+
+    double first, last, step(1.0);
+    int numbers = (equals == string::npos ? 0 :
+                   sscanf(range.c_str() + equals + 1, "%lf:%lf:%lf", &first, &last, &step));
+    if(field == LOAN_RECORD_FIELDS || numbers < 2)
+    {
+      throw invalid_argument("Invalid sweep range: " + range);
+    }
+
+    sweep.addAxis(field, first, last, step);
+  }
+}
+
+int runSweepCalculation(CALC_TYPE ct, CmdLineParser &clp)
+{
+  LoanBulk::PRECISION precision(LoanBulk::PRECISION_FLOAT);
+  if(((CmdLineOptionFlag*) clp.getCmdLineOption(ARG_PRECISION_CENTS))->getValue())
+  {
+    precision = LoanBulk::PRECISION_CENTS;
+  }
+  else if(((CmdLineOptionFlag*) clp.getCmdLineOption(ARG_PRECISION_DOUBLE))->getValue())
+  {
+    precision = LoanBulk::PRECISION_DOUBLE;
+  }
+
+  try
+  {
+    LoanRateTable table;
+    bool tableLoaded;
+    if(!loadRateTable(clp, table, tableLoaded))
+    {
+      return 1;
+    }
+
+    double values[LOAN_RECORD_FIELDS] =
+    {
+      (double) ((CmdLineOptionInt*)   clp.getCmdLineOption(ARG_AMOUNT))->getValue(),
+      ((CmdLineOptionFloat*) clp.getCmdLineOption(ARG_INTEREST))->getValue(),
+      (double) ((CmdLineOptionInt*)   clp.getCmdLineOption(ARG_PERIOD_TOTAL))->getValue(),
+      getMoneyOption(clp, ARG_PAYMENT),
+      (double) ((CmdLineOptionInt*)   clp.getCmdLineOption(ARG_PERIOD_ELAPSED))->getValue(),
+      getMoneyOption(clp, ARG_INITIAL_PAYMENT),
+      getMoneyOption(clp, ARG_OPENFEE),
+      ((CmdLineOptionFloat*) clp.getCmdLineOption(ARG_OPENPERCENT))->getValue()
+    };
+
+    LoanSweep sweep(ct, precision,
+                    ((CmdLineOptionInt*) clp.getCmdLineOption(ARG_BULK_THREADS))->getValue());
+    sweep.setValues(values);
+    sweep.setRateTable(tableLoaded ? &table : NULL);
+    addSweepAxes(((CmdLineOptionStr*) clp.getCmdLineOption(ARG_SWEEP))->getValue(), sweep);
+
+    size_t errors;
+    string binaryFile(((CmdLineOptionStr*) clp.getCmdLineOption(ARG_BULK_BINARY))->getValue());
+    if(!binaryFile.empty())
+    {
+      LoanColumnWriter writer;
+      writer.open(binaryFile);
+      errors = sweep.calculate(writer);
+    }
+    else
+    {
+      errors = sweep.calculate(cout);
+    }
+
+    if(errors > 0)
+    {
+      cerr << errors << " of " << sweep.getNumPoints() << " points could not be calculated" << endl;
+    }
+  }
+  catch(const exception &e)
+  {
+    cerr << "Error executing loan calculator: " << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+//
+// Server mode, parsed without the CmdLineParser since it takes no loan values:
+//   loanCalculator -server <socket path | :port> [-threads N] [-cache N] [-ratetable file]
+//
+static LoanServer *runningServer = NULL;
+
+static void stopServer(int)
+{
+  if(runningServer != NULL)
+  {
+    runningServer->stop();
+  }
+}
+
+int runServer(int argc, char **argv)
+{
+  string address;
+  int numThreads(0);
+  long cacheSize(0);
+  string rateTableFile;
+
+  for(int arg = 1; arg + 1 < argc; arg += 2)
+  {
+    if(ARG_SERVER == argv[arg])
+    {
+      address = argv[arg+1];
+    }
+    else if(ARG_BULK_THREADS == argv[arg])
+    {
+      numThreads = atoi(argv[arg+1]);
+    }
+    else if(ARG_SERVER_CACHE == argv[arg])
+    {
+      cacheSize = atol(argv[arg+1]);
+    }
+    else if(ARG_RATE_TABLE == argv[arg])
+    {
+      rateTableFile = argv[arg+1];
+    }
+    else
+    {
+      address.clear();
+      break;
+    }
+  }
+
+  if(address.empty() || argc % 2 == 0 || cacheSize < 0)
+  {
+    cerr << "Usage: " << argv[0] << " " << ARG_SERVER << " <socket path | :port> ["
+         << ARG_BULK_THREADS << " N] [" << ARG_SERVER_CACHE << " quotes] ["
+         << ARG_RATE_TABLE << " file]" << endl;
+    return 1;
+  }
+
+  try
+  {
+    // Repeated interest rate quotes are answered from the cache, if it has a size
+    LoanQuoteCache cache(cacheSize > 0 ? cacheSize : 1);
+
+    LoanRateTable table;
+    if(!rateTableFile.empty())
+    {
+      table.load(rateTableFile);
+    }
+
+    LoanServer server(numThreads);
+    server.listen(address);
+    if(cacheSize > 0)
+    {
+      server.setCache(&cache);
+    }
+    if(!rateTableFile.empty())
+    {
+      server.setRateTable(&table);
+    }
+
+    runningServer = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    signal(SIGPIPE, SIG_IGN);
+
+    cerr << "Loan calculator server listening on " << address
+         << " with " << server.getNumThreads() << " threads" << endl;
+    server.run();
+    runningServer = NULL;
+
+    if(server.getCache() != NULL)
+    {
+      cerr << "Quote cache: " << cache.getHits() << " hits, " << cache.getMisses() << " misses, "
+           << cache.getEvictions() << " evictions" << endl;
+    }
+  }
+  catch(const exception &e)
+  {
+    runningServer = NULL;
+    cerr << "Error executing loan calculator server: " << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+//
+// Write a rate table, parsed without the CmdLineParser as the server:
+//   loanCalculator -build-rate-table <file> [minRate maxRate rateStep maxTerm]
+//
+int runBuildRateTable(int argc, char **argv)
+{
+  if(argc != 3 && argc != 7)
+  {
+    cerr << "Usage: " << argv[0] << " " << ARG_BUILD_RATE_TABLE
+         << " <file> [minRate maxRate rateStep maxTerm]\n"
+         << "Default: " << LoanRateTable::DEFAULT_MIN_RATE << " " << LoanRateTable::DEFAULT_MAX_RATE
+         << " " << LoanRateTable::DEFAULT_RATE_STEP << " " << LoanRateTable::DEFAULT_MAX_TERM << endl;
+    return 1;
+  }
+
+  try
+  {
+    LoanRateTable table;
+    if(argc == 7)
+    {
+      table.build(atof(argv[3]), atof(argv[4]), atof(argv[5]), atoi(argv[6]));
+    }
+    else
+    {
+      table.build();
+    }
+    table.save(argv[2]);
+
+    cout << "Rate table of " << table.getNumRates() << " rates from " << table.getMinRate()
+         << "% in " << table.getRateStep() << "% steps, terms up to " << table.getMaxTerm() << " months\n"
+         << "Built in " << table.getBuildSeconds()*1000.0 << " ms, "
+         << table.getMemoryBytes()/1024 << " KB" << endl;
+  }
+  catch(const exception &e)
+  {
+    cerr << "Error building the rate table: " << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+//
+// Monte Carlo simulation of a loan pool, see LoanSimulation.h, parsed
+// without the CmdLineParser as the server:
+//   loanCalculator -simulate <paths> -a amount -i interest -N periods [-p payment]
+//                  [-cpr %] [-cdr %] [-severity %] [-volatility sigma] [-seed S] [-threads N]
+//
+int runSimulation(int argc, char **argv)
+{
+  size_t numPaths(0);
+  double amount(0.0), interest(-1.0), payment(0.0);
+  int periodTotal(0), numThreads(0);
+  double cpr(0.0), cdr(0.0), severity(0.0), sigma(0.0);
+  uint64_t seed(0);
+  bool valid(argc % 2 == 1);
+
+  for(int arg = 1; valid && arg + 1 < argc; arg += 2)
+  {
+    const char *value(argv[arg+1]);
+    if(ARG_SIMULATE == argv[arg])
+    {
+      numPaths = strtoull(value, NULL, 10);
+    }
+    else if(ARG_AMOUNT == argv[arg])
+    {
+      amount = atof(value);
+    }
+    else if(ARG_INTEREST == argv[arg])
+    {
+      interest = atof(value);
+    }
+    else if(ARG_PERIOD_TOTAL == argv[arg])
+    {
+      periodTotal = atoi(value);
+    }
+    else if(ARG_PAYMENT == argv[arg])
+    {
+      payment = atof(value);
+    }
+    else if(ARG_SIM_CPR == argv[arg])
+    {
+      cpr = atof(value);
+    }
+    else if(ARG_SIM_CDR == argv[arg])
+    {
+      cdr = atof(value);
+    }
+    else if(ARG_SIM_SEVERITY == argv[arg])
+    {
+      severity = atof(value);
+    }
+    else if(ARG_SIM_VOLATILITY == argv[arg])
+    {
+      sigma = atof(value);
+    }
+    else if(ARG_SIM_SEED == argv[arg])
+    {
+      seed = strtoull(value, NULL, 10);
+    }
+    else if(ARG_BULK_THREADS == argv[arg])
+    {
+      numThreads = atoi(value);
+    }
+    else
+    {
+      valid = false;
+    }
+  }
+
+  if(!valid || numPaths == 0 || amount <= 0.0 || interest < 0.0 || periodTotal < 1)
+  {
+    cerr << "Usage: " << argv[0] << " " << ARG_SIMULATE << " <paths> "
+         << ARG_AMOUNT << " amount " << ARG_INTEREST << " interest " << ARG_PERIOD_TOTAL << " periods ["
+         << ARG_PAYMENT << " payment]\n"
+         << "\t[" << ARG_SIM_CPR << " %] [" << ARG_SIM_CDR << " %] [" << ARG_SIM_SEVERITY << " %] ["
+         << ARG_SIM_VOLATILITY << " sigma] [" << ARG_SIM_SEED << " S] [" << ARG_BULK_THREADS << " N]\n"
+         << "The CPR and CDR are the yearly prepayment and default rates, the severity the loss\n"
+         << "given default, and the volatility that of the log of the rates of each path" << endl;
+    return 1;
+  }
+
+  try
+  {
+    LoanSimulation simulation(numThreads);
+    simulation.setLoan(amount, interest, periodTotal, payment);
+    simulation.setPrepaymentRate(cpr);
+    simulation.setDefaultRate(cdr);
+    simulation.setSeverity(severity);
+    simulation.setRateVolatility(sigma);
+    simulation.setSeed(seed);
+    simulation.run(numPaths);
+
+    cout << fixed << setprecision(2)
+         << "Monthly Payment = " << simulation.getPayment() << "\n\n"
+         << "Period,Expected Balance,Scheduled Balance,Expected Cash Flow,Expected Loss\n";
+    for(int n = 1; n <= periodTotal; ++n)
+    {
+      cout << n << "," << simulation.getExpectedBalance(n) << "," << simulation.getScheduledBalance(n)
+           << "," << simulation.getExpectedCashFlow(n) << "," << simulation.getExpectedLoss(n) << "\n";
+    }
+
+    static const double QUANTILES[] = {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+    cout << "\nQuantile,Total Cash Flow,Present Value\n";
+    for(size_t q = 0; q < sizeof(QUANTILES)/sizeof(QUANTILES[0]); ++q)
+    {
+      cout << QUANTILES[q] << "," << simulation.getCashFlowQuantile(QUANTILES[q])
+           << "," << simulation.getPresentValueQuantile(QUANTILES[q]) << "\n";
+    }
+
+    cout << "\n" << simulation.getNumPaths() << " paths in " << simulation.getSeconds()*1000.0
+         << " ms on " << simulation.getNumThreads() << " threads, "
+         << setprecision(0) << simulation.getPathsPerSecond() << " paths/sec" << endl;
+  }
+  catch(const exception &e)
+  {
+    cerr << "Error executing the loan simulation: " << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int runCli(int argc, char **argv, bool withGui)
+{
+  if(argc > 1 && ARG_SERVER == argv[1])
+  {
+    return runServer(argc, argv);
+  }
+  else if(argc > 1 && ARG_BUILD_RATE_TABLE == argv[1])
+  {
+    return runBuildRateTable(argc, argv);
+  }
+  else if(argc > 1 && ARG_SIMULATE == argv[1])
+  {
+    return runSimulation(argc, argv);
+  }
+
+  //
+  // Parse the command line arguments
+  //
+  CmdLineParser clp;
+  loadCmdLine(clp, withGui);
+  CALC_TYPE ct = parseCommandLine(argc, argv, clp);
+
+  if(ct != CALC_UNKNOWN &&
+     !((CmdLineOptionStr*) clp.getCmdLineOption(ARG_BULK_FILE))->getValue().empty())
+  {
+    return runBulkCalculation(ct, clp);
+  }
+
+  if(ct != CALC_UNKNOWN &&
+     !((CmdLineOptionStr*) clp.getCmdLineOption(ARG_SWEEP))->getValue().empty())
+  {
+    return runSweepCalculation(ct, clp);
+  }
+
+  LoanRateTable table;
+  bool tableLoaded(false);
+  if(ct != CALC_UNKNOWN && !loadRateTable(clp, table, tableLoaded))
+  {
+    return 1;
+  }
+  const LoanRateTable *rateTable(tableLoaded ? &table : NULL);
+
+  LoanRateSchedule schedule;
+  bool scheduleLoaded(false);
+  if(ct != CALC_UNKNOWN && !loadRateSchedule(clp, schedule, scheduleLoaded))
+  {
+    return 1;
+  }
+  const LoanRateSchedule *rateSchedule(scheduleLoaded ? &schedule : NULL);
+
+  if(ct != CALC_UNKNOWN &&
+     ((CmdLineOptionFlag*) clp.getCmdLineOption(ARG_PRECISION_CENTS))->getValue())
+  {
+    LoanCalculatorCents calculator;
+    calculator.setRateTable(rateTable);
+    calculator.setRateSchedule(rateSchedule);
+    return runCalculation(ct, clp, calculator);
+  }
+  else if(ct != CALC_UNKNOWN &&
+          ((CmdLineOptionFlag*) clp.getCmdLineOption(ARG_PRECISION_DOUBLE))->getValue())
+  {
+    LoanCalculatorDouble calculator;
+    calculator.setRateTable(rateTable);
+    calculator.setRateSchedule(rateSchedule);
+    return runCalculation(ct, clp, calculator);
+  }
+
+  LoanCalculator calculator;
+  calculator.setRateTable(rateTable);
+  calculator.setRateSchedule(rateSchedule);
+  return runCalculation(ct, clp, calculator);
+}
+
+//
+// The command line program, without the GUI
+//
+int runLoanCalculatorCli(int argc, char **argv, bool withGui)
+{
+  // -stats can be given to every mode, so it is taken out of the arguments
+  // before they are parsed
+  string statsFile;
+  int remaining = 1;
+  for(int arg = 1; arg < argc; ++arg)
+  {
+    if(ARG_STATS == argv[arg] && arg + 1 < argc)
+    {
+      statsFile = argv[++arg];
+      continue;
+    }
+    argv[remaining++] = argv[arg];
+  }
+  argv[remaining] = NULL;
+
+  if(statsFile.empty())
+  {
+    return runCli(remaining, argv, withGui);
+  }
+
+  if(!LoanStats::isCompiled())
+  {
+    cerr << "The stats were compiled out, " << ARG_STATS << " is ignored" << endl;
+    return runCli(remaining, argv, withGui);
+  }
+
+  // JSON for a .json file, else Prometheus text
+  LoanStats::FORMAT format(LoanStats::FORMAT_PROMETHEUS);
+  if(statsFile.size() > 5 && statsFile.compare(statsFile.size() - 5, 5, ".json") == 0)
+  {
+    format = LoanStats::FORMAT_JSON;
+  }
+
+  // Before the modes create any thread, see LoanStats::writeOnSignal()
+  LoanStats::writeOnSignal(statsFile, format);
+  LoanStats::setEnabled(true);
+
+  int result = runCli(remaining, argv, withGui);
+
+  try
+  {
+    LoanStats::writeFile(statsFile, format);
+  }
+  catch(const exception &e)
+  {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return result;
+}
@@ -0,0 +1,19 @@
+#ifndef LOANCALCULATORCLI_H_INCLUDED
+#define LOANCALCULATORCLI_H_INCLUDED
+
+/*
+The command line loan calculator: the single loan calculations, the
+bulk mode (-bulk), the sweep mode (-sweep), the simulation mode
+(-simulate) and the server mode (-server). It has no Qt
+dependency, it is the whole of loanCalculatorCli, and loanCalculator
+runs it when given any arguments.
+*/
+
+/**
+ * Run the command line calculator, returns the exit status.
+ * withGui only changes the help text, saying that no options
+ * launches the GUI
+ */
+int runLoanCalculatorCli(int argc, char **argv, bool withGui);
+
+#endif // LOANCALCULATORCLI_H_INCLUDED
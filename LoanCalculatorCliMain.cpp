@@ -0,0 +1,11 @@
+
+#include <LoanCalculatorCli.h>
+
+//
+// Main program of loanCalculatorCli, the command line calculator
+// without the GUI, so it doesnt link or initialize Qt
+//
+int main(int argc, char **argv)
+{
+  return runLoanCalculatorCli(argc, argv, false);
+}
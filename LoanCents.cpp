@@ -0,0 +1,161 @@
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "LoanCents.h"
+
+using namespace std;
+
+// Percentages are used with 6 decimals, so percent*PERCENT_SCALE/100 is a ratio
+static const int64_t PERCENT_SCALE = 1000000;
+
+static int64_t checkedCents(__int128 cents)
+{
+  if(cents > INT64_MAX || cents < INT64_MIN)
+  {
+    throw overflow_error("Loan amount out of range of the fixed point cents type");
+  }
+
+  return (int64_t) cents;
+}
+
+/**
+ * numerator/denominator rounded to the nearest integer, ties to even
+ * denominator must be positive
+ */
+static __int128 divideRounded(__int128 numerator, __int128 denominator)
+{
+  __int128 quotient = numerator / denominator;
+  __int128 remainder = numerator % denominator;
+  if(remainder < 0)
+  {
+    remainder = -remainder;
+  }
+
+  __int128 twice = 2*remainder;
+  if(twice > denominator || (twice == denominator && (quotient % 2) != 0))
+  {
+    quotient += (numerator < 0 ? -1 : 1);
+  }
+
+  return quotient;
+}
+
+LoanCents LoanCents::fromDouble(double amount)
+{
+  if(!isInRange(amount))
+  {
+    throw overflow_error("Loan amount out of range of the fixed point cents type");
+  }
+
+  // nearbyint() rounds ties to even in the default rounding mode
+  return fromCents((int64_t) nearbyint(amount*100.0));
+}
+
+LoanCents LoanCents::fromString(const string &text)
+{
+  const char *pos = text.c_str();
+  bool negative = (*pos == '-');
+  if(*pos == '-' || *pos == '+')
+  {
+    ++pos;
+  }
+
+  // The digits up to the second decimal as cents, then for the rounding
+  // the third decimal, and whether any decimal after it isnt 0
+  __int128 cents = 0;
+  int decimals = -1;
+  int digits = 0;
+  int roundingDigit = 0;
+  bool sticky = false;
+  for(; *pos != '\0'; ++pos)
+  {
+    if(*pos == '.' && decimals < 0)
+    {
+      decimals = 0;
+      continue;
+    }
+    if(*pos < '0' || *pos > '9')
+    {
+      break;
+    }
+
+    ++digits;
+    if(decimals < 2)
+    {
+      cents = 10*cents + (*pos - '0');
+      decimals += (decimals < 0 ? 0 : 1);
+      checkedCents(cents);
+    }
+    else if(decimals++ == 2)
+    {
+      roundingDigit = *pos - '0';
+    }
+    else
+    {
+      sticky |= (*pos != '0');
+    }
+  }
+
+  if(*pos != '\0' || digits == 0)
+  {
+    // Not a plain decimal, as 1e5
+    char *end;
+    double amount = strtod(text.c_str(), &end);
+    if(text.empty() || *end != '\0')
+    {
+      throw invalid_argument("Invalid amount: " + text);
+    }
+
+    return fromDouble(amount);
+  }
+
+  for(decimals = (decimals < 0 ? 0 : decimals); decimals < 2; ++decimals)
+  {
+    cents *= 10;
+  }
+
+  // To the nearest cent, ties to even
+  if(roundingDigit > 5 || (roundingDigit == 5 && (sticky || (cents % 2) != 0)))
+  {
+    ++cents;
+  }
+
+  return fromCents(checkedCents(negative ? -cents : cents));
+}
+
+LoanCents LoanCents::operator*(int64_t factor) const
+{
+  return fromCents(checkedCents((__int128) cents_ * factor));
+}
+
+LoanCents LoanCents::percentOf(double percent) const
+{
+  double scaledPercent = nearbyint(percent*PERCENT_SCALE);
+  if(!(scaledPercent >= -9.2e18 && scaledPercent <= 9.2e18))
+  {
+    throw overflow_error("Percentage out of range of the fixed point cents type");
+  }
+
+  __int128 numerator = (__int128) cents_ * (int64_t) scaledPercent;
+  return fromCents(checkedCents(divideRounded(numerator, (__int128) PERCENT_SCALE*100)));
+}
+
+ostream &operator<<(ostream &os, const LoanCents &amount)
+{
+  int64_t cents = amount.getCents();
+  uint64_t absolute = (cents < 0 ? -(uint64_t) cents : (uint64_t) cents);
+
+  if(cents < 0)
+  {
+    os << '-';
+  }
+  os << absolute/100 << '.' << setw(2) << setfill('0') << absolute%100 << setfill(' ');
+
+  return os;
+}
@@ -0,0 +1,80 @@
+#ifndef LOANCENTS_H_INCLUDED
+#define LOANCENTS_H_INCLUDED
+
+/*
+Fixed point money amount, stored as a 64 bit number of cents.
+
+Additions and subtractions are exact. Multiplications are done with
+128 bit intermediates and throw overflow_error if the result does not
+fit in 64 bits. Whenever a result has to be rounded to a cent, it is
+rounded to the nearest cent, ties to even (banker's rounding).
+*/
+
+#include <stdint.h>
+
+#include <iosfwd>
+#include <string>
+
+class LoanCents
+{
+public:
+  LoanCents() : cents_(0) {}
+
+  static inline LoanCents fromCents(int64_t cents) { LoanCents c; c.cents_ = cents; return c; }
+
+  /**
+   * Rounded to the nearest cent, throws overflow_error if out of range
+   */
+  static LoanCents fromDouble(double amount);
+
+  /**
+   * A decimal amount, as in 325.67 or -1000, parsed exactly, the digits
+   * after the second decimal rounded. Other numbers, as 1e5, are parsed as
+   * doubles. Throws invalid_argument if text isnt a number, and
+   * overflow_error if out of range
+   */
+  static LoanCents fromString(const std::string &text);
+
+  // The largest amount of fromDouble(), in either sign
+  static inline double getMaxAmount() { return 9.2e16; }
+
+  // Whether fromDouble(amount) doesnt throw, false for NaN
+  static inline bool isInRange(double amount) { return amount >= -getMaxAmount() && amount <= getMaxAmount(); }
+
+  inline int64_t getCents() const { return cents_; }
+  inline double toDouble() const  { return cents_/100.0; }
+
+  //
+  // Exact arithmetic
+  //
+
+  inline LoanCents operator+(const LoanCents &other) const { return fromCents(cents_ + other.cents_); }
+  inline LoanCents operator-(const LoanCents &other) const { return fromCents(cents_ - other.cents_); }
+  inline LoanCents operator-() const                       { return fromCents(-cents_); }
+  inline LoanCents &operator+=(const LoanCents &other)     { cents_ += other.cents_; return *this; }
+  inline LoanCents &operator-=(const LoanCents &other)     { cents_ -= other.cents_; return *this; }
+
+  // Multiply by a whole number, as in the total paid over N payments
+  LoanCents operator*(int64_t factor) const;
+
+  /**
+   * percent% of this amount, as in 2.75% of the loan amount.
+   * The percentage is used with 6 decimals
+   */
+  LoanCents percentOf(double percent) const;
+
+  inline bool operator==(const LoanCents &other) const { return cents_ == other.cents_; }
+  inline bool operator!=(const LoanCents &other) const { return cents_ != other.cents_; }
+  inline bool operator<(const LoanCents &other) const  { return cents_ < other.cents_; }
+  inline bool operator>(const LoanCents &other) const  { return cents_ > other.cents_; }
+  inline bool operator<=(const LoanCents &other) const { return cents_ <= other.cents_; }
+  inline bool operator>=(const LoanCents &other) const { return cents_ >= other.cents_; }
+
+private:
+  int64_t cents_;
+};
+
+// Prints the amount with exactly 2 decimals, as in 1234.50
+std::ostream &operator<<(std::ostream &os, const LoanCents &amount);
+
+#endif // LOANCENTS_H_INCLUDED
@@ -0,0 +1,287 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <stdexcept>
+
+#include "LoanColumnFile.h"
+
+using namespace std;
+
+static const char MAGIC[8] = "LOANCOL";
+static const char PADDING[8] = { 0 };
+
+const char *getLoanColumnName(uint32_t columnId)
+{
+  switch(columnId)
+  {
+    case COLUMN_PAYMENT:         return "payment";
+    case COLUMN_TOTAL_PAID:      return "total paid";
+    case COLUMN_BALANCE:         return "balance";
+    case COLUMN_NUMBER_PAYMENTS: return "number of payments";
+    case COLUMN_AMOUNT:          return "amount";
+    case COLUMN_RATE:            return "rate";
+    case COLUMN_STATUS:          return "status";
+  }
+
+  return "unknown";
+}
+
+size_t getLoanColumnTypeSize(uint32_t columnType)
+{
+  switch(columnType)
+  {
+    case COLUMN_FLOAT64: return 8;
+    case COLUMN_UINT8:   return 1;
+  }
+
+  return 0;
+}
+
+// Rounded up to a multiple of 8 bytes
+static inline size_t paddedSize(size_t bytes)
+{
+  return (bytes + 7) & ~((size_t) 7);
+}
+
+//
+// LoanColumnWriter
+//
+
+LoanColumnWriter::LoanColumnWriter() :
+  fd_(-1),
+  closeFd_(false),
+  blockRows_(0),
+  columnBytes_(0)
+{
+}
+
+LoanColumnWriter::~LoanColumnWriter()
+{
+  close();
+}
+
+void LoanColumnWriter::open(const string &fileName)
+{
+  close();
+
+  if(fileName == "-")
+  {
+    fd_ = STDOUT_FILENO;
+    closeFd_ = false;
+    return;
+  }
+
+  fd_ = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd_ < 0)
+  {
+    throw runtime_error("Cant create " + fileName + ": " + strerror(errno));
+  }
+  closeFd_ = true;
+}
+
+void LoanColumnWriter::close()
+{
+  if(closeFd_)
+  {
+    ::close(fd_);
+  }
+
+  fd_ = -1;
+  closeFd_ = false;
+  iov_.clear();
+}
+
+void LoanColumnWriter::writeHeader(const vector<uint32_t> &columnIds)
+{
+  if(columnIds.size() + 1 > (size_t) LoanColumnHeader::MAX_COLUMNS)
+  {
+    throw invalid_argument("Too many columns for a column file");
+  }
+
+  LoanColumnHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAGIC, sizeof(header.magic));
+  header.version = LoanColumnHeader::VERSION;
+  header.byteOrderMark = LoanColumnHeader::BYTE_ORDER_MARK;
+
+  for(size_t c = 0; c < columnIds.size(); ++c)
+  {
+    header.columnIds[c] = columnIds[c];
+    header.columnTypes[c] = COLUMN_FLOAT64;
+  }
+  header.columnIds[columnIds.size()] = COLUMN_STATUS;
+  header.columnTypes[columnIds.size()] = COLUMN_UINT8;
+  header.numColumns = columnIds.size() + 1;
+
+  struct iovec iov;
+  iov.iov_base = &header;
+  iov.iov_len = sizeof(header);
+  writeAll(&iov, 1);
+}
+
+void LoanColumnWriter::beginBlock(uint64_t rows)
+{
+  blockRows_ = rows;
+  columnBytes_ = 0;
+  iov_.clear();
+
+  struct iovec iov;
+  iov.iov_base = &blockRows_;
+  iov.iov_len = sizeof(blockRows_);
+  iov_.push_back(iov);
+}
+
+void LoanColumnWriter::addColumnData(const void *data, size_t bytes)
+{
+  if(bytes == 0)
+  {
+    return;
+  }
+
+  struct iovec iov;
+  iov.iov_base = const_cast<void *>(data);
+  iov.iov_len = bytes;
+  iov_.push_back(iov);
+  columnBytes_ += bytes;
+}
+
+void LoanColumnWriter::endColumn()
+{
+  size_t padding = paddedSize(columnBytes_) - columnBytes_;
+  if(padding > 0)
+  {
+    struct iovec iov;
+    iov.iov_base = const_cast<char *>(PADDING);
+    iov.iov_len = padding;
+    iov_.push_back(iov);
+  }
+
+  columnBytes_ = 0;
+}
+
+void LoanColumnWriter::endBlock()
+{
+  writeAll(&iov_[0], iov_.size());
+  iov_.clear();
+}
+
+void LoanColumnWriter::writeAll(struct iovec *iov, size_t count)
+{
+  if(fd_ < 0)
+  {
+    throw runtime_error("The column file is not open");
+  }
+
+  while(count > 0)
+  {
+    ssize_t written = writev(fd_, iov, (int) (count < IOV_MAX ? count : IOV_MAX));
+    if(written < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      throw runtime_error(string("Error writing the column file: ") + strerror(errno));
+    }
+
+    // Skip what was written, which may end part way through a buffer
+    size_t remaining = written;
+    while(count > 0 && remaining >= iov->iov_len)
+    {
+      remaining -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if(count > 0)
+    {
+      iov->iov_base = (char *) iov->iov_base + remaining;
+      iov->iov_len -= remaining;
+    }
+  }
+}
+
+//
+// LoanColumnReader
+//
+
+LoanColumnReader::LoanColumnReader() :
+  offset_(0)
+{
+  memset(&header_, 0, sizeof(header_));
+}
+
+void LoanColumnReader::open(const string &fileName)
+{
+  if(fileName == "-")
+  {
+    file_.read(cin);
+  }
+  else
+  {
+    file_.open(fileName);
+  }
+
+  if(file_.getSize() < sizeof(header_) ||
+     memcmp(file_.getData(), MAGIC, sizeof(MAGIC)) != 0)
+  {
+    throw runtime_error("Not a loan column file: " + fileName);
+  }
+
+  memcpy(&header_, file_.getData(), sizeof(header_));
+  offset_ = sizeof(header_);
+
+  if(header_.byteOrderMark != LoanColumnHeader::BYTE_ORDER_MARK)
+  {
+    throw runtime_error("The loan column file has the wrong byte order: " + fileName);
+  }
+  if(header_.version != LoanColumnHeader::VERSION ||
+     header_.numColumns == 0 ||
+     header_.numColumns > (uint32_t) LoanColumnHeader::MAX_COLUMNS)
+  {
+    throw runtime_error("Unsupported loan column file: " + fileName);
+  }
+  for(uint32_t c = 0; c < header_.numColumns; ++c)
+  {
+    if(getLoanColumnTypeSize(header_.columnTypes[c]) == 0)
+    {
+      throw runtime_error("Unsupported loan column type in: " + fileName);
+    }
+  }
+}
+
+size_t LoanColumnReader::nextBlock(const void *columns[LoanColumnHeader::MAX_COLUMNS])
+{
+  size_t size = file_.getSize();
+  if(offset_ >= size)
+  {
+    return 0;
+  }
+
+  uint64_t rows;
+  if(size - offset_ < sizeof(rows))
+  {
+    throw runtime_error("Truncated loan column file");
+  }
+  memcpy(&rows, file_.getData() + offset_, sizeof(rows));
+  offset_ += sizeof(rows);
+
+  for(uint32_t c = 0; c < header_.numColumns; ++c)
+  {
+    size_t typeSize = getLoanColumnTypeSize(header_.columnTypes[c]);
+    if(rows > (size - offset_)/typeSize)
+    {
+      throw runtime_error("Truncated loan column file");
+    }
+
+    size_t bytes = paddedSize(rows*typeSize);
+    columns[c] = file_.getData() + offset_;
+    offset_ += (bytes < size - offset_ ? bytes : size - offset_);
+  }
+
+  return rows;
+}
@@ -0,0 +1,153 @@
+#ifndef LOANCOLUMNFILE_H_INCLUDED
+#define LOANCOLUMNFILE_H_INCLUDED
+
+/*
+Binary columnar format for the bulk results, instead of one line of text
+per loan.
+
+The file is a fixed size header followed by blocks of rows:
+
+  LoanColumnHeader     magic "LOANCOL", version, byte order mark,
+                       the number of columns and their ids and types
+  block                uint64_t number of rows R, then for each column
+                       in header order, R values of the column type,
+                       padded with zeros to a multiple of 8 bytes
+
+The values are in native byte order, the byte order mark lets a reader
+detect a file written on a machine of the other order. Every column
+starts 8 byte aligned, so a mapped file can be read in place.
+
+The money, rate and number of payments columns are COLUMN_FLOAT64.
+The last column is always COLUMN_STATUS, COLUMN_UINT8, which is 0 if the
+loan was calculated, else 1 and the other columns of the row are NaN.
+*/
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "LoanMappedFile.h"
+
+enum LOAN_COLUMN
+{
+  COLUMN_UNKNOWN=0,
+  COLUMN_PAYMENT,
+  COLUMN_TOTAL_PAID,
+  COLUMN_BALANCE,
+  COLUMN_NUMBER_PAYMENTS,
+  COLUMN_AMOUNT,
+  COLUMN_RATE,
+  COLUMN_STATUS
+};
+
+enum LOAN_COLUMN_TYPE
+{
+  COLUMN_FLOAT64=1,
+  COLUMN_UINT8
+};
+
+struct LoanColumnHeader
+{
+  static const int MAX_COLUMNS = 8;
+  static const uint32_t VERSION = 1;
+  static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+  char magic[8];           // "LOANCOL" and a terminating 0
+  uint32_t version;
+  uint32_t byteOrderMark;
+  uint32_t numColumns;
+  uint32_t reserved;
+  uint32_t columnIds[MAX_COLUMNS];   // LOAN_COLUMN
+  uint32_t columnTypes[MAX_COLUMNS]; // LOAN_COLUMN_TYPE
+};
+
+// The name of a column, as in "payment"
+const char *getLoanColumnName(uint32_t columnId);
+
+// The size of one value of a column type, 0 if unknown
+size_t getLoanColumnTypeSize(uint32_t columnType);
+
+/**
+ * Writes a column file with large gathered writes, each block
+ * is written with writev() straight from the callers buffers
+ */
+class LoanColumnWriter
+{
+public:
+  LoanColumnWriter();
+  ~LoanColumnWriter();
+
+  /**
+   * Create the file, a fileName of "-" writes to stdout.
+   * Throws runtime_error if the file cant be created
+   */
+  void open(const std::string &fileName);
+  void close();
+
+  /**
+   * Write the header, the status column is added after the columns
+   */
+  void writeHeader(const std::vector<uint32_t> &columnIds);
+
+  /**
+   * Write a block of rows, adding the data of each column in header
+   * order, possibly in several pieces. The data is not copied, it must
+   * remain valid until endBlock(), which throws runtime_error if the
+   * block cant be written
+   */
+  void beginBlock(uint64_t rows);
+  void addColumnData(const void *data, size_t bytes);
+  void endColumn();
+  void endBlock();
+
+private:
+  LoanColumnWriter(const LoanColumnWriter &);
+  LoanColumnWriter &operator=(const LoanColumnWriter &);
+
+  void writeAll(struct iovec *iov, size_t count);
+
+  int fd_;
+  bool closeFd_;
+
+  uint64_t blockRows_;
+  size_t columnBytes_;
+  std::vector<struct iovec> iov_;
+};
+
+/**
+ * Reads a column file in place, the file is memory mapped
+ */
+class LoanColumnReader
+{
+public:
+  LoanColumnReader();
+  ~LoanColumnReader() {}
+
+  /**
+   * Open the file and read the header, a fileName of "-" reads stdin.
+   * Throws runtime_error if the file cant be read or is not a column file
+   */
+  void open(const std::string &fileName);
+
+  inline const LoanColumnHeader &getHeader() const { return header_; }
+
+  /**
+   * Read the next block, columns[c] points to its values of column c in
+   * header order. Returns the number of rows, 0 at the end of the file.
+   * Throws runtime_error if the block is truncated
+   */
+  size_t nextBlock(const void *columns[LoanColumnHeader::MAX_COLUMNS]);
+
+private:
+  LoanColumnReader(const LoanColumnReader &);
+  LoanColumnReader &operator=(const LoanColumnReader &);
+
+  LoanMappedFile file_;
+  LoanColumnHeader header_;
+  size_t offset_;
+};
+
+#endif // LOANCOLUMNFILE_H_INCLUDED
@@ -0,0 +1,123 @@
+
+//
+// Converts a column file written by "loanCalculator -bulk -binary"
+// back to the text output of the bulk mode, one line per loan
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include <LoanColumnFile.h>
+
+using namespace std;
+
+void printUsage(const char *program)
+{
+  cerr << "Usage: " << program << " [-header] <column file>\n"
+       << "   -header Print the names of the columns first\n"
+       << "   Use - to read the column file from stdin" << endl;
+}
+
+int main(int argc, char **argv)
+{
+  bool printHeader(false);
+  string fileName;
+
+  for(int arg = 1; arg < argc; ++arg)
+  {
+    if(strcmp(argv[arg], "-header") == 0)
+    {
+      printHeader = true;
+    }
+    else if(fileName.empty() && (argv[arg][0] != '-' || strcmp(argv[arg], "-") == 0))
+    {
+      fileName = argv[arg];
+    }
+    else
+    {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if(fileName.empty())
+  {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  try
+  {
+    LoanColumnReader reader;
+    reader.open(fileName);
+
+    const LoanColumnHeader &header = reader.getHeader();
+    // The last column is the status
+    uint32_t numResults = header.numColumns - 1;
+
+    if(printHeader)
+    {
+      for(uint32_t c = 0; c < numResults; ++c)
+      {
+        cout << (c == 0 ? "" : ",") << getLoanColumnName(header.columnIds[c]);
+      }
+      cout << "\n";
+    }
+
+    char buffer[8192];
+    const void *columns[LoanColumnHeader::MAX_COLUMNS];
+    size_t rows;
+
+    while((rows = reader.nextBlock(columns)) > 0)
+    {
+      const uint8_t *status = (const uint8_t *) columns[numResults];
+      size_t length = 0;
+
+      for(size_t row = 0; row < rows; ++row)
+      {
+        // Flush the buffer when a row might not fit
+        if(sizeof(buffer) - length < 256)
+        {
+          cout.write(buffer, length);
+          length = 0;
+        }
+
+        if(status[row] != 0)
+        {
+          length += snprintf(buffer + length, sizeof(buffer) - length, "error\n");
+          continue;
+        }
+
+        for(uint32_t c = 0; c < numResults; ++c)
+        {
+          // Rates with 4 decimals, money and number of payments with 2
+          double value = ((const double *) columns[c])[row];
+          int written = snprintf(buffer + length, sizeof(buffer) - length,
+                                 (header.columnIds[c] == COLUMN_RATE ? "%s%.4f" : "%s%.2f"),
+                                 (c == 0 ? "" : ","), value);
+          if(written > 0)
+          {
+            length += ((size_t) written < sizeof(buffer) - length ? written : sizeof(buffer) - length - 1);
+          }
+        }
+        buffer[length++] = '\n';
+      }
+
+      cout.write(buffer, length);
+    }
+
+    cout.flush();
+  }
+  catch(const exception &e)
+  {
+    cerr << "Error reading the column file: " << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,195 @@
+#ifndef LOANCONSTEXPRMATH_H_INCLUDED
+#define LOANCONSTEXPRMATH_H_INCLUDED
+
+/*
+exp(), log() and pow() of doubles that can be evaluated by the compiler,
+so the factors of fixed rates and terms can be constants, see
+LoanProducts.h. They are C++11 constexpr functions, a single return each,
+the loops written as recursions of a bounded depth, a few dozen calls.
+
+  exp(x)    x = k*ln2 + r, |r| <= ln2/2, so exp(x) = 2^k * exp(r), and
+            exp(r) is its Taylor series to the 20th power, in Horner form
+  log(x)    x = 2^e * m, sqrt(1/2) <= m < sqrt(2), so log(x) = e*ln2 +
+            log(m), and log(m) = 2*atanh(s), s = (m-1)/(m+1), |s| < 0.172,
+            its series to the 25th power
+  pow(x,y)  exp(y*log(x)), log(x) and y*log(x) in double-double, the sum
+            of 2 doubles, else the error of log(x) would be multiplied by y
+
+ln2 is split as in fdlibm, its high part having enough trailing zero bits
+that k*ln2 is exact for any exponent k of a double. exp() and log() are
+within 1 ulp of glibc, and pow() within 2 ulp, over the doubles and the
+monthly discount factors of rates up to 30% and terms up to 480.
+
+At run time they are much slower than libm, they are only for constants.
+Only finite positive x are supported by log() and pow(), they return NaN
+for any other x, and exp() is 0.0 below the normal doubles, for x < -708.4.
+*/
+
+#include <limits>
+
+// ln(2) = LOAN_LN2_HI + LOAN_LN2_LO
+constexpr double LOAN_LN2_HI = 6.93147180369123816490e-01;
+constexpr double LOAN_LN2_LO = 1.90821492927058770002e-10;
+
+constexpr double LOAN_SQRT2 = 1.41421356237309504880;
+
+constexpr double loanConstexprSquare(double x)
+{
+  return x*x;
+}
+
+/**
+ * 2^k, exactly, for any k of a normal double
+ */
+constexpr double loanConstexprPow2(int k)
+{
+  return (k < 0 ? 1.0/loanConstexprPow2(-k) :
+          k == 0 ? 1.0 :
+          k%2 == 1 ? 2.0*loanConstexprPow2(k - 1) :
+          loanConstexprSquare(loanConstexprPow2(k/2)));
+}
+
+/**
+ * 1 + r/n*(1 + r/(n+1)*(1 + ... r/last)), exp(r) for n = 1
+ */
+constexpr double loanConstexprExpSeries(double r, int n, int last)
+{
+  return (n > last ? 1.0 : 1.0 + r/n*loanConstexprExpSeries(r, n + 1, last));
+}
+
+// exp(x) of x reduced as x = k*ln2 + r, 2^1024 overflows even when the result doesnt
+constexpr double loanConstexprExpReduced(double x, int k)
+{
+  return (k > 1023 ? 2.0*loanConstexprExpSeries((x - k*LOAN_LN2_HI) - k*LOAN_LN2_LO, 1, 20)*loanConstexprPow2(k - 1) :
+          loanConstexprExpSeries((x - k*LOAN_LN2_HI) - k*LOAN_LN2_LO, 1, 20)*loanConstexprPow2(k));
+}
+
+constexpr double loanConstexprExp(double x)
+{
+  return (x != x ? x :
+          x > 709.782712893384 ? std::numeric_limits<double>::infinity() :
+          x < -708.396418532264 ? 0.0 :
+          loanConstexprExpReduced(x, (int) (x/(LOAN_LN2_HI + LOAN_LN2_LO) + (x < 0.0 ? -0.5 : 0.5))));
+}
+
+/*
+Exact sums and products of doubles, as double-double: the rounding error
+of a + b and of a*b, Dekker's without fused multiply add
+*/
+constexpr double loanConstexprSumError(double a, double b, double sum)
+{
+  return (a - (sum - (sum - a))) + (b - (sum - a));
+}
+
+// The upper 26 bits of a
+constexpr double loanConstexprSplit(double a)
+{
+  return 134217729.0*a - (134217729.0*a - a);
+}
+
+constexpr double loanConstexprProductError(double a, double b, double product)
+{
+  return ((loanConstexprSplit(a)*loanConstexprSplit(b) - product)
+          + loanConstexprSplit(a)*(b - loanConstexprSplit(b))
+          + (a - loanConstexprSplit(a))*loanConstexprSplit(b))
+         + (a - loanConstexprSplit(a))*(b - loanConstexprSplit(b));
+}
+
+// A double-double, hi + lo, |lo| at most half an ulp of hi
+struct LoanConstexprDouble2
+{
+  constexpr LoanConstexprDouble2(double h, double l) : hi(h), lo(l) {}
+
+  double hi;
+  double lo;
+};
+
+constexpr LoanConstexprDouble2 loanConstexprNormalize(double hi, double lo)
+{
+  return LoanConstexprDouble2(hi + lo, lo - ((hi + lo) - hi));
+}
+
+/**
+ * 1/first + s2*(1/(first+2) + s2*(... 1/last)), atanh(s)/s for first = 1
+ */
+constexpr double loanConstexprAtanhSeries(double s2, int first, int last)
+{
+  return (first >= last ? 1.0/last : 1.0/first + s2*loanConstexprAtanhSeries(s2, first + 2, last));
+}
+
+/**
+ * e*ln2 + 2*atanh(s), s + sLo = (m-1)/(m+1). 2*s is exact, and the rest of
+ * the series is less than 1% of it, so its rounding errors dont matter
+ */
+constexpr LoanConstexprDouble2 loanConstexprLogSeries(int e, double s, double sLo)
+{
+  return loanConstexprNormalize(e*LOAN_LN2_HI + 2.0*s,
+                                loanConstexprSumError(e*LOAN_LN2_HI, 2.0*s, e*LOAN_LN2_HI + 2.0*s)
+                                + (e*LOAN_LN2_LO + (2.0*sLo + 2.0*s*(s*s)*loanConstexprAtanhSeries(s*s, 3, 25))));
+}
+
+/**
+ * s = f/d rounded, with d + dLo = m + 1, m - 1 = f exactly. f - s*d is exact,
+ * as s*d is within 2 ulp of f
+ */
+constexpr LoanConstexprDouble2 loanConstexprLogQuotient(int e, double f, double d, double dLo, double s)
+{
+  return loanConstexprLogSeries(e, s, (((f - s*d) - loanConstexprProductError(s, d, s*d)) - s*dLo)/d);
+}
+
+// log(m) + e*ln2, sqrt(1/2) <= m < sqrt(2)
+constexpr LoanConstexprDouble2 loanConstexprLogReduced(double m, int e)
+{
+  return loanConstexprLogQuotient(e, m - 1.0, m + 1.0, loanConstexprSumError(m, 1.0, m + 1.0),
+                                  (m - 1.0)/(m + 1.0));
+}
+
+/**
+ * Scale x by powers of 2 into [sqrt(1/2), sqrt(2)), 2^32 at a time while
+ * far from it, then 2 at a time, e is the exponent taken out
+ */
+constexpr LoanConstexprDouble2 loanConstexprLogScaled(double x, int e)
+{
+  return (x >= 4294967296.0 ? loanConstexprLogScaled(x/4294967296.0, e + 32) :
+          x < 1.0/4294967296.0 ? loanConstexprLogScaled(x*4294967296.0, e - 32) :
+          x >= LOAN_SQRT2 ? loanConstexprLogScaled(x/2.0, e + 1) :
+          x < LOAN_SQRT2/2.0 ? loanConstexprLogScaled(x*2.0, e - 1) :
+          loanConstexprLogReduced(x, e));
+}
+
+constexpr bool loanConstexprIsLogDefined(double x)
+{
+  return x > 0.0 && x <= std::numeric_limits<double>::max();
+}
+
+constexpr double loanConstexprLog(double x)
+{
+  return (!loanConstexprIsLogDefined(x) ? std::numeric_limits<double>::quiet_NaN() :
+          loanConstexprLogScaled(x, 0).hi);
+}
+
+/**
+ * exp(hi + lo) = exp(hi)*(1 + lo), lo being less than an ulp of hi
+ */
+constexpr double loanConstexprExp2(double hi, double lo)
+{
+  return loanConstexprExp(hi) + loanConstexprExp(hi)*lo;
+}
+
+// y*(log.hi + log.lo), exactly to double-double
+constexpr double loanConstexprPowLog(double y, LoanConstexprDouble2 log)
+{
+  return loanConstexprExp2(y*log.hi, loanConstexprProductError(y, log.hi, y*log.hi) + y*log.lo);
+}
+
+/**
+ * x^y, x positive
+ */
+constexpr double loanConstexprPow(double x, double y)
+{
+  return (y == 0.0 || x == 1.0 ? 1.0 :
+          !loanConstexprIsLogDefined(x) ? std::numeric_limits<double>::quiet_NaN() :
+          loanConstexprPowLog(y, loanConstexprLogScaled(x, 0)));
+}
+
+#endif // LOANCONSTEXPRMATH_H_INCLUDED
@@ -0,0 +1,23 @@
+#ifndef LOANCOUNTER_H_INCLUDED
+#define LOANCOUNTER_H_INCLUDED
+
+/*
+Counters written by a single thread and read by any, as the per thread
+stats of LoanStats.h and the metrics of the workers of LoanWorkerPool.h.
+*/
+
+#include <stdint.h>
+
+#include <atomic>
+
+/**
+ * Add value to a counter only the calling thread writes. A relaxed load
+ * and store rather than fetch_add(), so no locked instruction, the
+ * readers load it relaxed
+ */
+inline void loanIncrement(std::atomic<uint64_t> &counter, uint64_t value)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+#endif // LOANCOUNTER_H_INCLUDED
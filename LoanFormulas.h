@@ -0,0 +1,230 @@
+#ifndef LOANFORMULAS_H_INCLUDED
+#define LOANFORMULAS_H_INCLUDED
+
+/*
+The loan formulas, shared by LoanCalculator and LoanBatch.
+See LoanCalculator.h for the formulas and the meaning of the variables.
+
+The formulas take the periodic interest rate i (as in .0675/12) and, where
+the formula uses (1+i)^n or (1+i)^-N, that factor already calculated, so
+that a caller calculating several results for the same loan only calls
+pow() once per exponent.
+
+The formulas that are only arithmetic are constexpr, and with the factors
+of loanConstexprGrowthFactor() they are evaluated by the compiler for
+constant loans, see LoanProducts.h.
+
+The formulas divide by i, so they are NaN or inf for 0% loans, and for
+rates below LOAN_SMALL_RATE 1+i keeps few of the digits of i, so
+(1+i)^N - 1 cancels. loanBalance(), loanPayment(), loanNumberPayments()
+and loanAmount() are the formulas with those cases, the ones used by the
+calculator:
+  i = 0       the limits of the formulas, as P = A/N and B_n = A - P*n
+  |i| small   the factors as expm1(n*log1p(i)), without the cancellation
+  N = 1       P = A*(1+i) and A = P/(1+i), the single payment
+The balance is always the formula, as the payment set may not be the one
+that pays off the loan in N payments. When it is, the balance after the
+last payment is the rounding error of the formula, close to 0.
+Any other loan is calculated with the formula, to the same bit as before.
+*/
+
+#include <math.h>
+
+#include "LoanConstexprMath.h"
+
+/**
+ * (1+i)^n
+ */
+inline double loanGrowthFactor(double i, double n)
+{
+  return pow((1+i), n);
+}
+
+/**
+ * (1+i)^n, within 2 ulp of loanGrowthFactor(), for constants only, see
+ * LoanConstexprMath.h
+ */
+constexpr double loanConstexprGrowthFactor(double i, double n)
+{
+  return loanConstexprPow((1+i), n);
+}
+
+/**
+ * The amount actually financed, once the initial payment has been
+ * subtracted and the opening fees have been added
+ */
+constexpr double loanFinancedAmount(double A, double initialPayment, double openingFee, double openingPercent)
+{
+  return (A - initialPayment) + openingFee + ((A - initialPayment) * (openingPercent/100.0));
+}
+
+/**
+ * Loan balance after n payments have been made:
+ *   B_n = A*(1+i)^n - (P/i)*((1+i)^n - 1)
+ * growth = (1+i)^n
+ */
+constexpr double loanBalanceFormula(double A, double P, double i, double growth)
+{
+  return (A*growth) - (P/i)*(growth-1);
+}
+
+/**
+ * Payment amount on a loan:
+ *   P = i*A / (1 - (1+i)^-N)
+ * discount = (1+i)^-N
+ */
+constexpr double loanPaymentFormula(double A, double i, double discount)
+{
+  return (i*A) / (1 - discount);
+}
+
+/**
+ * Number of payments on a loan:
+ *   N = -log(1-i*A/P) / log(1+i)
+ */
+inline double loanNumberPaymentsFormula(double A, double P, double i)
+{
+  return (-1.0*log10(1.0-(i*A/P))) / log10(1.0 + i);
+}
+
+/**
+ * Number of payments on a loan, given the natural logs:
+ *   logRemaining = log(1-i*A/P)
+ *   logGrowth    = log(1+i)
+ */
+constexpr double loanNumberPaymentsFromLogs(double logRemaining, double logGrowth)
+{
+  return (-1.0*logRemaining) / logGrowth;
+}
+
+/**
+ * Original loan amount:
+ *   A = (P/i)*(1 - (1+i)^-N)
+ * discount = (1+i)^-N
+ */
+constexpr double loanAmountFormula(double P, double i, double discount)
+{
+  return (P/i) * (1 - discount);
+}
+
+//
+// The formulas with the edge cases, see above
+//
+
+/**
+ * Below this periodic rate, 0.012% yearly paid monthly, the factors are
+ * calculated with log1p() and expm1() instead of the growth factor
+ */
+constexpr double LOAN_SMALL_RATE = 1e-5;
+
+inline bool loanIsSmallRate(double i)
+{
+  return fabs(i) < LOAN_SMALL_RATE;
+}
+
+/**
+ * (1+i)^n - 1, without the cancellation of 1+i for small i, 0 if i = 0
+ */
+inline double loanGrowthMinusOne(double i, double n)
+{
+  return expm1(n*log1p(i));
+}
+
+/**
+ * ((1+i)^n - 1) / i, the balance paid off by n payments of 1, n if i = 0
+ * growth = (1+i)^n
+ */
+inline double loanAccumulationFactor(double i, double n, double growth)
+{
+  if(i == 0.0)
+  {
+    return n;
+  }
+
+  return (loanIsSmallRate(i) ? loanGrowthMinusOne(i, n) : growth - 1)/i;
+}
+
+/**
+ * loanBalanceFormula(), B_n = A - P*n if i = 0
+ */
+inline double loanBalance(double A, double P, double i, int n, double growth)
+{
+  if(loanIsSmallRate(i))
+  {
+    return (A*growth) - P*loanAccumulationFactor(i, n, growth);
+  }
+
+  return loanBalanceFormula(A, P, i, growth);
+}
+
+/**
+ * loanPaymentFormula(), P = A/N if i = 0
+ */
+inline double loanPayment(double A, double i, int N, double discount)
+{
+  if(N == 1)
+  {
+    return A*(1 + i);
+  }
+  else if(i == 0.0)
+  {
+    return A/N;
+  }
+  else if(loanIsSmallRate(i))
+  {
+    return (i*A) / -loanGrowthMinusOne(i, -N);
+  }
+
+  return loanPaymentFormula(A, i, discount);
+}
+
+/**
+ * loanNumberPaymentsFormula(), N = A/P if i = 0
+ */
+inline double loanNumberPayments(double A, double P, double i)
+{
+  if(i == 0.0)
+  {
+    return A/P;
+  }
+  else if(loanIsSmallRate(i))
+  {
+    return -log1p(-(i*A/P)) / log1p(i);
+  }
+
+  return loanNumberPaymentsFormula(A, P, i);
+}
+
+/**
+ * loanAmountFormula(), A = P*N if i = 0
+ */
+inline double loanAmount(double P, double i, int N, double discount)
+{
+  if(N == 1)
+  {
+    return P/(1 + i);
+  }
+  else if(i == 0.0)
+  {
+    return P*N;
+  }
+  else if(loanIsSmallRate(i))
+  {
+    return (P/i) * -loanGrowthMinusOne(i, -N);
+  }
+
+  return loanAmountFormula(P, i, discount);
+}
+
+/**
+ * Interest Rate, returns the periodic rate i:
+ *   i = (((1 + P/A)^(1/q) - 1 )^q - 1)  NOTICE: This is an approximate not an exact solution
+ *   where q = log(1+1/N) / log(2)
+ */
+inline double loanInterestRateFormula(double A, double P, int N)
+{
+  double q = log10(1.0 + 1.0/N) / log10(2.0);
+  return pow((pow((1.0 + P/A), 1.0/q) -1.0), q) -1.0;
+}
+
+#endif // LOANFORMULAS_H_INCLUDED
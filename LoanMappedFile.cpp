@@ -0,0 +1,109 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#include "LoanMappedFile.h"
+
+using namespace std;
+
+LoanMappedFile::LoanMappedFile() :
+  data_(NULL),
+  size_(0),
+  mapped_(false)
+{
+}
+
+LoanMappedFile::~LoanMappedFile()
+{
+  close();
+}
+
+void LoanMappedFile::open(const string &fileName)
+{
+  close();
+
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if(fd < 0)
+  {
+    throw runtime_error("Cant open " + fileName + ": " + strerror(errno));
+  }
+
+  struct stat status;
+  if(fstat(fd, &status) != 0)
+  {
+    int error = errno;
+    ::close(fd);
+    throw runtime_error("Cant open " + fileName + ": " + strerror(error));
+  }
+
+  // Named pipes and devices are read instead
+  if(!S_ISREG(status.st_mode))
+  {
+    ::close(fd);
+    ifstream is(fileName.c_str(), ios::in | ios::binary);
+    if(!is)
+    {
+      throw runtime_error("Cant open " + fileName + ": " + strerror(errno));
+    }
+    read(is);
+    return;
+  }
+
+  if(status.st_size == 0)
+  {
+    ::close(fd);
+    return;
+  }
+
+  void *data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  int error = errno;
+  // The mapping keeps its own reference to the file
+  ::close(fd);
+  if(data == MAP_FAILED)
+  {
+    throw runtime_error("Cant map " + fileName + ": " + strerror(error));
+  }
+
+  // The file is parsed front to back, so read ahead aggressively
+  madvise(data, status.st_size, MADV_SEQUENTIAL);
+
+  data_ = (const char *) data;
+  size_ = status.st_size;
+  mapped_ = true;
+}
+
+void LoanMappedFile::read(istream &is)
+{
+  close();
+
+  buffer_.assign(istreambuf_iterator<char>(is), istreambuf_iterator<char>());
+  if(is.bad())
+  {
+    throw runtime_error("Error reading the bulk input");
+  }
+
+  data_ = (buffer_.empty() ? NULL : &buffer_[0]);
+  size_ = buffer_.size();
+}
+
+void LoanMappedFile::close()
+{
+  if(mapped_)
+  {
+    munmap((void *) data_, size_);
+  }
+
+  vector<char>().swap(buffer_);
+  data_ = NULL;
+  size_ = 0;
+  mapped_ = false;
+}
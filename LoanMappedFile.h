@@ -0,0 +1,51 @@
+#ifndef LOANMAPPEDFILE_H_INCLUDED
+#define LOANMAPPEDFILE_H_INCLUDED
+
+/*
+Read only view of the contents of a file, used for the bulk input.
+
+Regular files are memory mapped, so they are never read through a stream
+or copied: the pages are read by the kernel as the parser first touches
+them, in parallel from each parsing thread. Pipes and stdin cant be
+mapped, so they are read into a buffer instead.
+*/
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class LoanMappedFile
+{
+public:
+  LoanMappedFile();
+  ~LoanMappedFile();
+
+  /**
+   * Map the file, throws runtime_error if it cant be opened
+   * or mapped. Any previously opened file is closed
+   */
+  void open(const std::string &fileName);
+
+  /**
+   * Read all of a stream that cant be mapped, as in stdin
+   */
+  void read(std::istream &is);
+
+  void close();
+
+  // The contents, valid until close(), NULL if empty
+  inline const char *getData() const { return data_; }
+  inline size_t getSize() const      { return size_; }
+
+private:
+  LoanMappedFile(const LoanMappedFile &);
+  LoanMappedFile &operator=(const LoanMappedFile &);
+
+  const char *data_;
+  size_t size_;
+  bool mapped_;
+  std::vector<char> buffer_; // only used by read()
+};
+
+#endif // LOANMAPPEDFILE_H_INCLUDED
@@ -0,0 +1,439 @@
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "LoanMathKernels.h"
+#include "LoanVector.h"
+
+using namespace std;
+
+//
+// The kernels are written once, as templates on the vector type, with
+// GCC vector extensions. Each template is always inlined into a wrapper
+// function compiled for the target instruction set, so the same code
+// is compiled to AVX-512, AVX2+FMA and the portable baseline.
+//
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define LOAN_KERNEL_X86
+  #define LOAN_KERNEL_TARGET_AVX2   __attribute__((target("avx2,fma")))
+  #define LOAN_KERNEL_TARGET_AVX512 __attribute__((target("avx512f,avx512dq,fma")))
+#endif
+
+typedef float Float4  __attribute__((vector_size(16)));
+typedef int   Int4    __attribute__((vector_size(16)));
+typedef float Float8  __attribute__((vector_size(32)));
+typedef int   Int8    __attribute__((vector_size(32)));
+typedef float Float16 __attribute__((vector_size(64)));
+typedef int   Int16   __attribute__((vector_size(64)));
+
+static const float LN2_HI   = 0.693359375f;
+static const float LN2_LO   = -2.12194440e-4f;
+static const float LOG2E    = 1.44269504088896341f;
+static const float SQRT_HALF = 0.707106781186547524f;
+static const float EXP_MAX  = 88.0f;
+static const float EXP_MIN  = -87.0f;
+
+//
+// Error free transformations, a+b and a*b as the sum of two floats
+//
+
+template<typename VF>
+static LOAN_VECTOR_INLINE void twoSum(const VF &a, const VF &b, VF &sum, VF &error)
+{
+  sum = a + b;
+  VF bb = sum - a;
+  error = (a - (sum - bb)) + (b - bb);
+}
+
+// Dekker's product, all of the partial products are exact, so this
+// also holds when the compiler contracts them into fused multiply adds
+template<typename VF>
+static LOAN_VECTOR_INLINE void twoProduct(const VF &a, const VF &b, VF &product, VF &error)
+{
+  const float SPLIT = 4097.0f; // 2^12+1
+  VF ca = a*SPLIT;
+  VF ah = ca - (ca - a);
+  VF al = a - ah;
+  VF cb = b*SPLIT;
+  VF bh = cb - (cb - b);
+  VF bl = b - bh;
+
+  product = a*b;
+  error = ((ah*bh - product) + ah*bl + al*bh) + al*bl;
+}
+
+/**
+ * log(1+x) as hi+lo, for x > -1. Returns NaN for x < -1, -inf for x == -1
+ *
+ * Cephes logf on u=1+x: u = m*2^e with m in [sqrt(1/2), sqrt(2)), then a
+ * degree 9 polynomial on m-1, plus a correction for the rounding of 1+x:
+ *   log(1+x) ~= log(u) + (x-(u-1))/u
+ * The leading terms are summed without rounding error, so hi+lo is
+ * accurate to well below 1 ULP of hi.
+ */
+template<typename VF, typename VI>
+static LOAN_VECTOR_INLINE VF vectorLogOnePlus(const VF &x, VF &lo)
+{
+  VF zero = x*0.0f;
+  VF u = x + 1.0f;
+  VF correction = (u == zero) ? zero : (x - (u - 1.0f)) / u;
+
+  VI bits = (VI) u;
+  VI e = ((bits >> 23) & 0xff) - 126;
+  VF m = (VF) ((bits & 0x807fffff) | 0x3f000000);   // m in [0.5, 1)
+
+  VI small = (m < SQRT_HALF);                        // -1 where true
+  e = e + small;
+  m = small ? (m + m - 1.0f) : (m - 1.0f);
+  VF fe = __builtin_convertvector(e, VF);
+
+  VF z = m*m;
+  VF y = zero + 7.0376836292E-2f;
+  y = y*m - 1.1514610310E-1f;
+  y = y*m + 1.1676998740E-1f;
+  y = y*m - 1.2420140846E-1f;
+  y = y*m + 1.4249322787E-1f;
+  y = y*m - 1.6668057665E-1f;
+  y = y*m + 2.0000714765E-1f;
+  y = y*m - 2.4999993993E-1f;
+  y = y*m + 3.3333331174E-1f;
+  y = y*m*z;
+  y = y + fe*LN2_LO;
+  y = y - 0.5f*z;
+  y = y + correction;
+
+  // hi+lo = fe*LN2_HI + m + y, fe*LN2_HI is exact
+  VF a, ae, hi;
+  twoSum(fe*LN2_HI, m, a, ae);
+  twoSum(a, y + ae, hi, lo);
+
+  hi = (u == zero) ? (zero - INFINITY) : hi;
+  hi = (u < zero) ? (zero + NAN) : hi;
+  lo = (hi - hi == zero) ? lo : zero;
+  return hi;
+}
+
+/**
+ * Range reduction for exp(x+xlo): x+xlo = t*ln(2) + r, with |r| <= ln(2)/2,
+ * returns the polynomial p = expm1(r) and sets scale = 2^t
+ */
+template<typename VF, typename VI>
+static LOAN_VECTOR_INLINE VF vectorExpReduce(const VF &xin, const VF &xlo, VF &scale)
+{
+  VF x = (xin > EXP_MAX) ? (xin - xin + EXP_MAX) : xin;
+  x = (x < EXP_MIN) ? (x - x + EXP_MIN) : x;
+
+  // t = round(x/ln(2)), truncation rounds towards zero, so adjust negatives
+  VF ft = x*LOG2E + 0.5f;
+  VI t = __builtin_convertvector(ft, VI);
+  VF tf = __builtin_convertvector(t, VF);
+  t = (tf > ft) ? (t - 1) : t;
+  tf = __builtin_convertvector(t, VF);
+
+  // x - t*LN2_HI is exact
+  VF r = x - tf*LN2_HI;
+  r = r - tf*LN2_LO + xlo;
+
+  // expm1(r) to degree 7, |r| <= 0.3466
+  VF p = r*0.0f + 1.0f/5040.0f;
+  p = p*r + 1.0f/720.0f;
+  p = p*r + 1.0f/120.0f;
+  p = p*r + 1.0f/24.0f;
+  p = p*r + 1.0f/6.0f;
+  p = p*r + 0.5f;
+  p = p*r*r + r;
+
+  scale = (VF) ((t + 127) << 23);
+  return p;
+}
+
+// exp(x+xlo)
+template<typename VF, typename VI>
+static LOAN_VECTOR_INLINE VF vectorExp(const VF &x, const VF &xlo)
+{
+  VF scale;
+  VF p = vectorExpReduce<VF, VI>(x, xlo, scale);
+  VF result = (p + 1.0f) * scale;
+
+  VF zero = x*0.0f;
+  result = (x > EXP_MAX) ? (zero + INFINITY) : result;
+  return (x < EXP_MIN) ? zero : result;
+}
+
+// exp(x+xlo) - 1
+template<typename VF, typename VI>
+static LOAN_VECTOR_INLINE VF vectorExpMinusOne(const VF &x, const VF &xlo)
+{
+  VF scale;
+  VF p = vectorExpReduce<VF, VI>(x, xlo, scale);
+  VF result = p*scale + (scale - 1.0f);
+
+  VF zero = x*0.0f;
+  result = (x > EXP_MAX) ? (zero + INFINITY) : result;
+  return (x < EXP_MIN) ? (zero - 1.0f) : result;
+}
+
+//
+// Array drivers, the tail is padded into a full vector
+//
+
+template<typename VF, typename VI, LoanMathKernelFunction FUNCTION>
+static LOAN_VECTOR_INLINE VF vectorKernel(const VF &i, const VF &n)
+{
+  VF logLo;
+  VF logHi = vectorLogOnePlus<VF, VI>(i, logLo);
+  if(FUNCTION == KERNEL_LOG_ONE_PLUS)
+  {
+    return logHi + logLo;
+  }
+
+  // y = n*log(1+i), as hi+lo
+  VF y, yLo;
+  twoProduct(n, logHi, y, yLo);
+  yLo = yLo + n*logLo;
+  yLo = (y - y == y*0.0f) ? yLo : y*0.0f;
+
+  if(FUNCTION == KERNEL_POW_ONE_PLUS)
+  {
+    return vectorExp<VF, VI>(y, yLo);
+  }
+
+  return vectorExpMinusOne<VF, VI>(y, yLo);
+}
+
+template<typename VF, typename VI, LoanMathKernelFunction FUNCTION>
+static LOAN_VECTOR_INLINE void arrayKernel(const float *i, const float *n, float *out, size_t count)
+{
+  const size_t WIDTH = sizeof(VF)/sizeof(float);
+  VF vi = (VF) {};
+  VF vn = (VF) {};
+  size_t k = 0;
+
+  for(; k + WIDTH <= count; k += WIDTH)
+  {
+    memcpy(&vi, i+k, sizeof(VF));
+    if(FUNCTION != KERNEL_LOG_ONE_PLUS)
+    {
+      memcpy(&vn, n+k, sizeof(VF));
+    }
+    VF result = vectorKernel<VF, VI, FUNCTION>(vi, vn);
+    memcpy(out+k, &result, sizeof(VF));
+  }
+
+  if(k < count)
+  {
+    size_t tail = count - k;
+    vi = (VF) {};
+    vn = (VF) {};
+    memcpy(&vi, i+k, tail*sizeof(float));
+    if(FUNCTION != KERNEL_LOG_ONE_PLUS)
+    {
+      memcpy(&vn, n+k, tail*sizeof(float));
+    }
+    VF result = vectorKernel<VF, VI, FUNCTION>(vi, vn);
+    memcpy(out+k, &result, tail*sizeof(float));
+  }
+}
+
+//
+// The kernels, compiled once per instruction set
+//
+
+typedef void (*LoanKernelFunction)(const float *i, const float *n, float *out, size_t count);
+
+struct LoanKernelTable
+{
+  const char *name;
+  LoanKernelFunction function[3]; // indexed by LoanMathKernelFunction
+};
+
+#define LOAN_KERNEL_DEFINE(NAME, TARGET, VF, VI) \
+  TARGET static void NAME##PowOnePlus(const float *i, const float *n, float *out, size_t count) \
+    { arrayKernel<VF, VI, KERNEL_POW_ONE_PLUS>(i, n, out, count); } \
+  TARGET static void NAME##PowOnePlusMinusOne(const float *i, const float *n, float *out, size_t count) \
+    { arrayKernel<VF, VI, KERNEL_POW_ONE_PLUS_MINUS_ONE>(i, n, out, count); } \
+  TARGET static void NAME##LogOnePlus(const float *i, const float *n, float *out, size_t count) \
+    { arrayKernel<VF, VI, KERNEL_LOG_ONE_PLUS>(i, n, out, count); }
+
+#define LOAN_KERNEL_TABLE(NAME, STRING) \
+  { STRING, { NAME##PowOnePlus, NAME##PowOnePlusMinusOne, NAME##LogOnePlus } }
+
+LOAN_KERNEL_DEFINE(portable, , Float4, Int4)
+
+#ifdef LOAN_KERNEL_X86
+LOAN_KERNEL_DEFINE(avx2, LOAN_KERNEL_TARGET_AVX2, Float8, Int8)
+LOAN_KERNEL_DEFINE(avx512, LOAN_KERNEL_TARGET_AVX512, Float16, Int16)
+#endif
+
+static const LoanKernelTable KERNEL_TABLES[] = {
+  LOAN_KERNEL_TABLE(portable, "portable"),
+#ifdef LOAN_KERNEL_X86
+  LOAN_KERNEL_TABLE(avx2, "avx2"),
+  LOAN_KERNEL_TABLE(avx512, "avx512")
+#endif
+};
+
+//
+// Kernel selection
+//
+
+static bool cpuSupportsKernel(LoanMathKernelType type)
+{
+  if(type == KERNEL_PORTABLE)
+  {
+    return true;
+  }
+#ifdef LOAN_KERNEL_X86
+  __builtin_cpu_init();
+  if(type == KERNEL_AVX2)
+  {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  }
+  if(type == KERNEL_AVX512)
+  {
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") &&
+           __builtin_cpu_supports("fma");
+  }
+#endif
+  return false;
+}
+
+LoanMathKernelType detectLoanMathKernel()
+{
+  if(cpuSupportsKernel(KERNEL_AVX512))
+  {
+    return KERNEL_AVX512;
+  }
+  if(cpuSupportsKernel(KERNEL_AVX2))
+  {
+    return KERNEL_AVX2;
+  }
+  return KERNEL_PORTABLE;
+}
+
+// Selected on first use, the static initialization is thread safe. The
+// kernel can be changed by setLoanMathKernel() while other threads are
+// calculating, so the pointer is atomic, each call using one table or
+// the other
+static atomic<const LoanKernelTable *> &selectedKernel()
+{
+  static atomic<const LoanKernelTable *> table(&KERNEL_TABLES[detectLoanMathKernel()]);
+  return table;
+}
+
+// The tables are constant, so a relaxed load is enough to call them
+static inline const LoanKernelTable *getSelectedKernel()
+{
+  return selectedKernel().load(memory_order_relaxed);
+}
+
+bool setLoanMathKernel(LoanMathKernelType type)
+{
+  if(!cpuSupportsKernel(type))
+  {
+    return false;
+  }
+
+  selectedKernel().store(&KERNEL_TABLES[type], memory_order_release);
+  return true;
+}
+
+LoanMathKernelType getLoanMathKernel()
+{
+  return (LoanMathKernelType) (getSelectedKernel() - KERNEL_TABLES);
+}
+
+const char *getLoanMathKernelName()
+{
+  return getSelectedKernel()->name;
+}
+
+//
+// The kernels
+//
+
+void loanPowOnePlus(const float *i, const float *n, float *out, size_t count)
+{
+  getSelectedKernel()->function[KERNEL_POW_ONE_PLUS](i, n, out, count);
+}
+
+void loanPowOnePlusMinusOne(const float *i, const float *n, float *out, size_t count)
+{
+  getSelectedKernel()->function[KERNEL_POW_ONE_PLUS_MINUS_ONE](i, n, out, count);
+}
+
+void loanLogOnePlus(const float *x, float *out, size_t count)
+{
+  getSelectedKernel()->function[KERNEL_LOG_ONE_PLUS](x, NULL, out, count);
+}
+
+//
+// Verification against the scalar calculation
+//
+
+static float ulpDistance(float a, float b)
+{
+  if(a == b)
+  {
+    return 0.0;
+  }
+  if(isnan(a) || isnan(b) || isinf(a) || isinf(b))
+  {
+    return INFINITY;
+  }
+
+  // Map the float bit patterns onto a monotonic integer line
+  int32_t ia, ib;
+  memcpy(&ia, &a, sizeof(ia));
+  memcpy(&ib, &b, sizeof(ib));
+  int64_t la = (ia < 0 ? (int64_t) INT32_MIN - ia : ia);
+  int64_t lb = (ib < 0 ? (int64_t) INT32_MIN - ib : ib);
+
+  return (float) (la > lb ? la - lb : lb - la);
+}
+
+float loanMathKernelMaxUlpError(LoanMathKernelFunction function,
+                                const float *i,
+                                const float *n,
+                                size_t count)
+{
+  static const size_t BLOCK_SIZE = 256;
+  float result[BLOCK_SIZE];
+  float maxError = 0.0;
+
+  for(size_t first = 0; first < count; first += BLOCK_SIZE)
+  {
+    size_t blockSize = (count - first < BLOCK_SIZE ? count - first : BLOCK_SIZE);
+    getSelectedKernel()->function[function](i+first, (n == NULL ? NULL : n+first), result, blockSize);
+
+    for(size_t k = 0; k < blockSize; ++k)
+    {
+      double expected;
+      double logOnePlus = log1p((double) i[first+k]);
+      if(function == KERNEL_LOG_ONE_PLUS)
+      {
+        expected = logOnePlus;
+      }
+      else if(function == KERNEL_POW_ONE_PLUS)
+      {
+        expected = exp(n[first+k]*logOnePlus);
+      }
+      else
+      {
+        expected = expm1(n[first+k]*logOnePlus);
+      }
+
+      float error = ulpDistance(result[k], (float) expected);
+      if(error > maxError)
+      {
+        maxError = error;
+      }
+    }
+  }
+
+  return maxError;
+}
@@ -0,0 +1,86 @@
+#ifndef LOANMATHKERNELS_H_INCLUDED
+#define LOANMATHKERNELS_H_INCLUDED
+
+/*
+Vectorized math kernels for the loan formulas, used by LoanBatch in place
+of one pow() or log10() call per loan.
+
+  loanPowOnePlus()          out[k] = (1+i[k])^n[k]
+  loanPowOnePlusMinusOne()  out[k] = (1+i[k])^n[k] - 1
+  loanLogOnePlus()          out[k] = log(1+x[k])
+
+All three are calculated as exp(n*log(1+i)) with a correction for the
+rounding of 1+i, so they stay accurate for the small periodic rates used
+by the loan formulas. loanPowOnePlusMinusOne() is calculated directly with
+an expm1() kernel, so (1+i)^-N - 1 does not lose digits when N is small.
+
+The kernels process 16 (AVX-512), 8 (AVX2) or 4 (portable) loans per
+instruction. The portable kernel is written with GCC vector extensions,
+so it compiles to SSE2 on x86_64 and to the native vector unit elsewhere.
+The fastest kernel the CPU supports is selected by CPUID the first time a
+kernel is called, or it can be forced with setLoanMathKernel().
+
+Accuracy, as checked with loanMathKernelMaxUlpError() against pow(),
+expm1() and log1p() calculated in double and rounded to float, for
+periodic rates |i| <= 0.05 (60% yearly, paid monthly) and |n*log(1+i)| <= 80:
+  loanLogOnePlus()          <= 1 ULP
+  loanPowOnePlus()          <= 3 ULP
+  loanPowOnePlusMinusOne()  <= 3 ULP
+The error of the pow kernels grows for larger rates, to about 12 ULP for
+i = 0.13 and |n| = 600. Results above e^88 overflow to inf and results
+below e^-87 are flushed to 0.
+*/
+
+#include <cstddef>
+
+enum LoanMathKernelType
+{
+  KERNEL_PORTABLE=0,
+  KERNEL_AVX2,
+  KERNEL_AVX512
+};
+
+enum LoanMathKernelFunction
+{
+  KERNEL_POW_ONE_PLUS=0,
+  KERNEL_POW_ONE_PLUS_MINUS_ONE,
+  KERNEL_LOG_ONE_PLUS
+};
+
+//
+// The kernels, the arrays must have count elements,
+// the input and output arrays may be the same array
+//
+
+void loanPowOnePlus(const float *i, const float *n, float *out, size_t count);
+void loanPowOnePlusMinusOne(const float *i, const float *n, float *out, size_t count);
+void loanLogOnePlus(const float *x, float *out, size_t count);
+
+//
+// Kernel selection
+//
+
+/**
+ * The fastest kernel supported by this CPU
+ */
+LoanMathKernelType detectLoanMathKernel();
+
+/**
+ * Force the kernel used, returns false and leaves the kernel
+ * unchanged if the CPU does not support the requested kernel
+ */
+bool setLoanMathKernel(LoanMathKernelType type);
+LoanMathKernelType getLoanMathKernel();
+const char *getLoanMathKernelName();
+
+/**
+ * Verify the currently selected kernel against the scalar double
+ * precision calculation, returns the maximum error found in ULPs.
+ * n is ignored for KERNEL_LOG_ONE_PLUS and may be NULL.
+ */
+float loanMathKernelMaxUlpError(LoanMathKernelFunction function,
+                                const float *i,
+                                const float *n,
+                                size_t count);
+
+#endif // LOANMATHKERNELS_H_INCLUDED
@@ -0,0 +1,72 @@
+#ifndef LOANNUMERICPOLICY_H_INCLUDED
+#define LOANNUMERICPOLICY_H_INCLUDED
+
+/*
+Numeric policies for BasicLoanCalculator, see LoanCalculator.h
+
+A policy defines:
+  Money   the type of the money amounts: loan amount, payments, fees and balances
+  Real    the type of the rates, percentages and number of payments
+  toDouble(Money), fromDouble(double)
+          conversions used around the formulas in LoanFormulas.h, which
+          are calculated in double for every policy
+  isInRange(double)
+          whether fromDouble() can convert the amount, without throwing
+  getMaxAmount()
+          the largest money amount, in either sign, that isnt infinite
+  percentOf(Money, Real percent)
+          percent% of a money amount, as in the opening fee percentage
+  printfFormat()
+          the printf() format of toDouble(Money), as the Money is printed
+          by the stream operators
+
+LoanFloatPolicy   float,  the fastest, for bulk screening
+LoanDoublePolicy  double
+LoanCentsPolicy   exact fixed point cents, the money amounts are rounded to the
+                  cent once per result, and all sums of money are exact
+*/
+
+#include <float.h>
+
+#include "LoanCents.h"
+
+struct LoanFloatPolicy
+{
+  typedef float Money;
+  typedef float Real;
+
+  static inline double toDouble(Money amount)   { return amount; }
+  static inline Money fromDouble(double amount) { return amount; }
+  static inline bool isInRange(double)          { return true; }
+  static inline double getMaxAmount()           { return FLT_MAX; }
+  static inline Money percentOf(Money amount, Real percent) { return amount*(percent/100.0); }
+  static inline const char *printfFormat()                  { return "%g"; }
+};
+
+struct LoanDoublePolicy
+{
+  typedef double Money;
+  typedef double Real;
+
+  static inline double toDouble(Money amount)   { return amount; }
+  static inline Money fromDouble(double amount) { return amount; }
+  static inline bool isInRange(double)          { return true; }
+  static inline double getMaxAmount()           { return DBL_MAX; }
+  static inline Money percentOf(Money amount, Real percent) { return amount*(percent/100.0); }
+  static inline const char *printfFormat()                  { return "%g"; }
+};
+
+struct LoanCentsPolicy
+{
+  typedef LoanCents Money;
+  typedef double Real;
+
+  static inline double toDouble(Money amount)   { return amount.toDouble(); }
+  static inline Money fromDouble(double amount) { return LoanCents::fromDouble(amount); }
+  static inline bool isInRange(double amount)   { return LoanCents::isInRange(amount); }
+  static inline double getMaxAmount()           { return LoanCents::getMaxAmount(); }
+  static inline Money percentOf(Money amount, Real percent) { return amount.percentOf(percent); }
+  static inline const char *printfFormat()                  { return "%.2f"; }
+};
+
+#endif // LOANNUMERICPOLICY_H_INCLUDED
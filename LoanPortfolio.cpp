@@ -0,0 +1,148 @@
+
+#include <stdio.h>
+
+#include <iostream>
+#include <stdexcept>
+
+#include "LoanPortfolio.h"
+
+using namespace std;
+
+const int LoanPortfolio::MAX_PERIODS;
+
+LoanPortfolio::LoanPortfolio(int bucketPeriods) :
+  bucketPeriods_(bucketPeriods),
+  loans_(0),
+  errors_(0)
+{
+  if(bucketPeriods < 1)
+  {
+    throw invalid_argument("The cash flow buckets must be of at least 1 period");
+  }
+}
+
+void LoanPortfolio::addLoan(double amount, double interest, int periodTotal, int periodElapsed,
+                            double payment, double balance)
+{
+  if(periodTotal > MAX_PERIODS)
+  {
+    throw invalid_argument("Total period of a loan of a portfolio out of range");
+  }
+
+  ++loans_;
+  amount_.add(amount);
+  balance_.add(balance);
+  payment_.add(payment);
+
+  int remaining = periodTotal - periodElapsed;
+  if(remaining <= 0)
+  {
+    return;
+  }
+
+  rateBalance_.add(interest*balance);
+  termBalance_.add(remaining*balance);
+
+  if(cashFlowChanges_.size() < (size_t) remaining + 1)
+  {
+    cashFlowChanges_.resize(remaining + 1);
+  }
+  cashFlowChanges_[0].add(payment);
+  cashFlowChanges_[remaining].add(-payment);
+}
+
+void LoanPortfolio::merge(const LoanPortfolio &partial)
+{
+  if(partial.bucketPeriods_ != bucketPeriods_)
+  {
+    throw invalid_argument("Cant merge portfolios of different cash flow buckets");
+  }
+
+  loans_ += partial.loans_;
+  errors_ += partial.errors_;
+  amount_.merge(partial.amount_);
+  balance_.merge(partial.balance_);
+  payment_.merge(partial.payment_);
+  rateBalance_.merge(partial.rateBalance_);
+  termBalance_.merge(partial.termBalance_);
+
+  if(cashFlowChanges_.size() < partial.cashFlowChanges_.size())
+  {
+    cashFlowChanges_.resize(partial.cashFlowChanges_.size());
+  }
+  for(size_t period = 0; period < partial.cashFlowChanges_.size(); ++period)
+  {
+    cashFlowChanges_[period].merge(partial.cashFlowChanges_[period]);
+  }
+}
+
+void LoanPortfolio::clear()
+{
+  loans_ = errors_ = 0;
+  amount_.clear();
+  balance_.clear();
+  payment_.clear();
+  rateBalance_.clear();
+  termBalance_.clear();
+  cashFlowChanges_.clear();
+}
+
+double LoanPortfolio::getWeightedRate() const
+{
+  double balance = balance_.getValue();
+  return (balance != 0.0 ? rateBalance_.getValue()/balance : 0.0);
+}
+
+double LoanPortfolio::getWeightedTerm() const
+{
+  double balance = balance_.getValue();
+  return (balance != 0.0 ? termBalance_.getValue()/balance : 0.0);
+}
+
+void LoanPortfolio::getCashFlows(vector<double> &buckets) const
+{
+  // The last change is the end of the longest loan
+  size_t periods = (cashFlowChanges_.empty() ? 0 : cashFlowChanges_.size() - 1);
+  buckets.assign((periods + bucketPeriods_ - 1)/bucketPeriods_, 0.0);
+
+  LoanSum cashFlow;
+  LoanSum bucket;
+  for(size_t period = 0; period < periods; ++period)
+  {
+    cashFlow.merge(cashFlowChanges_[period]);
+    bucket.add(cashFlow.getValue());
+
+    if((period + 1)%bucketPeriods_ == 0 || period + 1 == periods)
+    {
+      buckets[period/bucketPeriods_] = bucket.getValue();
+      bucket.clear();
+    }
+  }
+}
+
+void LoanPortfolio::write(ostream &os) const
+{
+  char buffer[256];
+
+  snprintf(buffer, sizeof(buffer),
+           "Loans                  = %lu\n"
+           "Errors                 = %lu\n"
+           "Total Amount           = %.2f\n"
+           "Total Balance          = %.2f\n"
+           "Total Payment          = %.2f\n"
+           "Weighted Average Rate  = %.4f%%\n"
+           "Weighted Average Term  = %.2f\n",
+           (unsigned long) loans_, (unsigned long) errors_,
+           getTotalAmount(), getTotalBalance(), getTotalPayment(),
+           getWeightedRate(), getWeightedTerm());
+  os << buffer << "\nPeriods,Cash Flow\n";
+
+  vector<double> buckets;
+  getCashFlows(buckets);
+  for(size_t k = 0; k < buckets.size(); ++k)
+  {
+    snprintf(buffer, sizeof(buffer), "%lu-%lu,%.2f\n",
+             (unsigned long) (k*bucketPeriods_ + 1), (unsigned long) ((k + 1)*bucketPeriods_), buckets[k]);
+    os << buffer;
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef LOANPORTFOLIO_H_INCLUDED
+#define LOANPORTFOLIO_H_INCLUDED
+
+/*
+Portfolio totals of a set of loans, reduced as the loans are calculated,
+so the results of each loan are never written out. See
+LoanBulk::aggregate(), which keeps one partial portfolio per thread and
+merges them once all of the loans have been calculated, in one pass over
+the input.
+
+For each loan, with its payment P, its balance B after its elapsed
+periods n, and its rate r:
+  the totals     of the amounts, balances and payments
+  the weighted   average rate and remaining term N - n, weighted by B
+  the cash flow  P in each of its remaining periods, projected from now,
+                 summed in buckets of bucketPeriods periods
+Every sum is compensated, see LoanSum.h, so the totals of millions of
+float results dont drift with the number of loans or threads.
+
+The cash flow of a loan is added to a difference array of the periods,
++P at its first remaining period and -P after its last, so adding a loan
+costs the same whatever its term. The periods are prefix summed once, when
+the cash flows are read. The array is as long as the longest term, so the
+terms are at most MAX_PERIODS.
+*/
+
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+#include "LoanSum.h"
+
+class LoanPortfolio
+{
+public:
+  /**
+   * bucketPeriods is the number of periods of each cash flow bucket, as
+   * 1 for monthly or 12 for yearly cash flows
+   */
+  explicit LoanPortfolio(int bucketPeriods);
+  ~LoanPortfolio() {}
+
+  // The longest total period of a loan, 100 years of monthly payments
+  static const int MAX_PERIODS = 1200;
+
+  /**
+   * Add one loan: its financed amount, yearly rate as in 6.75, total and
+   * elapsed periods, payment and balance after the elapsed periods.
+   * Throws invalid_argument if the total period is more than MAX_PERIODS
+   */
+  void addLoan(double amount, double interest, int periodTotal, int periodElapsed,
+               double payment, double balance);
+
+  // A loan that couldnt be calculated
+  inline void addError() { ++errors_; }
+
+  // Add the loans of a partial portfolio of the same bucket size
+  void merge(const LoanPortfolio &partial);
+
+  void clear();
+
+  inline int getBucketPeriods() const   { return bucketPeriods_; }
+  inline size_t getNumLoans() const     { return loans_; }
+  inline size_t getNumErrors() const    { return errors_; }
+
+  inline double getTotalAmount() const  { return amount_.getValue(); }
+  inline double getTotalBalance() const { return balance_.getValue(); }
+  inline double getTotalPayment() const { return payment_.getValue(); }
+
+  // Weighted by the balance, 0.0 if there is no balance
+  double getWeightedRate() const;
+  double getWeightedTerm() const;
+
+  /**
+   * The projected cash flow of each bucket, from the first remaining
+   * period of the loans to the last
+   */
+  void getCashFlows(std::vector<double> &buckets) const;
+
+  // Write the totals and the cash flow buckets as text
+  void write(std::ostream &os) const;
+
+private:
+  LoanPortfolio(); // Cant initialize default version
+
+  int bucketPeriods_;
+  size_t loans_;
+  size_t errors_;
+
+  LoanSum amount_;
+  LoanSum balance_;
+  LoanSum payment_;
+  LoanSum rateBalance_;   // rate*B
+  LoanSum termBalance_;   // (N - n)*B
+
+  // The change of the cash flow at each period from now
+  std::vector<LoanSum> cashFlowChanges_;
+};
+
+#endif // LOANPORTFOLIO_H_INCLUDED
@@ -0,0 +1,105 @@
+#ifndef LOANPRODUCTS_H_INCLUDED
+#define LOANPRODUCTS_H_INCLUDED
+
+/*
+The catalog of fixed loan products, as "60 month auto at 6.75%", with
+their factors calculated by the compiler, so quoting a product costs a
+multiplication, with no pow() at run time:
+  annuity        the payment of an amount of 1.0,  P = A*annuity
+  present value  the amount of a payment of 1.0,   A = P*presentValue
+The factors are of the formulas of calculatePayment() and
+calculateLoanAmount(), with the discount factor of LoanConstexprMath.h,
+of monthly payments, and are checked by static_assert against the results
+of LoanCalculatorDouble at run time, with pow(), to 14 significant digits,
+so a product added to the catalog needs its check too.
+*/
+
+#include <string.h>
+
+#include <cstddef>
+
+#include "LoanCalcType.h"
+#include "LoanFormulas.h"
+
+struct LoanProduct
+{
+  const char *name;
+  double interest;      // yearly, as 6.75
+  int periodTotal;      // monthly payments
+  double annuity;
+  double presentValue;
+};
+
+constexpr LoanProduct makeLoanProductFactors(const char *name, double interest, int periodTotal,
+                                             double i, double discount)
+{
+  return LoanProduct{name, interest, periodTotal,
+                     loanPaymentFormula(1.0, i, discount), loanAmountFormula(1.0, i, discount)};
+}
+
+// The periodic rate as calculated by LoanCalculator
+constexpr LoanProduct makeLoanProduct(const char *name, double interest, int periodTotal)
+{
+  return makeLoanProductFactors(name, interest, periodTotal, interest/100.0/LOAN_MONTHLY,
+                                loanConstexprGrowthFactor(interest/100.0/LOAN_MONTHLY, -1*periodTotal));
+}
+
+constexpr LoanProduct LOAN_PRODUCTS[] =
+{
+  makeLoanProduct("auto36",      5.49,   36),
+  makeLoanProduct("auto60",      6.75,   60),
+  makeLoanProduct("auto72",      7.25,   72),
+  makeLoanProduct("personal24",  9.99,   24),
+  makeLoanProduct("personal60",  11.5,   60),
+  makeLoanProduct("mortgage15",  5.875,  180),
+  makeLoanProduct("mortgage30",  6.5,    360)
+};
+
+const size_t LOAN_NUM_PRODUCTS = sizeof(LOAN_PRODUCTS)/sizeof(LOAN_PRODUCTS[0]);
+
+// Within 1e-14 of expected, relative
+constexpr bool loanProductFactorIs(double factor, double expected)
+{
+  return (factor > expected ? factor - expected : expected - factor) <= 1e-14*expected;
+}
+
+static_assert(loanProductFactorIs(LOAN_PRODUCTS[0].annuity,      0.030191391603206996) &&
+              loanProductFactorIs(LOAN_PRODUCTS[0].presentValue, 33.122024090263459),
+              "auto36 differs from the calculator");
+static_assert(loanProductFactorIs(LOAN_PRODUCTS[1].annuity,      0.019683460664515297) &&
+              loanProductFactorIs(LOAN_PRODUCTS[1].presentValue, 50.804074397484762),
+              "auto60 differs from the calculator");
+static_assert(loanProductFactorIs(LOAN_PRODUCTS[2].annuity,      0.017169306158490903) &&
+              loanProductFactorIs(LOAN_PRODUCTS[2].presentValue, 58.243471854304389),
+              "auto72 differs from the calculator");
+static_assert(loanProductFactorIs(LOAN_PRODUCTS[3].annuity,      0.046140310985098298) &&
+              loanProductFactorIs(LOAN_PRODUCTS[3].presentValue, 21.673022540376135),
+              "personal24 differs from the calculator");
+static_assert(loanProductFactorIs(LOAN_PRODUCTS[4].annuity,      0.0219926073748705) &&
+              loanProductFactorIs(LOAN_PRODUCTS[4].presentValue, 45.469824607637662),
+              "personal60 differs from the calculator");
+static_assert(loanProductFactorIs(LOAN_PRODUCTS[5].annuity,      0.008371184940405901) &&
+              loanProductFactorIs(LOAN_PRODUCTS[5].presentValue, 119.45740144542933),
+              "mortgage15 differs from the calculator");
+static_assert(loanProductFactorIs(LOAN_PRODUCTS[6].annuity,      0.0063206802349296534) &&
+              loanProductFactorIs(LOAN_PRODUCTS[6].presentValue, 158.21081953707306),
+              "mortgage30 differs from the calculator");
+static_assert(LOAN_NUM_PRODUCTS == 7, "Each product of the catalog must be checked");
+
+/**
+ * The product of this name, NULL if there is none
+ */
+inline const LoanProduct *findLoanProduct(const char *name)
+{
+  for(size_t k = 0; k < LOAN_NUM_PRODUCTS; ++k)
+  {
+    if(strcmp(LOAN_PRODUCTS[k].name, name) == 0)
+    {
+      return &LOAN_PRODUCTS[k];
+    }
+  }
+
+  return NULL;
+}
+
+#endif // LOANPRODUCTS_H_INCLUDED
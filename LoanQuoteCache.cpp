@@ -0,0 +1,326 @@
+
+#include <string.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "LoanQuoteCache.h"
+
+using namespace std;
+
+static const int DEFAULT_SHARDS = 16;
+
+//
+// LoanQuoteKey
+//
+
+void LoanQuoteKey::computeHash()
+{
+  // Each word is mixed by its own multiply, independent of the others so
+  // they pipeline, then combined, and the result mixed again so that both
+  // the shard (high bits) and the bucket (low bits) vary
+  uint64_t words[1 + LOAN_RECORD_FIELDS];
+  words[0] = ((uint64_t) calcType << 32) | precision;
+  memcpy(&words[1], fields, sizeof(fields));
+
+  uint64_t h = 0;
+  for(size_t word = 0; word < sizeof(words)/sizeof(words[0]); ++word)
+  {
+    uint64_t x = (words[word] ^ (word*0x9e3779b97f4a7c15ULL))*0xbf58476d1ce4e5b9ULL;
+    h = ((h << 7) | (h >> 57)) ^ x ^ (x >> 31);
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+
+  hash = (size_t) h;
+}
+
+bool LoanQuoteKey::operator==(const LoanQuoteKey &other) const
+{
+  return hash == other.hash &&
+         calcType == other.calcType &&
+         precision == other.precision &&
+         memcmp(fields, other.fields, sizeof(fields)) == 0;
+}
+
+//
+// LoanQuoteCache
+//
+
+//
+// A shard is preallocated to its capacity: the entries, in an LRU list
+// linked by their index, and an open addressed index of the entries,
+// a power of 2 of at least twice the capacity, probed linearly
+//
+struct LoanQuoteCache::Shard
+{
+  static const int32_t NONE = -1;
+
+  struct Entry
+  {
+    LoanQuoteKey key;
+    double results[LOAN_RECORD_MAX_RESULTS];
+    int numResults;
+    int32_t prev;
+    int32_t next;
+  };
+
+  mutex lock;
+  vector<Entry> entries;
+  size_t numEntries;
+  int32_t head;          // the most recently used
+  int32_t tail;          // the least recently used
+  vector<int32_t> slots; // entry index or NONE
+  size_t mask;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+
+  // Keeps the locks of neighbouring shards off the same cache line
+  char padding[64];
+
+  void init(size_t capacity);
+  void clear();
+  size_t findSlot(const LoanQuoteKey &key) const;
+  void eraseSlot(size_t slot);
+  void unlink(int32_t entry);
+  void pushFront(int32_t entry);
+};
+
+const int32_t LoanQuoteCache::Shard::NONE;
+
+void LoanQuoteCache::Shard::init(size_t capacity)
+{
+  size_t numSlots = 1;
+  while(numSlots < 2*capacity)
+  {
+    numSlots <<= 1;
+  }
+
+  entries.resize(capacity);
+  slots.resize(numSlots);
+  mask = numSlots - 1;
+  clear();
+}
+
+void LoanQuoteCache::Shard::clear()
+{
+  numEntries = 0;
+  head = tail = NONE;
+  fill(slots.begin(), slots.end(), NONE);
+  hits = misses = evictions = 0;
+}
+
+// The slot of key, or the empty slot where it would be inserted
+size_t LoanQuoteCache::Shard::findSlot(const LoanQuoteKey &key) const
+{
+  size_t slot = key.hash & mask;
+  while(slots[slot] != NONE && !(entries[slots[slot]].key == key))
+  {
+    slot = (slot + 1) & mask;
+  }
+
+  return slot;
+}
+
+// Empty slot, moving back the following entries of its probe
+// sequence so that no lookup stops early at the hole
+void LoanQuoteCache::Shard::eraseSlot(size_t slot)
+{
+  size_t next = slot;
+  while(true)
+  {
+    next = (next + 1) & mask;
+    if(slots[next] == NONE)
+    {
+      break;
+    }
+
+    // An entry can fill the hole if its home slot isnt between the hole and it
+    size_t home = entries[slots[next]].key.hash & mask;
+    bool between = (slot <= next ? (slot < home && home <= next) : (slot < home || home <= next));
+    if(!between)
+    {
+      slots[slot] = slots[next];
+      slot = next;
+    }
+  }
+
+  slots[slot] = NONE;
+}
+
+void LoanQuoteCache::Shard::unlink(int32_t entry)
+{
+  Entry &e = entries[entry];
+  (e.prev != NONE ? entries[e.prev].next : head) = e.next;
+  (e.next != NONE ? entries[e.next].prev : tail) = e.prev;
+}
+
+void LoanQuoteCache::Shard::pushFront(int32_t entry)
+{
+  Entry &e = entries[entry];
+  e.prev = NONE;
+  e.next = head;
+  (head != NONE ? entries[head].prev : tail) = entry;
+  head = entry;
+}
+
+// At least numShards, a power of 2, so a shard is picked with a mask
+static int roundShards(int numShards)
+{
+  int rounded = 1;
+  while(rounded < numShards && rounded < (1 << 30))
+  {
+    rounded <<= 1;
+  }
+
+  return rounded;
+}
+
+LoanQuoteCache::LoanQuoteCache(size_t capacity, int numShards) :
+  capacity_(capacity > 0 ? capacity : 1),
+  numShards_(roundShards(numShards > 0 ? numShards : DEFAULT_SHARDS)),
+  shards_(new Shard[numShards_])
+{
+  for(int shard = 0; shard < numShards_; ++shard)
+  {
+    shards_[shard].init((capacity_ + numShards_ - 1)/numShards_);
+  }
+}
+
+LoanQuoteCache::~LoanQuoteCache()
+{
+  delete [] shards_;
+}
+
+// The high bits, the slots of the shard use the low bits
+LoanQuoteCache::Shard &LoanQuoteCache::getShard(size_t hash)
+{
+  return shards_[((uint64_t) hash >> 32) & (numShards_ - 1)];
+}
+
+bool LoanQuoteCache::find(const LoanQuoteKey &key, double results[LOAN_RECORD_MAX_RESULTS], int &numResults)
+{
+  Shard &shard = getShard(key.hash);
+  lock_guard<mutex> guard(shard.lock);
+
+  int32_t entry = shard.slots[shard.findSlot(key)];
+  if(entry == Shard::NONE)
+  {
+    ++shard.misses;
+    return false;
+  }
+
+  ++shard.hits;
+  if(entry != shard.head)
+  {
+    shard.unlink(entry);
+    shard.pushFront(entry);
+  }
+
+  const Shard::Entry &e = shard.entries[entry];
+  numResults = e.numResults;
+  memcpy(results, e.results, sizeof(e.results));
+
+  return true;
+}
+
+void LoanQuoteCache::insert(const LoanQuoteKey &key, const double results[LOAN_RECORD_MAX_RESULTS], int numResults)
+{
+  Shard &shard = getShard(key.hash);
+  lock_guard<mutex> guard(shard.lock);
+
+  size_t slot = shard.findSlot(key);
+  int32_t entry = shard.slots[slot];
+  if(entry != Shard::NONE)
+  {
+    // Calculated by another thread meanwhile
+    shard.unlink(entry);
+  }
+  else
+  {
+    if(shard.numEntries < shard.entries.size())
+    {
+      entry = (int32_t) shard.numEntries++;
+    }
+    else
+    {
+      // Reuse the least recently used entry
+      entry = shard.tail;
+      shard.unlink(entry);
+      shard.eraseSlot(shard.findSlot(shard.entries[entry].key));
+      ++shard.evictions;
+
+      // The erase may have moved the slot of key
+      slot = shard.findSlot(key);
+    }
+
+    shard.entries[entry].key = key;
+    shard.slots[slot] = entry;
+  }
+
+  shard.pushFront(entry);
+
+  Shard::Entry &e = shard.entries[entry];
+  e.numResults = numResults;
+  memcpy(e.results, results, sizeof(e.results));
+}
+
+void LoanQuoteCache::clear()
+{
+  for(int shard = 0; shard < numShards_; ++shard)
+  {
+    lock_guard<mutex> guard(shards_[shard].lock);
+    shards_[shard].clear();
+  }
+}
+
+uint64_t LoanQuoteCache::getHits() const
+{
+  uint64_t hits = 0;
+  for(int shard = 0; shard < numShards_; ++shard)
+  {
+    lock_guard<mutex> guard(shards_[shard].lock);
+    hits += shards_[shard].hits;
+  }
+
+  return hits;
+}
+
+uint64_t LoanQuoteCache::getMisses() const
+{
+  uint64_t misses = 0;
+  for(int shard = 0; shard < numShards_; ++shard)
+  {
+    lock_guard<mutex> guard(shards_[shard].lock);
+    misses += shards_[shard].misses;
+  }
+
+  return misses;
+}
+
+uint64_t LoanQuoteCache::getEvictions() const
+{
+  uint64_t evictions = 0;
+  for(int shard = 0; shard < numShards_; ++shard)
+  {
+    lock_guard<mutex> guard(shards_[shard].lock);
+    evictions += shards_[shard].evictions;
+  }
+
+  return evictions;
+}
+
+size_t LoanQuoteCache::getSize() const
+{
+  size_t size = 0;
+  for(int shard = 0; shard < numShards_; ++shard)
+  {
+    lock_guard<mutex> guard(shards_[shard].lock);
+    size += shards_[shard].numEntries;
+  }
+
+  return size;
+}
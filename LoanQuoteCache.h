@@ -0,0 +1,195 @@
+#ifndef LOANQUOTECACHE_H_INCLUDED
+#define LOANQUOTECACHE_H_INCLUDED
+
+/*
+Bounded cache of calculated quotes, in front of the calculation of a loan
+record (LoanRecord.h), shared by all of the threads of the server.
+
+Most quotes repeat a handful of standard amounts, rates and terms, so a
+quote of the interest rate, solved iteratively, is looked up by its
+normalized inputs before it is calculated: each field as the calculator
+stores it, money amounts through the numeric policy and periods as whole
+months, and the fields the calculation type doesnt use set to 0. Inputs that only differ in what the calculator
+would ignore or round away share an entry. Only successful calculations
+are cached, errors are always calculated again.
+
+The entries are split into shards by the hash of their key, each shard
+an LRU list with its own lock, so threads only contend when they look up
+quotes of the same shard. The number of shards is a power of 2, and a
+shard is picked by masking the hash. Once a shard is full, an insertion
+takes the place of the least recently used entry of that shard.
+
+A hit costs a hash of the key, a lock, a probe and the move to the front
+of the LRU list. In the cache benchmarks of loanCalculatorBench, a hit of
+2000 quotes cached takes about 62 ns, and of 100000 quotes, mostly cache
+misses, about 350 ns, against about 400 ns to solve the rate. The closed
+form calculations take 36 to 63 ns, no more than a hit, so
+calculateLoanRecordCached() only caches the calculation types of
+isLoanQuoteCached(), and calculates the others.
+*/
+
+#include <stdint.h>
+
+#include <cstddef>
+
+#include "LoanCalcType.h"
+#include "LoanRecord.h"
+
+struct LoanQuoteKey
+{
+  uint32_t calcType;
+  uint32_t precision;  // 0 float, 1 double, 2 cents, as in LoanServerRequest
+  double fields[LOAN_RECORD_FIELDS];
+  size_t hash;         // of the above, see computeHash()
+
+  // Set hash, once the fields are set
+  void computeHash();
+
+  // Bitwise, the fields are normalized
+  bool operator==(const LoanQuoteKey &other) const;
+};
+
+class LoanQuoteCache
+{
+public:
+  /**
+   * At most capacity quotes, rounded up to a multiple of the number of
+   * shards, in numShards shards rounded up to a power of 2, numShards <= 0
+   * uses 16. All of the memory is allocated here
+   */
+  LoanQuoteCache(size_t capacity, int numShards = 0);
+  ~LoanQuoteCache();
+
+  /**
+   * Copy the results of key to results and return true if they are cached,
+   * making them the most recently used of their shard
+   */
+  bool find(const LoanQuoteKey &key, double results[LOAN_RECORD_MAX_RESULTS], int &numResults);
+
+  /**
+   * Cache the results of key, evicting the least recently used quote
+   * of its shard if it is full
+   */
+  void insert(const LoanQuoteKey &key, const double results[LOAN_RECORD_MAX_RESULTS], int numResults);
+
+  void clear();
+
+  // Counters since the construction or the last clear()
+  uint64_t getHits() const;
+  uint64_t getMisses() const;
+  uint64_t getEvictions() const;
+  size_t getSize() const;
+
+  inline size_t getCapacity() const { return capacity_; }
+  inline int getNumShards() const { return numShards_; }
+
+private:
+  LoanQuoteCache(); // Cant initialize default version
+  LoanQuoteCache(const LoanQuoteCache &);
+  LoanQuoteCache &operator=(const LoanQuoteCache &);
+
+  struct Shard;
+
+  Shard &getShard(size_t hash);
+
+  size_t capacity_;
+  int numShards_;
+  Shard *shards_;
+};
+
+/**
+ * The normalized key of a loan record, calculated with the numeric Policy
+ * of a BasicLoanCalculator, see LoanNumericPolicy.h
+ */
+template <class Policy>
+inline LoanQuoteKey makeLoanQuoteKey(CALC_TYPE calcType, uint32_t precision, const double values[LOAN_RECORD_FIELDS])
+{
+  // The fields used by each calculation type, bit n is field n of LoanRecord.h
+  static const unsigned AMOUNT = 0x01, INTEREST = 0x02, PERIOD_TOTAL = 0x04, PAYMENT = 0x08,
+                        PERIOD_ELAPSED = 0x10, INITIAL_PAYMENT = 0x20, OPENING_FEE = 0x40, OPENING_PERCENT = 0x80;
+
+  unsigned used = 0xff;
+  if(calcType == CALC_PAYMENT)
+  {
+    used = AMOUNT | INTEREST | PERIOD_TOTAL | INITIAL_PAYMENT | OPENING_FEE | OPENING_PERCENT;
+  }
+  else if(calcType == CALC_BALANCE)
+  {
+    used = AMOUNT | INTEREST | PAYMENT | PERIOD_ELAPSED;
+  }
+  else if(calcType == CALC_NUMPAYMENTS)
+  {
+    used = AMOUNT | INTEREST | PAYMENT;
+  }
+  else if(calcType == CALC_AMOUNT)
+  {
+    used = INTEREST | PERIOD_TOTAL | PAYMENT;
+  }
+  else if(calcType == CALC_INTEREST)
+  {
+    used = AMOUNT | PERIOD_TOTAL | PAYMENT;
+  }
+
+  LoanQuoteKey key;
+  key.calcType = calcType;
+  key.precision = precision;
+  key.fields[0] = Policy::toDouble(Policy::fromDouble(values[0]));
+  key.fields[1] = (typename Policy::Real) values[1];
+  key.fields[2] = (int) values[2];
+  key.fields[3] = Policy::toDouble(Policy::fromDouble(values[3]));
+  key.fields[4] = (int) values[4];
+  key.fields[5] = Policy::toDouble(Policy::fromDouble(values[5]));
+  key.fields[6] = Policy::toDouble(Policy::fromDouble(values[6]));
+  key.fields[7] = (typename Policy::Real) values[7];
+
+  for(int field = 0; field < LOAN_RECORD_FIELDS; ++field)
+  {
+    // + 0.0 so that -0.0 and 0.0 are the same key
+    key.fields[field] = ((used & (1u << field)) ? key.fields[field] + 0.0 : 0.0);
+  }
+  key.computeHash();
+
+  return key;
+}
+
+/**
+ * Whether the results of calcType are worth caching, those solved
+ * iteratively, the interest rate
+ */
+inline bool isLoanQuoteCached(CALC_TYPE calcType)
+{
+  return calcType == CALC_INTEREST;
+}
+
+/**
+ * calculateLoanRecord() through cache, which may be NULL, for the
+ * calculation types of isLoanQuoteCached()
+ */
+template <class Calculator>
+inline int calculateLoanRecordCached(LoanQuoteCache *cache,
+                                     uint32_t precision,
+                                     CALC_TYPE calcType,
+                                     Calculator &calculator,
+                                     const double values[LOAN_RECORD_FIELDS],
+                                     double results[LOAN_RECORD_MAX_RESULTS])
+{
+  if(cache == NULL || !isLoanQuoteCached(calcType))
+  {
+    return calculateLoanRecord(calcType, calculator, values, results);
+  }
+
+  LoanQuoteKey key(makeLoanQuoteKey<typename Calculator::NumericPolicy>(calcType, precision, values));
+
+  int numResults;
+  if(cache->find(key, results, numResults))
+  {
+    return numResults;
+  }
+
+  numResults = calculateLoanRecord(calcType, calculator, values, results);
+  cache->insert(key, results, numResults);
+
+  return numResults;
+}
+
+#endif // LOANQUOTECACHE_H_INCLUDED
@@ -0,0 +1,59 @@
+#ifndef LOANRANDOM_H_INCLUDED
+#define LOANRANDOM_H_INCLUDED
+
+/*
+Counter based random numbers, Philox4x32-10 of Salmon et al, "Parallel
+random numbers: as easy as 1, 2, 3", SC 2011.
+
+The numbers are a function of a 128 bit counter and a 64 bit key, the
+seed, with no state, so the numbers of a simulated path can be generated
+by any thread in any order, and the results dont depend on the number of
+threads. Each call gives 4 independent 32 bit numbers.
+
+The function has no branches and only 32x32->64 bit multiplies, so a loop
+calling it for consecutive counters is vectorized by the compiler.
+*/
+
+#include <stdint.h>
+
+/**
+ * out = Philox4x32-10(counter, key)
+ */
+inline void loanPhilox4x32(const uint32_t counter[4], uint32_t key0, uint32_t key1, uint32_t out[4])
+{
+  static const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+  static const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+
+  for(int round = 0; round < 10; ++round)
+  {
+    uint64_t product0 = (uint64_t) M0*c0;
+    uint64_t product1 = (uint64_t) M1*c2;
+
+    uint32_t next0 = (uint32_t) (product1 >> 32) ^ c1 ^ key0;
+    uint32_t next2 = (uint32_t) (product0 >> 32) ^ c3 ^ key1;
+    c1 = (uint32_t) product1;
+    c3 = (uint32_t) product0;
+    c0 = next0;
+    c2 = next2;
+
+    key0 += W0;
+    key1 += W1;
+  }
+
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+/**
+ * A uniform double in (0, 1), never 0 or 1, of a 32 bit random number
+ */
+inline double loanUniform(uint32_t x)
+{
+  return (x + 0.5)*(1.0/4294967296.0);
+}
+
+#endif // LOANRANDOM_H_INCLUDED
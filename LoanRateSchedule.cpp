@@ -0,0 +1,147 @@
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "LoanFormulas.h"
+#include "LoanRateSchedule.h"
+
+using namespace std;
+
+LoanRateSchedule::LoanRateSchedule() :
+  initialCap_(-1.0),
+  periodicCap_(-1.0),
+  lifetimeCap_(-1.0),
+  floor_(0.0)
+{
+}
+
+void LoanRateSchedule::addReset(int period, double rate)
+{
+  if(period < 2 || (!resetPeriods_.empty() && period <= resetPeriods_.back()))
+  {
+    throw invalid_argument("The rate resets must be of increasing periods, from the second");
+  }
+  if(!(rate >= 0.0))
+  {
+    throw invalid_argument("The rate of a reset cant be negative");
+  }
+
+  resetPeriods_.push_back(period);
+  resetRates_.push_back(rate);
+}
+
+void LoanRateSchedule::addResets(int first, int interval, int periodTotal, double rate)
+{
+  if(interval < 1)
+  {
+    throw invalid_argument("The interval of the rate resets must be at least 1 period");
+  }
+
+  for(int period = first; period <= periodTotal; period += interval)
+  {
+    addReset(period, rate);
+  }
+}
+
+void LoanRateSchedule::clear()
+{
+  resetPeriods_.clear();
+  resetRates_.clear();
+}
+
+void LoanRateSchedule::setCaps(double initialCap, double periodicCap, double lifetimeCap)
+{
+  initialCap_ = initialCap;
+  periodicCap_ = periodicCap;
+  lifetimeCap_ = lifetimeCap;
+}
+
+double LoanRateSchedule::getResetRate(size_t k, double initialRate, double previousRate) const
+{
+  double rate = resetRates_[k];
+
+  double cap = (k == 0 ? initialCap_ : periodicCap_);
+  if(cap >= 0.0)
+  {
+    rate = max(previousRate - cap, min(rate, previousRate + cap));
+  }
+  if(lifetimeCap_ >= 0.0)
+  {
+    rate = min(rate, initialRate + lifetimeCap_);
+  }
+
+  return max(rate, floor_);
+}
+
+double LoanRateSchedule::recastPayment(double balance, double i, int periods)
+{
+  return loanPayment(balance, i, periods, loanGrowthFactor(i, -periods));
+}
+
+void LoanRateSchedule::calculate(double amount, double interest, int periodTotal, int periodsPerYear,
+                                 int periodElapsed, double &balance, double &payment) const
+{
+  if(periodTotal < 1 || periodsPerYear < 1 || periodElapsed < 0)
+  {
+    throw invalid_argument("Must set a total period, payments per year and elapsed period for a rate schedule");
+  }
+  if(periodElapsed >= periodTotal)
+  {
+    balance = payment = 0.0;
+    return;
+  }
+
+  // The segment starting after start payments, at rate, with balance
+  double rate = interest;
+  int start = 0;
+  balance = amount;
+
+  size_t k = 0;
+  for(;;)
+  {
+    // The next reset that changes the rate ends the segment
+    double nextRate = rate;
+    for(; k < resetPeriods_.size() && resetPeriods_[k] <= periodTotal; ++k)
+    {
+      nextRate = getResetRate(k, interest, rate);
+      if(nextRate != rate)
+      {
+        break;
+      }
+    }
+    int end = (nextRate != rate ? resetPeriods_[k] - 1 : periodTotal);
+
+    double i = rate/100.0/periodsPerYear;
+    payment = recastPayment(balance, i, periodTotal - start);
+
+    if(periodElapsed < end)
+    {
+      int elapsed = periodElapsed - start;
+      balance = loanBalance(balance, payment, i, elapsed, loanGrowthFactor(i, elapsed));
+      return;
+    }
+
+    balance = loanBalance(balance, payment, i, end - start, loanGrowthFactor(i, end - start));
+    rate = nextRate;
+    start = end;
+    ++k;
+  }
+}
+
+double LoanRateSchedule::calculateBalance(double amount, double interest, int periodTotal, int periodsPerYear,
+                                          int periodElapsed) const
+{
+  double balance, payment;
+  calculate(amount, interest, periodTotal, periodsPerYear, periodElapsed, balance, payment);
+
+  return balance;
+}
+
+double LoanRateSchedule::calculatePayment(double amount, double interest, int periodTotal, int periodsPerYear,
+                                          int periodElapsed) const
+{
+  double balance, payment;
+  calculate(amount, interest, periodTotal, periodsPerYear, periodElapsed, balance, payment);
+
+  return payment;
+}
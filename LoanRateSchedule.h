@@ -0,0 +1,110 @@
+#ifndef LOANRATESCHEDULE_H_INCLUDED
+#define LOANRATESCHEDULE_H_INCLUDED
+
+/*
+Rate schedule of an adjustable rate loan (ARM): the yearly rate of the
+first payments, as set on the calculator, which can be a teaser rate, and
+the resets, each the period of the first payment at its new rate and the
+new rate, before the caps:
+  initial cap   the first reset differs from the initial rate by at most it
+  periodic cap  the later resets differ from the previous rate by at most it
+  lifetime cap  the rate is at most the initial rate plus it
+  floor         the rate of a reset is at least it
+As in 5/1 ARM 2/1/5, the caps are in percentage points.
+
+At each reset the payment is recast, the payment that pays off the balance
+over the remaining periods at the new rate, so between resets the loan is
+an ordinary fixed rate loan, and the balance and payment of each segment
+come from the closed forms of LoanFormulas.h:
+  P   = i*B_s / (1 - (1+i)^-(N-s))
+  B_n = B_s*(1+i)^(n-s) - (P/i)*((1+i)^(n-s) - 1)
+where s is the period of the last reset before n and B_s its balance. The
+balance after n payments costs 2 pow() per segment up to n, a 30 year ARM
+a few dozen at most, instead of a loop over its periods. A reset to the
+rate already in effect doesnt change the payment, so it isnt a segment.
+
+The periods are payment periods, the periodic rate is the yearly rate
+divided by the payments per year.
+*/
+
+#include <cstddef>
+#include <vector>
+
+class LoanRateSchedule
+{
+public:
+  LoanRateSchedule();
+  ~LoanRateSchedule() {}
+
+  /**
+   * From the payment of period, 2 to N, the yearly rate is rate as in 6.75,
+   * before the caps. The periods must be added in increasing order, else
+   * invalid_argument is thrown
+   */
+  void addReset(int period, double rate);
+
+  /**
+   * Add the resets of period first and every interval periods after it,
+   * up to periodTotal, all at rate, as the index of an ARM expected to
+   * stay at rate plus the margin
+   */
+  void addResets(int first, int interval, int periodTotal, double rate);
+
+  inline size_t getNumResets() const       { return resetPeriods_.size(); }
+  inline int getResetPeriod(size_t k) const { return resetPeriods_[k]; }
+
+  // Removes the resets, not the caps
+  void clear();
+
+  /**
+   * The caps, in percentage points, a negative cap is no cap, the default
+   */
+  void setCaps(double initialCap, double periodicCap, double lifetimeCap);
+  inline double getInitialCap() const  { return initialCap_; }
+  inline double getPeriodicCap() const { return periodicCap_; }
+  inline double getLifetimeCap() const { return lifetimeCap_; }
+
+  // The minimum yearly rate, 0.0 by default
+  inline void setFloor(double floor) { floor_ = floor; }
+  inline double getFloor() const     { return floor_; }
+
+  /**
+   * The yearly rate of reset k once capped, given the initial rate of the
+   * loan and the rate before the reset
+   */
+  double getResetRate(size_t k, double initialRate, double previousRate) const;
+
+  /**
+   * The balance after periodElapsed payments, and the payment of the next
+   * period, of a loan of amount at the initial yearly rate interest, with
+   * periodTotal payments, periodsPerYear a year. The payment is 0.0 once
+   * the loan is paid off
+   */
+  double calculateBalance(double amount, double interest, int periodTotal, int periodsPerYear,
+                          int periodElapsed) const;
+  double calculatePayment(double amount, double interest, int periodTotal, int periodsPerYear,
+                          int periodElapsed) const;
+
+  /**
+   * The payment that pays off balance over periods at the periodic rate i
+   */
+  static double recastPayment(double balance, double i, int periods);
+
+private:
+  LoanRateSchedule(const LoanRateSchedule &);
+  LoanRateSchedule &operator=(const LoanRateSchedule &);
+
+  // Walk the segments up to periodElapsed, see calculateBalance()
+  void calculate(double amount, double interest, int periodTotal, int periodsPerYear,
+                 int periodElapsed, double &balance, double &payment) const;
+
+  std::vector<int> resetPeriods_;
+  std::vector<double> resetRates_;
+
+  double initialCap_;
+  double periodicCap_;
+  double lifetimeCap_;
+  double floor_;
+};
+
+#endif // LOANRATESCHEDULE_H_INCLUDED
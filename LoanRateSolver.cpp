@@ -0,0 +1,197 @@
+
+#include <float.h>
+#include <math.h>
+
+#include "LoanFormulas.h"
+#include "LoanRateSolver.h"
+
+using namespace std;
+
+// Lower bound for negative rates, (1+i)^-N grows without bound towards -1
+static const double RATE_LOWER_BOUND = -0.999999;
+
+/**
+ * The annuity factor a(i) = (1 - (1+i)^-N)/i and its first two derivatives.
+ * With v = (1+i)^-N:
+ *   v'  = -N*v/(1+i)
+ *   v'' = N*(N+1)*v/(1+i)^2
+ *   a'  = (-v' - a)/i
+ *   a'' = (-v'' - 2*a')/i
+ * At i = 0 the limits are used
+ */
+static void annuityFactor(double i, int N, double &a, double &da, double &d2a)
+{
+  if(i == 0.0)
+  {
+    a = N;
+    da = -N*(N+1.0)/2.0;
+    d2a = N*(N+1.0)*(N+2.0)/3.0;
+    return;
+  }
+
+  double logGrowth = log1p(i);
+  double v = exp(-N*logGrowth);
+  double oneMinusV = -expm1(-N*logGrowth);
+  double dv = -N*v/(1+i);
+  double d2v = N*(N+1.0)*v/((1+i)*(1+i));
+
+  a = oneMinusV/i;
+  da = (-dv - a)/i;
+  d2a = (-d2v - 2*da)/i;
+}
+
+LoanRateSolver::LoanRateSolver()
+{
+  resetCounters();
+}
+
+void LoanRateSolver::resetCounters()
+{
+  lastIterations_ = 0;
+  solveCount_ = 0;
+  for(int k = 0; k <= MAX_ITERATIONS; ++k)
+  {
+    iterationCount_[k] = 0;
+  }
+}
+
+double LoanRateSolver::getAverageIterations() const
+{
+  if(solveCount_ == 0)
+  {
+    return 0.0;
+  }
+
+  double total = 0.0;
+  for(int k = 0; k <= MAX_ITERATIONS; ++k)
+  {
+    total += k*(double)iterationCount_[k];
+  }
+
+  return total/solveCount_;
+}
+
+void LoanRateSolver::countIterations(int iterations)
+{
+  lastIterations_ = iterations;
+  ++solveCount_;
+  ++iterationCount_[iterations];
+}
+
+double LoanRateSolver::solve(double A, double P, int N)
+{
+  int iterations;
+  double rate = solveRate(A, P, N, iterations);
+  countIterations(iterations);
+
+  return rate;
+}
+
+void LoanRateSolver::solve(size_t count,
+                           const float *A,
+                           const float *P,
+                           const int *N,
+                           float *rate,
+                           int *iterations)
+{
+  for(size_t k = 0; k < count; ++k)
+  {
+    int loanIterations;
+    rate[k] = solveRate(A[k], P[k], N[k], loanIterations);
+    countIterations(loanIterations);
+
+    if(iterations != NULL)
+    {
+      iterations[k] = loanIterations;
+    }
+  }
+}
+
+double LoanRateSolver::solveRate(double A, double P, int N, int &iterations)
+{
+  iterations = 0;
+
+  if(!(A > 0.0) || !(P > 0.0) || N <= 0)
+  {
+    return NAN;
+  }
+
+  // One payment, A*(1+i) = P
+  if(N == 1)
+  {
+    return P/A - 1.0;
+  }
+
+  // f(0) = P*N - A, which gives the sign of the rate
+  double lo, hi;
+  double f0 = P*N - A;
+  if(f0 == 0.0)
+  {
+    return 0.0;
+  }
+  else if(f0 > 0.0)
+  {
+    // a(i) < 1/i, so f(P/A) < 0
+    lo = 0.0;
+    hi = P/A;
+  }
+  else
+  {
+    lo = RATE_LOWER_BOUND;
+    hi = 0.0;
+  }
+
+  double rate = loanInterestRateFormula(A, P, N);
+  if(!(rate > lo && rate < hi))
+  {
+    rate = 0.5*(lo + hi);
+  }
+
+  while(iterations < MAX_ITERATIONS)
+  {
+    ++iterations;
+
+    double a, da, d2a;
+    annuityFactor(rate, N, a, da, d2a);
+    double f   = P*a - A;
+    double df  = P*da;
+    double d2f = P*d2a;
+
+    // f can not be calculated more exactly than the rounding of P*a - A
+    if(fabs(f) <= 4*DBL_EPSILON*A)
+    {
+      break;
+    }
+
+    // f is decreasing, so the root is above rate when f > 0
+    if(f > 0.0)
+    {
+      lo = rate;
+    }
+    else
+    {
+      hi = rate;
+    }
+
+    // Halley step, Newton if the Halley denominator vanishes
+    double denominator = 2*df*df - f*d2f;
+    double step = (denominator != 0.0 ? -2*f*df/denominator : -f/df);
+    double next = rate + step;
+
+    // Bisect if the step leaves the bracket
+    if(!(next > lo && next < hi))
+    {
+      next = 0.5*(lo + hi);
+    }
+
+    bool converged = (fabs(next - rate) <= 4*DBL_EPSILON*fabs(next)) || (next == lo || next == hi);
+    rate = next;
+
+    if(converged)
+    {
+      break;
+    }
+  }
+
+  return rate;
+}
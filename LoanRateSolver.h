@@ -0,0 +1,87 @@
+#ifndef LOANRATESOLVER_H_INCLUDED
+#define LOANRATESOLVER_H_INCLUDED
+
+/*
+Exact interest rate solver, used by LoanCalculator::calculateInterestRate()
+and LoanBatch instead of the approximate closed form.
+
+Solves for the periodic rate i:
+  f(i) = P*(1 - (1+i)^-N)/i - A = 0
+
+f is strictly decreasing in i, so the root is bracketed, starting with
+[0, P/A] for positive rates, and the bracket is narrowed on every step.
+The solver is seeded with the approximate closed form:
+  i = (((1 + P/A)^(1/q) - 1 )^q - 1)
+  where q = log(1+1/N) / log(2)
+and then takes Halley steps, falling back to bisection whenever a step
+would leave the bracket. Halley converges cubically, so from the seed
+most loans converge to full double precision in 2 or 3 iterations, and
+never take more than MAX_ITERATIONS.
+
+The number of iterations of each call is counted, so the convergence
+can be checked with getIterationCount().
+*/
+
+#include <cstddef>
+
+class LoanRateSolver
+{
+public:
+  static const int MAX_ITERATIONS = 64;
+
+  LoanRateSolver();
+  ~LoanRateSolver() {}
+
+  /**
+   * The periodic interest rate i at which N payments of P pay off
+   * the loan amount A. Returns NaN if there is no such rate, that is
+   * if A, P or N are not positive
+   */
+  double solve(double A, double P, int N);
+
+  /**
+   * Batched version, the arrays must have count elements.
+   * rate is the periodic interest rate, and iterations, which may be NULL,
+   * is set to the number of iterations needed for each loan
+   */
+  void solve(size_t count,
+             const float *A,
+             const float *P,
+             const int *N,
+             float *rate,
+             int *iterations);
+
+  /**
+   * As solve(), without counting the iterations, so it can be called from
+   * any thread, see LoanTerms.h
+   */
+  static double solveRate(double A, double P, int N, int &iterations);
+
+  //
+  // Iteration counters
+  //
+
+  // Iterations needed by the last call to solve()
+  inline int getLastIterations() const { return lastIterations_; }
+
+  // Total number of calls to solve(), per loan for the batched version
+  inline unsigned long getSolveCount() const { return solveCount_; }
+
+  // Number of calls to solve() that needed exactly iterations iterations
+  inline unsigned long getIterationCount(int iterations) const
+    { return (iterations < 0 || iterations > MAX_ITERATIONS) ? 0 : iterationCount_[iterations]; }
+
+  // Average number of iterations per call to solve()
+  double getAverageIterations() const;
+
+  void resetCounters();
+
+private:
+  void countIterations(int iterations);
+
+  int lastIterations_;
+  unsigned long solveCount_;
+  unsigned long iterationCount_[MAX_ITERATIONS+1];
+};
+
+#endif // LOANRATESOLVER_H_INCLUDED
@@ -0,0 +1,143 @@
+
+#include <math.h>
+#include <string.h>
+
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+
+#include "LoanFormulas.h"
+#include "LoanRateTable.h"
+
+using namespace std;
+
+static const char MAGIC[8] = {'L', 'O', 'A', 'N', 'R', 'A', 'T', 'E'};
+
+const double LoanRateTable::DEFAULT_MIN_RATE = 0.125;
+const double LoanRateTable::DEFAULT_MAX_RATE = 30.0;
+const double LoanRateTable::DEFAULT_RATE_STEP = 0.125;
+
+LoanRateTable::LoanRateTable() :
+  inverseStep_(0.0),
+  buildSeconds_(0.0),
+  annuity_(NULL),
+  presentValue_(NULL),
+  growth_(NULL),
+  accumulation_(NULL)
+{
+  memset(&header_, 0, sizeof(header_));
+}
+
+LoanRateTable::~LoanRateTable()
+{
+}
+
+void LoanRateTable::setFactors(const double *factors)
+{
+  size_t count = numFactors();
+  annuity_ = factors;
+  presentValue_ = factors + count;
+  growth_ = factors + 2*count;
+  accumulation_ = factors + 3*count;
+  inverseStep_ = 1.0/header_.rateStep;
+}
+
+void LoanRateTable::build(double minRate, double maxRate, double rateStep, int maxTerm)
+{
+  if(!(minRate >= 0.0) || !(rateStep > 0.0) || maxRate < minRate || maxTerm < 1)
+  {
+    throw invalid_argument("Invalid rate table grid");
+  }
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+  file_.close();
+  memcpy(header_.magic, MAGIC, sizeof(header_.magic));
+  header_.version = LoanRateTableHeader::VERSION;
+  header_.byteOrderMark = LoanRateTableHeader::BYTE_ORDER_MARK;
+  header_.minRate = minRate;
+  header_.rateStep = rateStep;
+  header_.numRates = (uint32_t) floor((maxRate - minRate)/rateStep + 1e-6) + 1;
+  header_.maxTerm = maxTerm;
+
+  size_t count = numFactors();
+  factors_.assign(4*count, 0.0);
+  double *annuity = &factors_[0];
+  double *presentValue = annuity + count;
+  double *growth = annuity + 2*count;
+  double *accumulation = annuity + 3*count;
+
+  for(uint32_t rate = 0; rate < header_.numRates; ++rate)
+  {
+    // As the calculator calculates its periodic interest
+    double i = (minRate + rate*rateStep)/100.0/12.0;
+    size_t row = (size_t) rate*(maxTerm + 1);
+
+    // With the formulas of the calculator, factored for an amount of 1,
+    // so a 0% rate has the factors of its limits
+    for(int term = 0; term <= maxTerm; ++term)
+    {
+      double g = loanGrowthFactor(i, term);
+      double discount = loanGrowthFactor(i, -term);
+
+      growth[row + term] = g;
+      accumulation[row + term] = loanAccumulationFactor(i, term, g);
+      annuity[row + term] = (term > 0 ? loanPayment(1.0, i, term, discount) : 0.0);
+      presentValue[row + term] = loanAmount(1.0, i, term, discount);
+    }
+  }
+
+  setFactors(&factors_[0]);
+  buildSeconds_ = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void LoanRateTable::load(const string &fileName)
+{
+  file_.open(fileName);
+  const char *data = file_.getData();
+  size_t size = file_.getSize();
+
+  LoanRateTableHeader header;
+  if(data == NULL || size < sizeof(header) || memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+  {
+    file_.close();
+    throw runtime_error("Not a loan rate table: " + fileName);
+  }
+
+  memcpy(&header, data, sizeof(header));
+  if(header.byteOrderMark != LoanRateTableHeader::BYTE_ORDER_MARK ||
+     header.version != LoanRateTableHeader::VERSION ||
+     !(header.rateStep > 0.0) ||
+     size != sizeof(header) + 4*(size_t) header.numRates*(header.maxTerm + 1)*sizeof(double))
+  {
+    file_.close();
+    throw runtime_error("Unsupported loan rate table: " + fileName);
+  }
+
+  factors_.clear();
+  header_ = header;
+  setFactors((const double *) (data + sizeof(header)));
+  buildSeconds_ = 0.0;
+}
+
+void LoanRateTable::save(const string &fileName) const
+{
+  if(annuity_ == NULL)
+  {
+    throw runtime_error("The rate table is empty");
+  }
+
+  ofstream os(fileName.c_str(), ios::binary);
+  if(!os)
+  {
+    throw runtime_error("Cant create " + fileName);
+  }
+
+  // The factors are contiguous, as built or mapped
+  os.write((const char *) &header_, sizeof(header_));
+  os.write((const char *) annuity_, getMemoryBytes());
+  if(!os.flush())
+  {
+    throw runtime_error("Error writing " + fileName);
+  }
+}
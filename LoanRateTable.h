@@ -0,0 +1,165 @@
+#ifndef LOANRATETABLE_H_INCLUDED
+#define LOANRATETABLE_H_INCLUDED
+
+/*
+Precomputed factors of a grid of yearly rates and terms, so that the
+payment, the loan amount and the balance of a loan on the grid are a
+lookup and a multiply instead of a pow(), see LoanCalculator::setRateTable().
+
+Rates are quoted on a fixed grid, as in 0.125% steps, and terms are whole
+months, so for each rate r of the grid, with i = r/100/12, and each term t:
+
+  annuity       i / (1 - (1+i)^-t)     P = A*annuity
+  presentValue  (1 - (1+i)^-t) / i     A = P*presentValue
+  growth        (1+i)^t                B_n = A*growth - P*accumulation
+  accumulation  ((1+i)^t - 1) / i
+
+Rates off the grid, or terms above the maximum term, are not found and
+the calculator uses the exact formulas. The factors are calculated in
+double, so the results agree with the formulas to within rounding.
+
+The table is either built, or mapped from a file written by save(),
+which is used in place:
+
+  LoanRateTableHeader  magic "LOANRATE", version, byte order mark,
+                       the grid
+  factors              annuity, presentValue, growth and accumulation,
+                       each numRates*(maxTerm+1) doubles, by rate then term
+*/
+
+#include <math.h>
+#include <stdint.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "LoanMappedFile.h"
+
+struct LoanRateTableHeader
+{
+  static const uint32_t VERSION = 1;
+  static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+  char magic[8];           // "LOANRATE", not terminated
+  uint32_t version;
+  uint32_t byteOrderMark;
+  double minRate;          // yearly, as in 6.75
+  double rateStep;
+  uint32_t numRates;
+  uint32_t maxTerm;
+};
+
+class LoanRateTable
+{
+public:
+  // The standard grid: 0.125% to 30% in 0.125% steps, terms up to 40 years
+  static const double DEFAULT_MIN_RATE;
+  static const double DEFAULT_MAX_RATE;
+  static const double DEFAULT_RATE_STEP;
+  static const int DEFAULT_MAX_TERM = 480;
+
+  LoanRateTable();
+  ~LoanRateTable();
+
+  /**
+   * Calculate the factors of the rates minRate to maxRate in rateStep
+   * steps, and the terms up to maxTerm months, minRate may be 0 for 0%
+   * loans. Throws invalid_argument if the grid is empty or minRate is
+   * negative
+   */
+  void build(double minRate = DEFAULT_MIN_RATE,
+             double maxRate = DEFAULT_MAX_RATE,
+             double rateStep = DEFAULT_RATE_STEP,
+             int maxTerm = DEFAULT_MAX_TERM);
+
+  /**
+   * Map a table written by save(), throws runtime_error if it cant
+   */
+  void load(const std::string &fileName);
+
+  /**
+   * Write the table, throws runtime_error if it cant
+   */
+  void save(const std::string &fileName) const;
+
+  //
+  // The factors of a yearly rate, as in 6.75, and a term in months,
+  // false if they are not on the grid
+  //
+
+  inline bool getAnnuity(double yearlyRate, int term, double &annuity) const
+  {
+    size_t index;
+    if(term < 1 || !findIndex(yearlyRate, term, index)) { return false; }
+    annuity = annuity_[index];
+    return true;
+  }
+
+  inline bool getPresentValue(double yearlyRate, int term, double &presentValue) const
+  {
+    size_t index;
+    if(term < 1 || !findIndex(yearlyRate, term, index)) { return false; }
+    presentValue = presentValue_[index];
+    return true;
+  }
+
+  inline bool getGrowth(double yearlyRate, int term, double &growth, double &accumulation) const
+  {
+    size_t index;
+    if(!findIndex(yearlyRate, term, index)) { return false; }
+    growth = growth_[index];
+    accumulation = accumulation_[index];
+    return true;
+  }
+
+  inline double getMinRate() const    { return header_.minRate; }
+  inline double getRateStep() const   { return header_.rateStep; }
+  inline int getNumRates() const      { return header_.numRates; }
+  inline int getMaxTerm() const       { return header_.maxTerm; }
+
+  // The memory of the factors, and the time the last build() took
+  inline size_t getMemoryBytes() const { return 4*numFactors()*sizeof(double); }
+  inline double getBuildSeconds() const { return buildSeconds_; }
+
+private:
+  LoanRateTable(const LoanRateTable &);
+  LoanRateTable &operator=(const LoanRateTable &);
+
+  inline size_t numFactors() const { return (size_t) header_.numRates*(header_.maxTerm + 1); }
+
+  inline bool findIndex(double yearlyRate, int term, size_t &index) const
+  {
+    if(term < 0 || term > (int) header_.maxTerm)
+    {
+      return false;
+    }
+
+    // On the grid to within rounding of the rate
+    double position = (yearlyRate - header_.minRate)*inverseStep_;
+    double row = floor(position + 0.5);
+    if(row < 0.0 || row >= header_.numRates || fabs(position - row) > 1e-6)
+    {
+      return false;
+    }
+
+    index = (size_t) row*(header_.maxTerm + 1) + term;
+    return true;
+  }
+
+  void setFactors(const double *factors);
+
+  LoanRateTableHeader header_;
+  double inverseStep_;
+  double buildSeconds_;
+
+  const double *annuity_;
+  const double *presentValue_;
+  const double *growth_;
+  const double *accumulation_;
+
+  std::vector<double> factors_; // when built
+  LoanMappedFile file_;         // when loaded
+};
+
+#endif // LOANRATETABLE_H_INCLUDED
@@ -0,0 +1,88 @@
+#ifndef LOANRECORD_H_INCLUDED
+#define LOANRECORD_H_INCLUDED
+
+/*
+A loan as a flat record of numbers, as read by the bulk mode and
+received by the server mode, and the calculation of one record.
+
+The fields, missing fields are 0.0 as on the command line:
+  0 amount          Total loan amount A
+  1 interest        Yearly interest rate as in 6.75
+  2 periodTotal     Total payment periods N
+  3 payment         Payment P
+  4 periodElapsed   Elapsed payment periods n
+  5 initialPayment
+  6 openingFee
+  7 openingPercent
+
+The results, in the order of LoanBulk::getResultColumns():
+  CALC_PAYMENT      payment, total paid
+  CALC_BALANCE      balance
+  CALC_NUMPAYMENTS  number of payments
+  CALC_AMOUNT       loan amount
+  CALC_INTEREST     yearly interest rate
+*/
+
+#include <stdexcept>
+
+#include "LoanCalcType.h"
+
+static const int LOAN_RECORD_FIELDS = 8;
+static const int LOAN_RECORD_MAX_RESULTS = 2;
+
+/**
+ * Calculate one record with calculator, which is reset first.
+ * Returns the number of results, throws invalid_argument if the
+ * inputs are invalid or calcType cant be calculated from a record
+ */
+template <class Calculator>
+inline int calculateLoanRecord(CALC_TYPE calcType,
+                               Calculator &calculator,
+                               const double values[LOAN_RECORD_FIELDS],
+                               double results[LOAN_RECORD_MAX_RESULTS])
+{
+  typedef typename Calculator::NumericPolicy Policy;
+  typedef typename Calculator::Money Money;
+
+  calculator.reset();
+  calculator.setAmount(Policy::fromDouble(values[0]));
+  calculator.setInterest(values[1]);
+  calculator.setPeriodTotal((int) values[2]);
+  calculator.setPayment(Policy::fromDouble(values[3]));
+  calculator.setPeriodElapsed((int) values[4]);
+  calculator.setInitialPayment(Policy::fromDouble(values[5]));
+  calculator.setOpeningFee(Policy::fromDouble(values[6]));
+  calculator.setOpeningPercent(values[7]);
+
+  if(calcType == CALC_BALANCE)
+  {
+    results[0] = Policy::toDouble(calculator.calculateLoanBalance());
+    return 1;
+  }
+  else if(calcType == CALC_PAYMENT)
+  {
+    Money payment = calculator.calculatePayment();
+    results[0] = Policy::toDouble(payment);
+    results[1] = Policy::toDouble(payment*calculator.getPeriodTotal());
+    return 2;
+  }
+  else if(calcType == CALC_NUMPAYMENTS)
+  {
+    results[0] = calculator.calculateNumberPayments();
+    return 1;
+  }
+  else if(calcType == CALC_AMOUNT)
+  {
+    results[0] = Policy::toDouble(calculator.calculateLoanAmount());
+    return 1;
+  }
+  else if(calcType == CALC_INTEREST)
+  {
+    results[0] = calculator.calculateInterestRate();
+    return 1;
+  }
+
+  throw std::invalid_argument("Unsupported calculation type for a loan record");
+}
+
+#endif // LOANRECORD_H_INCLUDED
@@ -0,0 +1,169 @@
+#ifndef LOANREQUESTQUEUE_H_INCLUDED
+#define LOANREQUESTQUEUE_H_INCLUDED
+
+/*
+Bounded lock-free queue of many producers and many consumers, a ring of
+cells each with a sequence number, after Dmitry Vyukov's bounded MPMC
+queue. A producer claims the cell at the tail with a compare and swap of
+the tail, writes its item, and publishes it by setting the sequence of the
+cell, a consumer does the same at the head. A cell is free to be written
+when its sequence is its position, and full when it is its position + 1,
+so producers and consumers only share the cells they hand over, and the
+head and the tail, each on its own cache line.
+
+No thread ever waits for another while it holds anything, but a push or a
+pop can see the queue full or empty while a thread between claiming a
+cell and publishing it is preempted, so they only fail, they dont block.
+LoanWorkerPool makes the consumers wait when the queue is empty.
+
+T is copied in and out of the cells, a small struct.
+*/
+
+#include <atomic>
+#include <cstddef>
+
+template <class T>
+class LoanRequestQueue
+{
+public:
+  /**
+   * capacity is rounded up to a power of 2, at least 2
+   */
+  explicit LoanRequestQueue(size_t capacity) :
+    mask_(roundCapacity(capacity) - 1),
+    cells_(new Cell[mask_ + 1])
+  {
+    for(size_t position = 0; position <= mask_; ++position)
+    {
+      cells_[position].sequence.store(position, std::memory_order_relaxed);
+    }
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+  }
+
+  ~LoanRequestQueue() { delete [] cells_; }
+
+  inline size_t getCapacity() const { return mask_ + 1; }
+
+  /**
+   * The number of items, only exact while no thread pushes or pops
+   */
+  inline size_t getSize() const
+  {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    return (tail > head ? tail - head : 0);
+  }
+
+  /**
+   * Add item, returns false if the queue is full
+   */
+  bool tryPush(const T &item)
+  {
+    size_t position = tail_.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      Cell &cell = cells_[position & mask_];
+      // As a signed difference, so the positions can wrap around
+      ptrdiff_t difference = (ptrdiff_t) (cell.sequence.load(std::memory_order_acquire) - position);
+      if(difference == 0)
+      {
+        // Free, claim it, else another producer did and position is reloaded
+        if(tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          cell.item = item;
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if(difference < 0)
+      {
+        // Still full from the previous lap
+        return false;
+      }
+      else
+      {
+        position = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Take the oldest item, returns false if the queue is empty
+   */
+  bool tryPop(T &item)
+  {
+    size_t position = head_.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      Cell &cell = cells_[position & mask_];
+      ptrdiff_t difference = (ptrdiff_t) (cell.sequence.load(std::memory_order_acquire) - (position + 1));
+      if(difference == 0)
+      {
+        if(head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          item = cell.item;
+          // Free for the next lap
+          cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if(difference < 0)
+      {
+        return false;
+      }
+      else
+      {
+        position = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Take up to maxItems items, in order, as long as the queue isnt empty,
+   * returns how many
+   */
+  size_t popBatch(T *items, size_t maxItems)
+  {
+    size_t count = 0;
+    while(count < maxItems && tryPop(items[count]))
+    {
+      ++count;
+    }
+    return count;
+  }
+
+private:
+  LoanRequestQueue(); // Cant initialize default version
+  LoanRequestQueue(const LoanRequestQueue &);
+  LoanRequestQueue &operator=(const LoanRequestQueue &);
+
+  static const size_t CACHE_LINE = 64;
+
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  static size_t roundCapacity(size_t capacity)
+  {
+    size_t rounded = 2;
+    while(rounded < capacity)
+    {
+      rounded *= 2;
+    }
+    return rounded;
+  }
+
+  const size_t mask_;
+  Cell *cells_;
+
+  char padHead_[CACHE_LINE];
+  std::atomic<size_t> head_;
+  char padTail_[CACHE_LINE - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> tail_;
+  char padEnd_[CACHE_LINE - sizeof(std::atomic<size_t>)];
+};
+
+#endif // LOANREQUESTQUEUE_H_INCLUDED
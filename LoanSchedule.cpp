@@ -0,0 +1,136 @@
+
+#include <math.h>
+#include <stdio.h>
+
+#include <iostream>
+
+#include "LoanRateSchedule.h"
+#include "LoanSchedule.h"
+
+using namespace std;
+
+LoanSchedule::LoanSchedule(double amount, double interest, int periodTotal, double payment, int periodsPerYear) :
+  amount_(amount),
+  interest_(interest),
+  periodTotal_(periodTotal),
+  initialPayment_(payment),
+  periodsPerYear_(periodsPerYear),
+  roundToCents_(false),
+  rateSchedule_(NULL)
+{
+  rewind();
+}
+
+void LoanSchedule::rewind()
+{
+  period_ = 0;
+  reset_ = 0;
+  rate_ = interest_;
+  interestPeriodic_ = interest_/100.0/periodsPerYear_;
+  payment_ = initialPayment_;
+  balance_ = amount_;
+  totalInterest_ = 0.0;
+  totalPrincipal_ = 0.0;
+}
+
+size_t LoanSchedule::generate(LoanScheduleRow *rows, size_t capacity)
+{
+  size_t count = 0;
+
+  for(; count < capacity && period_ < periodTotal_; ++count)
+  {
+    // The resets of this period, recasting the payment if the rate changes
+    for(; rateSchedule_ != NULL && reset_ < rateSchedule_->getNumResets() &&
+          rateSchedule_->getResetPeriod(reset_) <= period_ + 1; ++reset_)
+    {
+      double rate = rateSchedule_->getResetRate(reset_, interest_, rate_);
+      if(rate != rate_)
+      {
+        rate_ = rate;
+        interestPeriodic_ = rate/100.0/periodsPerYear_;
+        payment_ = LoanRateSchedule::recastPayment(balance_, interestPeriodic_, periodTotal_ - period_);
+      }
+    }
+
+    double interest = balance_*interestPeriodic_;
+    if(roundToCents_)
+    {
+      interest = nearbyint(interest*100.0)/100.0;
+    }
+
+    ++period_;
+    double payment = (period_ == periodTotal_ ? balance_ + interest : payment_);
+    double principal = payment - interest;
+
+    balance_ = (period_ == periodTotal_ ? 0.0 : balance_ - principal);
+    totalInterest_ += interest;
+    totalPrincipal_ += principal;
+
+    LoanScheduleRow &row = rows[count];
+    row.period = period_;
+    row.payment = payment;
+    row.interest = interest;
+    row.principal = principal;
+    row.balance = balance_;
+    row.totalInterest = totalInterest_;
+    row.totalPrincipal = totalPrincipal_;
+  }
+
+  return count;
+}
+
+void LoanSchedule::generate(LoanScheduleSink &sink)
+{
+  static const size_t BLOCK_SIZE = 64;
+  LoanScheduleRow rows[BLOCK_SIZE];
+
+  size_t count;
+  while((count = generate(rows, BLOCK_SIZE)) > 0)
+  {
+    sink.writeRows(rows, count);
+  }
+}
+
+size_t LoanSchedule::generate(LoanArena &arena, LoanScheduleRow *&rows)
+{
+  size_t count = (period_ < periodTotal_ ? periodTotal_ - period_ : 0);
+  rows = arena.allocateArray<LoanScheduleRow>(count);
+
+  return generate(rows, count);
+}
+
+//
+// LoanScheduleTextSink
+//
+
+void LoanScheduleTextSink::writeHeader()
+{
+  os_ << "Period      Payment     Interest    Principal        Balance   Total Interest\n";
+}
+
+void LoanScheduleTextSink::writeRows(const LoanScheduleRow *rows, size_t count)
+{
+  size_t length = 0;
+
+  for(size_t k = 0; k < count; ++k)
+  {
+    // Flush the buffer when a row might not fit
+    if(sizeof(buffer_) - length < 128)
+    {
+      os_.write(buffer_, length);
+      length = 0;
+    }
+
+    const LoanScheduleRow &row = rows[k];
+    int written = snprintf(buffer_ + length, sizeof(buffer_) - length,
+                           "%6d %12.2f %12.2f %12.2f %14.2f %16.2f\n",
+                           row.period, row.payment, row.interest, row.principal,
+                           row.balance, row.totalInterest);
+    if(written > 0)
+    {
+      length += ((size_t) written < sizeof(buffer_) - length ? written : sizeof(buffer_) - length - 1);
+    }
+  }
+
+  os_.write(buffer_, length);
+}
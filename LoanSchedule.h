@@ -0,0 +1,143 @@
+#ifndef LOANSCHEDULE_H_INCLUDED
+#define LOANSCHEDULE_H_INCLUDED
+
+/*
+Amortization schedule, the month by month interest, principal and balance
+of a loan.
+
+Each row is calculated from the balance of the previous row:
+  interest  = B_(n-1) * i
+  principal = P - interest
+  B_n       = B_(n-1) - principal
+so a schedule of N periods costs about N multiply-adds, and no pow() calls.
+The last payment is adjusted to pay off whatever balance remains. With a
+LoanRateSchedule, the rate changes at its resets and the payment is recast
+to pay off the balance over the remaining periods.
+
+The rows are written to a buffer supplied by the caller, to a LoanArena,
+or streamed to a LoanScheduleSink through a fixed size buffer, so
+generating a schedule never allocates heap memory.
+*/
+
+#include <cstddef>
+#include <iosfwd>
+
+#include "LoanArena.h"
+
+class LoanRateSchedule;
+
+struct LoanScheduleRow
+{
+  int period;             // 1 to N
+  double payment;
+  double interest;
+  double principal;
+  double balance;         // balance after this payment
+  double totalInterest;   // cumulative interest paid, including this payment
+  double totalPrincipal;  // cumulative principal paid, including this payment
+};
+
+/**
+ * Receives the schedule rows, in blocks of consecutive rows
+ */
+class LoanScheduleSink
+{
+public:
+  virtual ~LoanScheduleSink() {}
+  virtual void writeRows(const LoanScheduleRow *rows, size_t count) = 0;
+};
+
+/**
+ * Writes the schedule rows as text, one row per line, formatting
+ * the rows into a fixed buffer instead of through the stream operators
+ */
+class LoanScheduleTextSink : public LoanScheduleSink
+{
+public:
+  LoanScheduleTextSink(std::ostream &os) : os_(os) {}
+  virtual ~LoanScheduleTextSink() {}
+
+  void writeHeader();
+  virtual void writeRows(const LoanScheduleRow *rows, size_t count);
+
+private:
+  LoanScheduleTextSink(); // Cant initialize default version
+
+  std::ostream &os_;
+  char buffer_[8192];
+};
+
+class LoanSchedule
+{
+public:
+  /**
+   * amount         the financed amount A
+   * interest       yearly interest rate, as in 6.75
+   * periodTotal    the total number of payments N
+   * payment        the payment P, as calculated by LoanCalculator::calculatePayment()
+   * periodsPerYear the number of payments a year, 12 for monthly payments
+   */
+  LoanSchedule(double amount, double interest, int periodTotal, double payment, int periodsPerYear = 12);
+  ~LoanSchedule() {}
+
+  /**
+   * If set, the interest of each row is rounded to the cent,
+   * as a ledger would, default false
+   */
+  inline void setRoundToCents(bool roundToCents) { roundToCents_ = roundToCents; }
+  inline bool getRoundToCents() const            { return roundToCents_; }
+
+  /**
+   * Adjust the rate at the resets of schedule, NULL by default, see
+   * LoanRateSchedule.h. The schedule isnt copied. Set before generating
+   */
+  inline void setRateSchedule(const LoanRateSchedule *schedule) { rateSchedule_ = schedule; rewind(); }
+
+  /**
+   * Write the next rows of the schedule to rows, at most capacity rows.
+   * Returns the number of rows written, 0 once the schedule is complete.
+   * Successive calls continue where the previous call stopped
+   */
+  size_t generate(LoanScheduleRow *rows, size_t capacity);
+
+  /**
+   * Write the rest of the schedule to sink
+   */
+  void generate(LoanScheduleSink &sink);
+
+  /**
+   * Write the rest of the schedule to rows allocated in arena.
+   * Returns the number of rows
+   */
+  size_t generate(LoanArena &arena, LoanScheduleRow *&rows);
+
+  // Start the schedule again from the first period
+  void rewind();
+
+  inline bool isComplete() const     { return period_ >= periodTotal_; }
+  inline int getPeriodTotal() const  { return periodTotal_; }
+
+private:
+  LoanSchedule(); // Cant initialize default version
+
+  double amount_;
+  double interest_;
+  int periodTotal_;
+  double initialPayment_;
+  int periodsPerYear_;
+  bool roundToCents_;
+  const LoanRateSchedule *rateSchedule_;
+
+  // The state after the last row generated, the rate and the payment
+  // those of the last reset
+  int period_;
+  size_t reset_;
+  double rate_;
+  double interestPeriodic_;
+  double payment_;
+  double balance_;
+  double totalInterest_;
+  double totalPrincipal_;
+};
+
+#endif // LOANSCHEDULE_H_INCLUDED
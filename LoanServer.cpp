@@ -0,0 +1,627 @@
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <exception>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include "LoanArena.h"
+#include "LoanCalculator.h"
+#include "LoanQuoteCache.h"
+#include "LoanServer.h"
+
+using namespace std;
+
+// Larger frames are a protocol error, and close the connection
+static const uint32_t MAX_FRAME_LENGTH = 4096;
+static const size_t READ_BUFFER_SIZE = 65536;
+// Past this many bytes of responses not sent yet, a connection stops taking
+// requests until its client reads them
+static const size_t MAX_PENDING_OUTPUT = 262144;
+static const int MAX_EVENTS = 64;
+
+struct LoanServer::Connection
+{
+  int fd;
+  std::vector<char> in;
+  size_t inLength;
+  std::vector<char> out;
+  size_t outOffset;
+  uint32_t events;   // the epoll events armed
+  bool readClosed;   // the client sent EOF, closed once out is sent
+
+  inline bool isBackedUp() const { return out.size() - outOffset > MAX_PENDING_OUTPUT; }
+};
+
+struct LoanServer::Calculators
+{
+  LoanCalculator floatCalculator;
+  LoanCalculatorDouble doubleCalculator;
+  LoanCalculatorCents centsCalculator;
+
+  // The scratch of one request
+  LoanArena arena;
+  size_t arenaMallocs;   // counted in numMallocs_
+};
+
+//
+// Addresses
+//
+
+// Fill in the socket address of address, returns its length
+static socklen_t parseAddress(const string &address, sockaddr_storage &storage, bool &tcp)
+{
+  memset(&storage, 0, sizeof(storage));
+
+  if(!address.empty() && address[0] == ':')
+  {
+    char *end;
+    long port = strtol(address.c_str() + 1, &end, 10);
+    if(*end != '\0' || port <= 0 || port > 65535)
+    {
+      throw runtime_error("Invalid server port: " + address);
+    }
+
+    // Only the loopback interface, the server has no authentication
+    sockaddr_in *in = (sockaddr_in *) &storage;
+    in->sin_family = AF_INET;
+    in->sin_port = htons((uint16_t) port);
+    in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    tcp = true;
+    return sizeof(sockaddr_in);
+  }
+
+  sockaddr_un *un = (sockaddr_un *) &storage;
+  if(address.empty() || address.size() >= sizeof(un->sun_path))
+  {
+    throw runtime_error("Invalid server socket path: " + address);
+  }
+  un->sun_family = AF_UNIX;
+  memcpy(un->sun_path, address.c_str(), address.size() + 1);
+  tcp = false;
+  return sizeof(sockaddr_un);
+}
+
+static void setNoDelay(int fd)
+{
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+//
+// LoanServer
+//
+
+LoanServer::LoanServer(int numThreads) :
+  numThreads_(numThreads > 0 ? numThreads : (int) (thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1)),
+  listenFd_(-1),
+  stopFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+  tcp_(false),
+  cache_(NULL),
+  rateTable_(NULL),
+  numMallocs_(0)
+{
+  if(stopFd_ < 0)
+  {
+    throw runtime_error(string("Cant create the server stop event: ") + strerror(errno));
+  }
+}
+
+LoanServer::~LoanServer()
+{
+  if(listenFd_ >= 0)
+  {
+    ::close(listenFd_);
+    if(!unixPath_.empty())
+    {
+      unlink(unixPath_.c_str());
+    }
+  }
+
+  ::close(stopFd_);
+}
+
+void LoanServer::listen(const string &address)
+{
+  sockaddr_storage storage;
+  socklen_t length = parseAddress(address, storage, tcp_);
+
+  listenFd_ = socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if(listenFd_ < 0)
+  {
+    throw runtime_error(string("Cant create the server socket: ") + strerror(errno));
+  }
+
+  if(tcp_)
+  {
+    int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  }
+  else
+  {
+    // A socket left by a previous server
+    unlink(address.c_str());
+    unixPath_ = address;
+  }
+
+  if(bind(listenFd_, (sockaddr *) &storage, length) != 0 ||
+     ::listen(listenFd_, SOMAXCONN) != 0)
+  {
+    int error = errno;
+    ::close(listenFd_);
+    listenFd_ = -1;
+    throw runtime_error("Cant listen on " + address + ": " + strerror(error));
+  }
+}
+
+void LoanServer::stop()
+{
+  // Never read, so it wakes up every thread
+  uint64_t one = 1;
+  ssize_t written = write(stopFd_, &one, sizeof(one));
+  (void) written;
+}
+
+void LoanServer::run()
+{
+  if(listenFd_ < 0)
+  {
+    throw runtime_error("The server is not listening");
+  }
+
+  // The calling thread is one of the server threads
+  vector<thread> threads;
+  for(int t = 1; t < numThreads_; ++t)
+  {
+    threads.push_back(thread(&LoanServer::serverLoop, this));
+  }
+
+  serverLoop();
+
+  for(size_t t = 0; t < threads.size(); ++t)
+  {
+    threads[t].join();
+  }
+}
+
+void LoanServer::serverLoop()
+{
+  int epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if(epollFd < 0)
+  {
+    return;
+  }
+
+  // The listening socket and the stop event are told apart by their address
+  epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN | EPOLLEXCLUSIVE;
+  event.data.ptr = &listenFd_;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd_, &event);
+
+  event.events = EPOLLIN;
+  event.data.ptr = &stopFd_;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd_, &event);
+
+  Calculators calculators;
+  calculators.floatCalculator.setRateTable(rateTable_);
+  calculators.doubleCalculator.setRateTable(rateTable_);
+  calculators.centsCalculator.setRateTable(rateTable_);
+  calculators.arenaMallocs = 0;
+  set<Connection *> connections;
+  epoll_event events[MAX_EVENTS];
+  bool running = true;
+
+  while(running)
+  {
+    int count = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+    if(count < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      break;
+    }
+
+    for(int e = 0; e < count; ++e)
+    {
+      if(events[e].data.ptr == &stopFd_)
+      {
+        running = false;
+      }
+      else if(events[e].data.ptr == &listenFd_)
+      {
+        int fd;
+        while((fd = accept4(listenFd_, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+        {
+          if(tcp_)
+          {
+            setNoDelay(fd);
+          }
+
+          Connection *connection = new Connection;
+          connection->fd = fd;
+          connection->in.resize(READ_BUFFER_SIZE);
+          connection->inLength = 0;
+          connection->outOffset = 0;
+          connection->events = EPOLLIN | EPOLLRDHUP;
+          connection->readClosed = false;
+
+          event.events = connection->events;
+          event.data.ptr = connection;
+          if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+          {
+            ::close(fd);
+            delete connection;
+            continue;
+          }
+          connections.insert(connection);
+        }
+      }
+      else
+      {
+        Connection *connection = (Connection *) events[e].data.ptr;
+        bool open = !(events[e].events & EPOLLERR);
+        bool readable = (events[e].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) != 0;
+
+        while(open)
+        {
+          bool backedUp = !(connection->events & EPOLLIN);
+          if(readable && !connection->readClosed)
+          {
+            open = readRequests(*connection, calculators);
+          }
+          if(open)
+          {
+            open = writeResponses(*connection, epollFd);
+          }
+
+          // Once the backed up responses are sent, the requests left in the
+          // buffer, they may be all there is and never raise EPOLLIN
+          readable = (backedUp && (connection->events & EPOLLIN));
+          if(!readable)
+          {
+            break;
+          }
+        }
+
+        if(!open)
+        {
+          // Closing the socket removes it from the epoll set
+          ::close(connection->fd);
+          connections.erase(connection);
+          delete connection;
+        }
+      }
+    }
+  }
+
+  for(set<Connection *>::iterator iter = connections.begin(); iter != connections.end(); ++iter)
+  {
+    ::close((*iter)->fd);
+    delete *iter;
+  }
+  ::close(epollFd);
+}
+
+//
+// Read all of the available requests and calculate the complete ones,
+// returns false if the connection has to be closed. On EOF the requests
+// received are all calculated and the connection stays open, see
+// writeResponses(), until their responses are sent
+//
+bool LoanServer::readRequests(Connection &connection, Calculators &calculators)
+{
+  ssize_t bytes = 1;
+
+  while(true)
+  {
+    // The complete frames. Until EOF, they stop once the responses are
+    // backed up, the rest waiting in the buffer
+    size_t offset = 0;
+    while(connection.inLength - offset >= sizeof(uint32_t) &&
+          (connection.readClosed || !connection.isBackedUp()))
+    {
+      uint32_t length;
+      memcpy(&length, &connection.in[offset], sizeof(length));
+      if(length > MAX_FRAME_LENGTH)
+      {
+        return false;
+      }
+      if(connection.inLength - offset < sizeof(length) + length)
+      {
+        break;
+      }
+
+      LoanServerRequest request;
+      memset(&request, 0, sizeof(request));
+      memcpy(&request, &connection.in[offset],
+             sizeof(length) + (length < LoanServerRequest::LENGTH ? length : LoanServerRequest::LENGTH));
+      request.length = length;
+      processRequest(request, calculators, connection.out);
+
+      offset += sizeof(length) + length;
+    }
+
+    if(offset > 0)
+    {
+      memmove(&connection.in[0], &connection.in[offset], connection.inLength - offset);
+      connection.inLength -= offset;
+    }
+
+    // Nothing more to read, or no room for it
+    if(bytes <= 0 || connection.readClosed || connection.isBackedUp())
+    {
+      break;
+    }
+
+    do
+    {
+      bytes = read(connection.fd,
+                   &connection.in[connection.inLength],
+                   connection.in.size() - connection.inLength);
+    } while(bytes < 0 && errno == EINTR);
+
+    if(bytes == 0)
+    {
+      // Answer what was received, then close
+      connection.readClosed = true;
+    }
+    else if(bytes < 0)
+    {
+      if(errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        return false;
+      }
+    }
+    else
+    {
+      connection.inLength += bytes;
+    }
+  }
+
+  return true;
+}
+
+void LoanServer::processRequest(const LoanServerRequest &request, Calculators &calculators, vector<char> &out)
+{
+  LoanServerResponse response;
+  memset(&response, 0, sizeof(response));
+  response.length = LoanServerResponse::LENGTH;
+  response.id = request.id;
+
+  LoanArena &arena = calculators.arena;
+  arena.reset();
+
+  const char *message = NULL;
+  size_t messageLength = 0;
+  try
+  {
+    CALC_TYPE calcType = (CALC_TYPE) request.calcType;
+    if(request.length < LoanServerRequest::LENGTH)
+    {
+      throw invalid_argument("Invalid request");
+    }
+    else if(request.precision == 2)
+    {
+      response.numResults = calculateLoanRecordCached(cache_, 2, calcType, calculators.centsCalculator,
+                                                      request.fields, response.results);
+    }
+    else if(request.precision == 1)
+    {
+      response.numResults = calculateLoanRecordCached(cache_, 1, calcType, calculators.doubleCalculator,
+                                                      request.fields, response.results);
+    }
+    else
+    {
+      response.numResults = calculateLoanRecordCached(cache_, 0, calcType, calculators.floatCalculator,
+                                                      request.fields, response.results);
+    }
+  }
+  catch(const exception &e)
+  {
+    // e is gone after the catch
+    messageLength = strlen(e.what());
+    message = arena.copy(e.what(), messageLength);
+  }
+
+  if(message != NULL)
+  {
+    response.status = 1;
+    response.numResults = 0;
+    response.length += messageLength;
+  }
+
+  const char *data = (const char *) &response;
+  out.insert(out.end(), data, data + sizeof(response));
+  if(messageLength > 0)
+  {
+    out.insert(out.end(), message, message + messageLength);
+  }
+
+  // Counted before the response is sent
+  if(arena.getNumMallocs() != calculators.arenaMallocs)
+  {
+    numMallocs_.fetch_add(arena.getNumMallocs() - calculators.arenaMallocs, memory_order_relaxed);
+    calculators.arenaMallocs = arena.getNumMallocs();
+  }
+}
+
+//
+// Send the pending responses, waiting for EPOLLOUT if the socket is full.
+// While more than MAX_PENDING_OUTPUT bytes are pending, or after EOF, only
+// waits for EPOLLOUT, so no more requests are read. Returns false if the
+// connection has to be closed, as after EOF once all is sent
+//
+bool LoanServer::writeResponses(Connection &connection, int epollFd)
+{
+  while(connection.outOffset < connection.out.size())
+  {
+    ssize_t written = send(connection.fd, &connection.out[connection.outOffset],
+                           connection.out.size() - connection.outOffset, MSG_NOSIGNAL);
+    if(written < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      if(errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        return false;
+      }
+      break;
+    }
+    connection.outOffset += written;
+  }
+
+  bool pending = (connection.outOffset < connection.out.size());
+  if(connection.readClosed && !pending)
+  {
+    return false;
+  }
+  else if(!pending)
+  {
+    // Keeps the capacity, so the steady state doesnt allocate
+    connection.out.clear();
+    connection.outOffset = 0;
+  }
+  else if(connection.outOffset >= MAX_PENDING_OUTPUT)
+  {
+    // A client reading as fast as it sends may never drain the buffer
+    connection.out.erase(connection.out.begin(), connection.out.begin() + connection.outOffset);
+    connection.outOffset = 0;
+  }
+
+  uint32_t events = (connection.readClosed || connection.isBackedUp() ? (uint32_t) EPOLLOUT :
+                     EPOLLIN | EPOLLRDHUP | (pending ? (uint32_t) EPOLLOUT : 0));
+  if(events != connection.events)
+  {
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.ptr = &connection;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.events = events;
+  }
+
+  return true;
+}
+
+//
+// LoanServerClient
+//
+
+LoanServerClient::LoanServerClient() :
+  fd_(-1)
+{
+}
+
+LoanServerClient::~LoanServerClient()
+{
+  close();
+}
+
+void LoanServerClient::connect(const string &address)
+{
+  close();
+
+  sockaddr_storage storage;
+  bool tcp;
+  socklen_t length = parseAddress(address, storage, tcp);
+
+  fd_ = socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(fd_ < 0 || ::connect(fd_, (sockaddr *) &storage, length) != 0)
+  {
+    int error = errno;
+    close();
+    throw runtime_error("Cant connect to " + address + ": " + strerror(error));
+  }
+
+  if(tcp)
+  {
+    setNoDelay(fd_);
+  }
+}
+
+void LoanServerClient::close()
+{
+  if(fd_ >= 0)
+  {
+    ::close(fd_);
+  }
+  fd_ = -1;
+}
+
+void LoanServerClient::send(LoanServerRequest *requests, size_t count)
+{
+  for(size_t r = 0; r < count; ++r)
+  {
+    requests[r].length = LoanServerRequest::LENGTH;
+  }
+
+  const char *data = (const char *) requests;
+  size_t bytes = count*sizeof(LoanServerRequest);
+  while(bytes > 0)
+  {
+    ssize_t written = ::send(fd_, data, bytes, MSG_NOSIGNAL);
+    if(written < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      throw runtime_error(string("Error sending to the server: ") + strerror(errno));
+    }
+    data += written;
+    bytes -= written;
+  }
+}
+
+void LoanServerClient::receive(LoanServerResponse &response, string &message)
+{
+  receiveAll(&response, sizeof(response));
+
+  message.clear();
+  if(response.length < LoanServerResponse::LENGTH || response.length > MAX_FRAME_LENGTH)
+  {
+    throw runtime_error("Invalid response from the server");
+  }
+
+  size_t messageLength = response.length - LoanServerResponse::LENGTH;
+  if(messageLength > 0)
+  {
+    char buffer[MAX_FRAME_LENGTH];
+    receiveAll(buffer, messageLength);
+    message.assign(buffer, messageLength);
+  }
+}
+
+void LoanServerClient::receiveAll(void *data, size_t bytes)
+{
+  char *pos = (char *) data;
+  while(bytes > 0)
+  {
+    ssize_t received = recv(fd_, pos, bytes, 0);
+    if(received < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if(received <= 0)
+    {
+      throw runtime_error("The server closed the connection");
+    }
+    pos += received;
+    bytes -= received;
+  }
+}
@@ -0,0 +1,173 @@
+#ifndef LOANSERVER_H_INCLUDED
+#define LOANSERVER_H_INCLUDED
+
+/*
+Long running calculation server, so that quotes dont pay for a process
+start per loan. Listens on a Unix domain socket, or a TCP port of the
+loopback interface.
+
+Protocol: every message is a length prefixed frame in native byte order,
+the length being the number of bytes after the length field itself.
+Requests may be pipelined, the responses of a connection are sent in the
+order of its requests. Once 256 KB of responses are waiting for a client
+to read them, the server stops reading its requests until they are sent.
+
+  LoanServerRequest    the id to echo, the CALC_TYPE, the precision and
+                       the fields of a loan record, see LoanRecord.h
+  LoanServerResponse   the id, a status, 0 if calculated, and the results
+                       in the order of LoanRecord.h. If the status is not
+                       0, the frame ends with the error message instead
+
+Each thread of the server runs its own epoll event loop, and accepts
+connections from the shared listening socket (EPOLLEXCLUSIVE), so a
+connection stays on one thread, and a quote is read, calculated and
+answered without passing it between threads. Each thread has its own
+calculators, and a LoanArena for the scratch of a request, reset before
+each, so once warmed up serving a quote allocates nothing, see
+getNumMallocs().
+
+An address is a Unix socket path, or ":port" for TCP on localhost.
+
+With setCache(), the quotes are looked up in a LoanQuoteCache shared by
+all of the threads before they are calculated.
+*/
+
+#include <stdint.h>
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "LoanRecord.h"
+
+class LoanQuoteCache;
+class LoanRateTable;
+
+struct LoanServerRequest
+{
+  static const uint32_t LENGTH = 76; // sizeof(LoanServerRequest) - 4
+
+  uint32_t length;
+  uint32_t id;
+  uint32_t calcType;   // CALC_TYPE
+  uint32_t precision;  // LoanBulk::PRECISION: 0 float, 1 double, 2 cents
+  double fields[LOAN_RECORD_FIELDS];
+};
+
+struct LoanServerResponse
+{
+  static const uint32_t LENGTH = 28; // sizeof(LoanServerResponse) - 4
+
+  uint32_t length;     // LENGTH + the length of the error message
+  uint32_t id;
+  uint32_t status;     // 0 OK, 1 error
+  uint32_t numResults;
+  double results[LOAN_RECORD_MAX_RESULTS];
+};
+
+class LoanServer
+{
+public:
+  /**
+   * numThreads <= 0 uses one thread per core
+   */
+  LoanServer(int numThreads);
+  ~LoanServer();
+
+  /**
+   * Listen on address, throws runtime_error if it cant
+   */
+  void listen(const std::string &address);
+
+  /**
+   * Serve requests until stop() is called, the calling
+   * thread is one of the server threads
+   */
+  void run();
+
+  /**
+   * Make run() return, can be called from a signal handler
+   */
+  void stop();
+
+  /**
+   * Look up the interest rate quotes in cache, see isLoanQuoteCached(),
+   * NULL by default, which must outlive run(). Set it before calling run()
+   */
+  inline void setCache(LoanQuoteCache *cache) { cache_ = cache; }
+  inline LoanQuoteCache *getCache() const { return cache_; }
+
+  /**
+   * Calculate the quotes on the grid of table with its factors, see
+   * LoanCalculator::setRateTable(), NULL by default. Set it before run()
+   */
+  inline void setRateTable(const LoanRateTable *table) { rateTable_ = table; }
+
+  inline int getNumThreads() const { return numThreads_; }
+
+  /**
+   * The blocks allocated from the heap by the arenas of the threads,
+   * it stays constant once the largest request has been served
+   */
+  inline size_t getNumMallocs() const { return numMallocs_.load(std::memory_order_relaxed); }
+
+private:
+  LoanServer(); // Cant initialize default version
+  LoanServer(const LoanServer &);
+  LoanServer &operator=(const LoanServer &);
+
+  struct Connection;
+  struct Calculators;
+
+  void serverLoop();
+  bool readRequests(Connection &connection, Calculators &calculators);
+  void processRequest(const LoanServerRequest &request, Calculators &calculators, std::vector<char> &out);
+  bool writeResponses(Connection &connection, int epollFd);
+
+  int numThreads_;
+  int listenFd_;
+  int stopFd_;
+  bool tcp_;
+  std::string unixPath_;
+  LoanQuoteCache *cache_;
+  const LoanRateTable *rateTable_;
+  std::atomic<size_t> numMallocs_;
+};
+
+/**
+ * Blocking client of LoanServer
+ */
+class LoanServerClient
+{
+public:
+  LoanServerClient();
+  ~LoanServerClient();
+
+  /**
+   * Connect to address, throws runtime_error if it cant
+   */
+  void connect(const std::string &address);
+  void close();
+
+  /**
+   * Send count requests, setting their length. Throws runtime_error on errors
+   */
+  void send(LoanServerRequest *requests, size_t count);
+
+  /**
+   * Receive the next response, the error message of a response whose
+   * status is not 0 is stored in message. Throws runtime_error on errors
+   */
+  void receive(LoanServerResponse &response, std::string &message);
+
+private:
+  LoanServerClient(const LoanServerClient &);
+  LoanServerClient &operator=(const LoanServerClient &);
+
+  void receiveAll(void *data, size_t bytes);
+
+  int fd_;
+};
+
+#endif // LOANSERVER_H_INCLUDED
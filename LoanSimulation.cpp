@@ -0,0 +1,282 @@
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "LoanFormulas.h"
+#include "LoanRandom.h"
+#include "LoanSimulation.h"
+#include "LoanVector.h"
+
+using namespace std;
+
+const size_t LoanSimulation::BLOCK_SIZE;
+
+// The counter streams of the random numbers of a path
+static const uint32_t STREAM_EVENTS = 0;
+static const uint32_t STREAM_SCENARIO = 1;
+
+static const Double2 ZERO2 = {0.0, 0.0};
+
+// loanUniform() of 2 random numbers. The conversion of a signed int is a
+// single instruction, so the numbers are offset to signed
+static LOAN_VECTOR_INLINE Double2 uniform2(const uint32_t *x)
+{
+  Int2 offset;
+  memcpy(&offset, x, sizeof(offset));
+  offset ^= (int32_t) 0x80000000;
+
+  return (__builtin_convertvector(offset, Double2) + 2147483648.5)*(1.0/4294967296.0);
+}
+
+LoanSimulation::LoanSimulation(int numThreads) :
+  pool_(numThreads),
+  amount_(0.0),
+  interest_(0.0),
+  periodTotal_(0),
+  payment_(0.0),
+  scheduledPayment_(0.0),
+  cpr_(0.0),
+  cdr_(0.0),
+  severity_(0.0),
+  sigma_(0.0),
+  seed_(0),
+  numPaths_(0),
+  seconds_(0.0)
+{
+}
+
+void LoanSimulation::setLoan(double amount, double interest, int periodTotal, double payment)
+{
+  amount_ = amount;
+  interest_ = interest;
+  periodTotal_ = periodTotal;
+  payment_ = payment;
+}
+
+// The monthly probability of a yearly rate as in 6.5
+static inline double monthlyRate(double yearlyPercent)
+{
+  return 1.0 - pow(1.0 - yearlyPercent/100.0, 1.0/12.0);
+}
+
+void LoanSimulation::simulateBlock(size_t first, size_t count, double payment, double smm, double mdr, double *sums)
+{
+  const int N = periodTotal_;
+  const double i = interest_/100.0/12.0;
+  const double severity = severity_/100.0;
+  const uint32_t key0 = (uint32_t) seed_;
+  const uint32_t key1 = (uint32_t) (seed_ >> 32);
+
+  // The whole block is simulated, the paths past count are unused. The
+  // state of the paths is in vectors of 2, one SSE2 register, so that each
+  // period is a loop of vector operations
+  static const size_t VECTORS = BLOCK_SIZE/2;
+  Double2 balance[VECTORS];
+  Double2 pathSmm[VECTORS];
+  Double2 pathMdr[VECTORS];
+  Double2 total[VECTORS];
+  Double2 presentValue[VECTORS];
+  Double2 cash[VECTORS];
+  Double2 loss[VECTORS];
+  uint32_t random[4][BLOCK_SIZE];
+
+  for(size_t v = 0; v < VECTORS; ++v)
+  {
+    balance[v] = amount_ - ZERO2;
+    pathSmm[v] = smm - ZERO2;
+    pathMdr[v] = mdr - ZERO2;
+    total[v] = ZERO2;
+    presentValue[v] = ZERO2;
+  }
+
+  if(sigma_ > 0.0)
+  {
+    // A standard normal z per path, by Box-Muller
+    for(size_t k = 0; k < BLOCK_SIZE; ++k)
+    {
+      uint64_t path = first + k;
+      uint32_t counter[4] = {(uint32_t) path, (uint32_t) (path >> 32), 0, STREAM_SCENARIO};
+      uint32_t out[4];
+      loanPhilox4x32(counter, key0, key1, out);
+
+      double z = sqrt(-2.0*log(loanUniform(out[0])))*cos(2.0*M_PI*loanUniform(out[1]));
+      double factor = exp(sigma_*z - 0.5*sigma_*sigma_);
+      pathSmm[k/2][k%2] = min(smm*factor, 1.0);
+      pathMdr[k/2][k%2] = min(mdr*factor, 1.0);
+    }
+  }
+
+  for(int n = 1; n <= N; ++n)
+  {
+    // 4 periods of random numbers per call, a loop the compiler vectorizes
+    int slot = (n - 1)%4;
+    if(slot == 0)
+    {
+      for(size_t k = 0; k < BLOCK_SIZE; ++k)
+      {
+        uint64_t path = first + k;
+        uint32_t counter[4] = {(uint32_t) path, (uint32_t) (path >> 32), (uint32_t) (n - 1)/4, STREAM_EVENTS};
+        uint32_t out[4];
+        loanPhilox4x32(counter, key0, key1, out);
+
+        random[0][k] = out[0];
+        random[1][k] = out[1];
+        random[2][k] = out[2];
+        random[3][k] = out[3];
+      }
+    }
+
+    // The last payment pays off the balance
+    const uint32_t *events = random[slot];
+    const Double2 scheduledPayment = (n == N ? HUGE_VAL : payment) - ZERO2;
+    const double discount = discount_[n];
+
+    for(size_t v = 0; v < VECTORS; ++v)
+    {
+      Double2 b = balance[v];
+      Double2 owed = b*(1.0 + i);
+      Double2 scheduled = (owed < scheduledPayment ? owed : scheduledPayment);
+      Double2 u = uniform2(events + 2*v);
+
+      // A default is also a prepayment of the balance, which is then 0
+      Mask2 defaulted = (u < pathMdr[v]);
+      Mask2 prepaid = (u < pathMdr[v] + pathSmm[v]);
+
+      Double2 flow = (defaulted ? b*(1.0 - severity) : (prepaid ? owed : scheduled));
+      balance[v] = (prepaid ? ZERO2 : owed - scheduled);
+      cash[v] = flow;
+      loss[v] = (defaulted ? b*severity : ZERO2);
+      total[v] += flow;
+      presentValue[v] += flow*discount;
+    }
+
+    // Summed by lane, in path order, so the sums of a block dont depend
+    // on the thread
+    Double2 vectorBalance = ZERO2, vectorCash = ZERO2, vectorLoss = ZERO2;
+    for(size_t v = 0; v < count/2; ++v)
+    {
+      vectorBalance += balance[v];
+      vectorCash += cash[v];
+      vectorLoss += loss[v];
+    }
+    double sumBalance = vectorBalance[0] + vectorBalance[1];
+    double sumCash = vectorCash[0] + vectorCash[1];
+    double sumLoss = vectorLoss[0] + vectorLoss[1];
+    if(count%2 != 0)
+    {
+      sumBalance += balance[count/2][0];
+      sumCash += cash[count/2][0];
+      sumLoss += loss[count/2][0];
+    }
+    sums[n] += sumBalance;
+    sums[(N + 1) + n] += sumCash;
+    sums[2*(N + 1) + n] += sumLoss;
+  }
+
+  for(size_t k = 0; k < count; ++k)
+  {
+    pathCashFlow_[first + k] = total[k/2][k%2];
+    pathPresentValue_[first + k] = presentValue[k/2][k%2];
+  }
+}
+
+void LoanSimulation::run(size_t numPaths)
+{
+  if(!(amount_ > 0.0) || !(interest_ >= 0.0) || periodTotal_ < 1)
+  {
+    throw invalid_argument("Must set the loan amount, interest, and total period for a simulation");
+  }
+  if(!(cpr_ >= 0.0 && cpr_ < 100.0) || !(cdr_ >= 0.0 && cdr_ < 100.0) ||
+     !(severity_ >= 0.0 && severity_ <= 100.0) || !(sigma_ >= 0.0))
+  {
+    throw invalid_argument("The prepayment and default rates must be 0 to 100%");
+  }
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+  const int N = periodTotal_;
+  const double i = interest_/100.0/12.0;
+  // The payment set is kept, for the next run()
+  const double payment = (payment_ != 0.0 ? payment_ : loanPayment(amount_, i, N, loanGrowthFactor(i, -N)));
+  scheduledPayment_ = payment;
+
+  scheduledBalance_.assign(N + 1, 0.0);
+  discount_.assign(N + 1, 0.0);
+  for(int n = 0; n <= N; ++n)
+  {
+    double growth = loanGrowthFactor(i, n);
+    double scheduled = loanBalance(amount_, payment, i, n, growth);
+    scheduledBalance_[n] = max(scheduled, 0.0);
+    discount_[n] = 1.0/growth;
+  }
+
+  numPaths_ = numPaths;
+  pathCashFlow_.resize(numPaths);
+  pathPresentValue_.resize(numPaths);
+
+  // Each thread sums the periods of its blocks, in block order
+  double smm = monthlyRate(cpr_);
+  double mdr = monthlyRate(cdr_);
+  size_t numBlocks = (numPaths + BLOCK_SIZE - 1)/BLOCK_SIZE;
+  vector<vector<double> > sums(pool_.getNumThreads(), vector<double>(3*(N + 1), 0.0));
+
+  pool_.parallelFor(numBlocks, [&] (size_t begin, size_t end, int thread)
+  {
+    for(size_t block = begin; block < end; ++block)
+    {
+      size_t first = block*BLOCK_SIZE;
+      simulateBlock(first, min(BLOCK_SIZE, numPaths - first), payment, smm, mdr, sums[thread].data());
+    }
+  });
+
+  balance_.assign(N + 1, 0.0);
+  cashFlow_.assign(N + 1, 0.0);
+  loss_.assign(N + 1, 0.0);
+  for(size_t thread = 0; thread < sums.size(); ++thread)
+  {
+    for(int n = 1; n <= N; ++n)
+    {
+      balance_[n] += sums[thread][n];
+      cashFlow_[n] += sums[thread][(N + 1) + n];
+      loss_[n] += sums[thread][2*(N + 1) + n];
+    }
+  }
+  for(int n = 1; n <= N; ++n)
+  {
+    balance_[n] = (numPaths > 0 ? balance_[n]/numPaths : 0.0);
+    cashFlow_[n] = (numPaths > 0 ? cashFlow_[n]/numPaths : 0.0);
+    loss_[n] = (numPaths > 0 ? loss_[n]/numPaths : 0.0);
+  }
+  balance_[0] = amount_;
+
+  seconds_ = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// The q quantile of values, by the nearest rank of a copy
+static double quantile(const vector<double> &values, double q)
+{
+  if(values.empty())
+  {
+    return 0.0;
+  }
+
+  vector<double> sorted(values);
+  size_t rank = (size_t) (max(0.0, min(q, 1.0))*(sorted.size() - 1) + 0.5);
+  nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+
+  return sorted[rank];
+}
+
+double LoanSimulation::getCashFlowQuantile(double q) const
+{
+  return quantile(pathCashFlow_, q);
+}
+
+double LoanSimulation::getPresentValueQuantile(double q) const
+{
+  return quantile(pathPresentValue_, q);
+}
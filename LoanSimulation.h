@@ -0,0 +1,153 @@
+#ifndef LOANSIMULATION_H_INCLUDED
+#define LOANSIMULATION_H_INCLUDED
+
+/*
+Monte Carlo simulation of the prepayments and defaults of a loan pool,
+each simulated path one loan of the pool, month by month.
+
+LoanCalculator::calculateLoanBalance() assumes every scheduled payment is
+made. Here, each month a loan still outstanding either:
+  defaults    with probability MDR, the monthly default rate of the
+              yearly CDR, 1 - (1 - CDR)^(1/12). The balance is lost but
+              for the recovery, balance*(1 - severity)
+  prepays     with probability SMM, the single monthly mortality of the
+              yearly CPR, 1 - (1 - CPR)^(1/12). The balance and the
+              interest of the month are paid
+  pays        the scheduled payment, with the balance recurrence of the
+              amortization schedule, see LoanSchedule.h:
+                B_n = B_(n-1)*(1+i) - P
+              the last payment paying off the balance
+With a rate volatility sigma, the CPR and the CDR of each path are scaled
+by a lognormal factor exp(sigma*z - sigma^2/2) of mean 1, so the paths
+also differ in their economic scenario, as in a pool whose rates move
+together.
+
+The random numbers are Philox4x32 (LoanRandom.h), counter based on the
+path, the period and the seed, so a path is the same whatever thread
+simulates it. The paths are simulated in blocks of BLOCK_SIZE, each
+period of a block one branchless loop of SSE2 vectors over its paths, and
+the blocks are spread over a LoanThreadPool.
+
+The results are the expected balance, cash flow and loss of each period,
+averaged over the paths, and the quantiles of the total cash flow of a
+path and of its present value at the loan rate, which is the amount of
+the loan for a path without defaults. The quantiles are exactly
+reproducible for a seed, the expected values to within the rounding of
+summing them on different threads.
+*/
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "LoanThreadPool.h"
+
+class LoanSimulation
+{
+public:
+  static const size_t BLOCK_SIZE = 256;
+
+  /**
+   * numThreads <= 0 uses one thread per core
+   */
+  LoanSimulation(int numThreads);
+  ~LoanSimulation() {}
+
+  /**
+   * The loan of each path, as in LoanCalculator: the amount A, the yearly
+   * interest rate as in 6.75 and the total periods N. A payment of 0.0 is
+   * calculated, as LoanCalculator::calculatePayment()
+   */
+  void setLoan(double amount, double interest, int periodTotal, double payment = 0.0);
+
+  /**
+   * Yearly rates as in 6.5, the CPR of the prepayments, the CDR of the
+   * defaults and the severity, the loss given default. All 0.0 by default
+   */
+  inline void setPrepaymentRate(double cpr) { cpr_ = cpr; }
+  inline void setDefaultRate(double cdr)    { cdr_ = cdr; }
+  inline void setSeverity(double severity)  { severity_ = severity; }
+
+  /**
+   * The standard deviation of the log of the factor of the rates of
+   * each path, 0.0 by default, all of the paths have the same rates
+   */
+  inline void setRateVolatility(double sigma) { sigma_ = sigma; }
+
+  inline void setSeed(uint64_t seed) { seed_ = seed; }
+
+  /**
+   * Simulate numPaths paths, replacing the results of any previous run.
+   * Throws invalid_argument if the loan or the rates are invalid
+   */
+  void run(size_t numPaths);
+
+  //
+  // The results of the last run()
+  //
+
+  inline size_t getNumPaths() const    { return numPaths_; }
+  inline int getPeriodTotal() const    { return periodTotal_; }
+  inline double getPayment() const     { return scheduledPayment_; }
+  inline int getNumThreads() const     { return pool_.getNumThreads(); }
+
+  // Averaged over the paths, of period n, 1 to N. The balance is after the
+  // payment of the period, the cash flow the payment, prepayment or recovery
+  inline double getExpectedBalance(int n) const  { return balance_[n]; }
+  inline double getExpectedCashFlow(int n) const { return cashFlow_[n]; }
+  inline double getExpectedLoss(int n) const     { return loss_[n]; }
+
+  // The balance of period n if every payment is made, as calculateLoanBalance()
+  inline double getScheduledBalance(int n) const { return scheduledBalance_[n]; }
+
+  /**
+   * The q quantile, 0 to 1, of the total cash flow of a path, and of its
+   * present value, discounted at the loan rate
+   */
+  double getCashFlowQuantile(double q) const;
+  double getPresentValueQuantile(double q) const;
+
+  // The time of the last run()
+  inline double getSeconds() const        { return seconds_; }
+  inline double getPathsPerSecond() const { return (seconds_ > 0.0 ? numPaths_/seconds_ : 0.0); }
+
+private:
+  LoanSimulation(); // Cant initialize default version
+  LoanSimulation(const LoanSimulation &);
+  LoanSimulation &operator=(const LoanSimulation &);
+
+  // Simulate the paths [first, first + count), count <= BLOCK_SIZE, of the
+  // scheduled payment, adding the sums of each period to sums, balance,
+  // cash flow and loss by period
+  void simulateBlock(size_t first, size_t count, double payment, double smm, double mdr, double *sums);
+
+  LoanThreadPool pool_;
+
+  double amount_;
+  double interest_;
+  int periodTotal_;
+  double payment_;
+  double scheduledPayment_;   // payment_, or calculated if 0.0
+  double cpr_;
+  double cdr_;
+  double severity_;
+  double sigma_;
+  uint64_t seed_;
+
+  size_t numPaths_;
+  double seconds_;
+
+  // By period, 0 to N, the period 0 is the start of the loan
+  std::vector<double> balance_;
+  std::vector<double> cashFlow_;
+  std::vector<double> loss_;
+  std::vector<double> scheduledBalance_;
+  std::vector<double> discount_;
+
+  // By path
+  std::vector<double> pathCashFlow_;
+  std::vector<double> pathPresentValue_;
+};
+
+#endif // LOANSIMULATION_H_INCLUDED
@@ -0,0 +1,446 @@
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "LoanCounter.h"
+#include "LoanStats.h"
+
+using namespace std;
+
+namespace
+{
+
+/**
+ * The stats of one thread. Only its thread writes them, each counter is
+ * loaded and stored back relaxed, so the writes are never lost and never
+ * contended, and they can be read by any thread
+ */
+struct LoanStatsThread
+{
+  explicit LoanStatsThread(int threadId) : id(threadId)
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    for(int op = 0; op < LOAN_NUM_OPS; ++op)
+    {
+      count[op].store(0, memory_order_relaxed);
+      sum[op].store(0, memory_order_relaxed);
+      min[op].store(UINT64_MAX, memory_order_relaxed);
+      max[op].store(0, memory_order_relaxed);
+      for(int bucket = 0; bucket < LoanStats::NUM_BUCKETS; ++bucket)
+      {
+        buckets[op][bucket].store(0, memory_order_relaxed);
+      }
+    }
+  }
+
+  int id;
+  atomic<uint64_t> count[LOAN_NUM_OPS];
+  atomic<uint64_t> sum[LOAN_NUM_OPS];
+  atomic<uint64_t> min[LOAN_NUM_OPS];
+  atomic<uint64_t> max[LOAN_NUM_OPS];
+  atomic<uint64_t> buckets[LOAN_NUM_OPS][LoanStats::NUM_BUCKETS];
+};
+
+// The stats of one operation, merged over the threads
+struct MergedStats
+{
+  uint64_t count;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+  vector<uint64_t> buckets;
+  vector<uint64_t> threadCounts;
+};
+
+const char *OP_NAMES[LOAN_NUM_OPS] =
+{
+  "calculatePayment",
+  "calculateLoanBalance",
+  "calculateNumberPayments",
+  "calculateLoanAmount",
+  "calculateInterestRate",
+  "calculateEffectiveInterestRate",
+  "calculateFinancedAmount",
+  "bulkParse",
+  "bulkValidate",
+  "bulkOutput",
+  "bulkWrite"
+};
+
+// Every thread that has recorded, in the order of their first record
+mutex threadsMutex;
+vector<LoanStatsThread*> threads;
+
+thread_local LoanStatsThread *currentThread = NULL;
+
+LoanStatsThread *getCurrentThread()
+{
+  if(currentThread == NULL)
+  {
+    lock_guard<mutex> lock(threadsMutex);
+    currentThread = new LoanStatsThread(threads.size());
+    threads.push_back(currentThread);
+  }
+
+  return currentThread;
+}
+
+void merge(vector<MergedStats> &merged)
+{
+  lock_guard<mutex> lock(threadsMutex);
+
+  merged.resize(LOAN_NUM_OPS);
+  for(int op = 0; op < LOAN_NUM_OPS; ++op)
+  {
+    MergedStats &stats = merged[op];
+    stats.count = stats.sum = stats.max = 0;
+    stats.min = UINT64_MAX;
+    stats.buckets.assign(LoanStats::NUM_BUCKETS, 0);
+    stats.threadCounts.assign(threads.size(), 0);
+
+    for(size_t thread = 0; thread < threads.size(); ++thread)
+    {
+      const LoanStatsThread &source = *threads[thread];
+      uint64_t count = source.count[op].load(memory_order_relaxed);
+      stats.threadCounts[thread] = count;
+      if(count == 0)
+      {
+        continue;
+      }
+
+      stats.count += count;
+      stats.sum += source.sum[op].load(memory_order_relaxed);
+      uint64_t min = source.min[op].load(memory_order_relaxed);
+      uint64_t max = source.max[op].load(memory_order_relaxed);
+      stats.min = (min < stats.min ? min : stats.min);
+      stats.max = (max > stats.max ? max : stats.max);
+      for(int bucket = 0; bucket < LoanStats::NUM_BUCKETS; ++bucket)
+      {
+        stats.buckets[bucket] += source.buckets[op][bucket].load(memory_order_relaxed);
+      }
+    }
+  }
+}
+
+/**
+ * The value at quantile of the merged histogram, the largest value of its
+ * bucket, bounded by the largest value recorded
+ */
+uint64_t getQuantile(const MergedStats &stats, double quantile)
+{
+  uint64_t rank = (uint64_t) (quantile*stats.count + 0.5);
+  rank = (rank < 1 ? 1 : rank);
+
+  uint64_t seen = 0;
+  for(int bucket = 0; bucket < LoanStats::NUM_BUCKETS; ++bucket)
+  {
+    seen += stats.buckets[bucket];
+    if(seen >= rank)
+    {
+      uint64_t limit = LoanStats::getBucketLimit(bucket);
+      return (limit < stats.max ? limit : stats.max);
+    }
+  }
+
+  return stats.max;
+}
+
+void writeJson(ostream &os, const vector<MergedStats> &merged)
+{
+  char buffer[512];
+
+  os << "{\n"
+     << "  \"enabled\": " << (LoanStats::isEnabled() ? "true" : "false") << ",\n"
+     << "  \"threads\": " << (merged.empty() ? 0 : merged[0].threadCounts.size()) << ",\n"
+     << "  \"operations\": {";
+
+  const char *separator = "\n";
+  for(int op = 0; op < LOAN_NUM_OPS; ++op)
+  {
+    const MergedStats &stats = merged[op];
+    if(stats.count == 0)
+    {
+      continue;
+    }
+
+    snprintf(buffer, sizeof(buffer),
+             "%s    \"%s\": {\n"
+             "      \"count\": %llu,\n"
+             "      \"sum_ns\": %llu,\n"
+             "      \"min_ns\": %llu,\n"
+             "      \"max_ns\": %llu,\n"
+             "      \"mean_ns\": %.1f,\n"
+             "      \"p50_ns\": %llu,\n"
+             "      \"p90_ns\": %llu,\n"
+             "      \"p99_ns\": %llu,\n"
+             "      \"p999_ns\": %llu,\n",
+             separator, LoanStats::getOpName(op),
+             (unsigned long long) stats.count, (unsigned long long) stats.sum,
+             (unsigned long long) stats.min, (unsigned long long) stats.max,
+             (double) stats.sum/stats.count,
+             (unsigned long long) getQuantile(stats, 0.5), (unsigned long long) getQuantile(stats, 0.9),
+             (unsigned long long) getQuantile(stats, 0.99), (unsigned long long) getQuantile(stats, 0.999));
+    os << buffer;
+    separator = ",\n";
+
+    os << "      \"thread_counts\": [";
+    for(size_t thread = 0; thread < stats.threadCounts.size(); ++thread)
+    {
+      os << (thread == 0 ? "" : ", ") << stats.threadCounts[thread];
+    }
+
+    // The buckets counted in, as [largest value, count]
+    os << "],\n      \"buckets\": [";
+    const char *bucketSeparator = "";
+    for(int bucket = 0; bucket < LoanStats::NUM_BUCKETS; ++bucket)
+    {
+      if(stats.buckets[bucket] != 0)
+      {
+        os << bucketSeparator << "[" << LoanStats::getBucketLimit(bucket) << ", " << stats.buckets[bucket] << "]";
+        bucketSeparator = ", ";
+      }
+    }
+    os << "]\n    }";
+  }
+
+  os << "\n  }\n}\n";
+}
+
+void writePrometheus(ostream &os, const vector<MergedStats> &merged)
+{
+  char buffer[512];
+
+  os << "# HELP loancalc_operation_duration_seconds Latency of the loan calculator operations.\n"
+     << "# TYPE loancalc_operation_duration_seconds histogram\n";
+  for(int op = 0; op < LOAN_NUM_OPS; ++op)
+  {
+    const MergedStats &stats = merged[op];
+    if(stats.count == 0)
+    {
+      continue;
+    }
+
+    // Only the buckets counted in, the buckets are cumulative anyway
+    uint64_t cumulative = 0;
+    for(int bucket = 0; bucket < LoanStats::NUM_BUCKETS; ++bucket)
+    {
+      if(stats.buckets[bucket] != 0)
+      {
+        cumulative += stats.buckets[bucket];
+        snprintf(buffer, sizeof(buffer),
+                 "loancalc_operation_duration_seconds_bucket{op=\"%s\",le=\"%.9g\"} %llu\n",
+                 LoanStats::getOpName(op), LoanStats::getBucketLimit(bucket)*1e-9,
+                 (unsigned long long) cumulative);
+        os << buffer;
+      }
+    }
+
+    snprintf(buffer, sizeof(buffer),
+             "loancalc_operation_duration_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n"
+             "loancalc_operation_duration_seconds_sum{op=\"%s\"} %.9f\n"
+             "loancalc_operation_duration_seconds_count{op=\"%s\"} %llu\n",
+             LoanStats::getOpName(op), (unsigned long long) stats.count,
+             LoanStats::getOpName(op), stats.sum*1e-9,
+             LoanStats::getOpName(op), (unsigned long long) stats.count);
+    os << buffer;
+  }
+
+  os << "# HELP loancalc_thread_operations_total Operations of the loan calculator by thread.\n"
+     << "# TYPE loancalc_thread_operations_total counter\n";
+  for(int op = 0; op < LOAN_NUM_OPS; ++op)
+  {
+    const MergedStats &stats = merged[op];
+    for(size_t thread = 0; thread < stats.threadCounts.size(); ++thread)
+    {
+      if(stats.threadCounts[thread] != 0)
+      {
+        snprintf(buffer, sizeof(buffer), "loancalc_thread_operations_total{op=\"%s\",thread=\"%lu\"} %llu\n",
+                 LoanStats::getOpName(op), (unsigned long) thread,
+                 (unsigned long long) stats.threadCounts[thread]);
+        os << buffer;
+      }
+    }
+  }
+}
+
+void signalLoop(string fileName, LoanStats::FORMAT format, sigset_t signals)
+{
+  for(;;)
+  {
+    int signal;
+    if(sigwait(&signals, &signal) != 0)
+    {
+      return;
+    }
+
+    try
+    {
+      LoanStats::writeFile(fileName, format);
+    }
+    catch(const exception &e)
+    {
+      cerr << "Cant write the stats: " << e.what() << endl;
+    }
+  }
+}
+
+} // namespace
+
+atomic<bool> LoanStats::enabled_(false);
+thread_local bool LoanStatsScope::active_ = false;
+
+void LoanStats::setEnabled(bool enabled)
+{
+#ifdef LOAN_NO_STATS
+  enabled = false;
+#endif
+
+  enabled_.store(enabled, memory_order_relaxed);
+}
+
+bool LoanStats::isCompiled()
+{
+#ifdef LOAN_NO_STATS
+  return false;
+#else
+  return true;
+#endif
+}
+
+const char *LoanStats::getOpName(int op)
+{
+  return (op >= 0 && op < LOAN_NUM_OPS ? OP_NAMES[op] : "unknown");
+}
+
+void LoanStats::record(int op, uint64_t ns)
+{
+  LoanStatsThread &stats = *getCurrentThread();
+
+  loanIncrement(stats.count[op], 1);
+  loanIncrement(stats.sum[op], ns);
+  loanIncrement(stats.buckets[op][getBucket(ns)], 1);
+  if(ns < stats.min[op].load(memory_order_relaxed))
+  {
+    stats.min[op].store(ns, memory_order_relaxed);
+  }
+  if(ns > stats.max[op].load(memory_order_relaxed))
+  {
+    stats.max[op].store(ns, memory_order_relaxed);
+  }
+}
+
+/**
+ * Below 2^SUB_BUCKET_BITS the bucket is the value. Above, the top
+ * SUB_BUCKET_BITS + 1 bits of the value select the bucket, the highest
+ * bit its power of 2 and the next bits the sub bucket in it
+ */
+int LoanStats::getBucket(uint64_t ns)
+{
+  const uint64_t subBuckets = 1 << SUB_BUCKET_BITS;
+  if(ns < subBuckets)
+  {
+    return (int) ns;
+  }
+
+  int shift = (63 - __builtin_clzll(ns)) - SUB_BUCKET_BITS;
+  return ((shift + 1) << SUB_BUCKET_BITS) + (int) ((ns >> shift) & (subBuckets - 1));
+}
+
+uint64_t LoanStats::getBucketLimit(int bucket)
+{
+  const int subBuckets = 1 << SUB_BUCKET_BITS;
+  if(bucket < subBuckets)
+  {
+    return bucket;
+  }
+
+  int shift = (bucket >> SUB_BUCKET_BITS) - 1;
+  uint64_t lower = (uint64_t) (subBuckets + (bucket & (subBuckets - 1))) << shift;
+  return lower + (((uint64_t) 1 << shift) - 1);
+}
+
+void LoanStats::write(ostream &os, FORMAT format)
+{
+  vector<MergedStats> merged;
+  merge(merged);
+
+  if(format == FORMAT_JSON)
+  {
+    writeJson(os, merged);
+  }
+  else
+  {
+    writePrometheus(os, merged);
+  }
+}
+
+/**
+ * Written to a temporary file renamed over fileName, so a reader, as a
+ * Prometheus textfile collector, never sees a partial dump
+ */
+void LoanStats::writeFile(const string &fileName, FORMAT format)
+{
+  if(fileName == "-")
+  {
+    write(cerr, format);
+    return;
+  }
+
+  string tempName(fileName + ".tmp");
+  {
+    ofstream file(tempName.c_str(), ios::out | ios::trunc);
+    if(!file)
+    {
+      throw runtime_error("Cant open stats file: " + tempName);
+    }
+
+    write(file, format);
+    file.flush();
+    if(!file)
+    {
+      throw runtime_error("Cant write stats file: " + tempName);
+    }
+  }
+
+  if(rename(tempName.c_str(), fileName.c_str()) != 0)
+  {
+    remove(tempName.c_str());
+    throw runtime_error("Cant rename stats file to: " + fileName);
+  }
+}
+
+void LoanStats::writeOnSignal(const string &fileName, FORMAT format)
+{
+  static once_flag started;
+
+  call_once(started, [&fileName, format]() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    std::thread(signalLoop, fileName, format, signals).detach();
+  });
+}
+
+void LoanStats::clear()
+{
+  lock_guard<mutex> lock(threadsMutex);
+
+  for(size_t thread = 0; thread < threads.size(); ++thread)
+  {
+    threads[thread]->clear();
+  }
+}
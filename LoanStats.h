@@ -0,0 +1,165 @@
+#ifndef LOANSTATS_H_INCLUDED
+#define LOANSTATS_H_INCLUDED
+
+/*
+Instrumentation of the hot paths: a call counter and a latency histogram
+per operation, the calculate*() methods of the calculator and the parse,
+validate, output and write stages of the bulk mode, kept per thread.
+
+An operation is timed by a LOAN_STATS_SCOPE(op) at the start of its
+block. It costs one relaxed load and a branch while the instrumentation is
+disabled, the default, and two reads of the steady clock while enabled.
+Each thread records to its own LoanStatsThread, allocated on its first
+record and never freed, with single writer relaxed atomics, so the threads
+never share a cache line and the stats can be read while they run.
+
+Only the outermost scope of a thread is recorded. An operation called by
+another one, as calculateFinancedAmount() by calculatePayment(), or
+calculatePayment() by calculateEffectiveInterestRate(), is part of the
+time of its caller and isnt counted as a call of its own.
+
+The histograms are HDR style, log linear: the values are in nanoseconds,
+exact below 2^SUB_BUCKET_BITS, then each power of 2 is split in
+2^SUB_BUCKET_BITS linear buckets, so any value is within 1/16 of the
+bucket it is counted in, from nanoseconds to centuries, in 8 KB per
+operation.
+
+The stats of all of the threads are merged to be written, as JSON or as
+Prometheus text, see write(). writeOnSignal() starts a thread that writes
+them each time the process gets SIGUSR1.
+
+Compiled with LOAN_NO_STATS defined, LOAN_STATS_SCOPE() is empty, so the
+hot paths have no instrumentation at all, and setEnabled() has no effect.
+*/
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+enum LOAN_OP
+{
+  LOAN_OP_PAYMENT=0,
+  LOAN_OP_BALANCE,
+  LOAN_OP_NUMPAYMENTS,
+  LOAN_OP_AMOUNT,
+  LOAN_OP_INTEREST,
+  LOAN_OP_EFFECTIVE_INTEREST,
+  LOAN_OP_FINANCED_AMOUNT,
+  LOAN_OP_PARSE,      // a bulk record parsed
+  LOAN_OP_VALIDATE,   // a block of bulk records validated
+  LOAN_OP_OUTPUT,     // a bulk result formatted or added to its columns
+  LOAN_OP_WRITE,      // the results of a bulk chunk written
+  LOAN_NUM_OPS
+};
+
+class LoanStats
+{
+public:
+  static const int SUB_BUCKET_BITS = 4;
+  static const int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+  enum FORMAT
+  {
+    FORMAT_JSON=0,
+    FORMAT_PROMETHEUS
+  };
+
+  // Disabled by default
+  static void setEnabled(bool enabled);
+  static inline bool isEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  // False if compiled with LOAN_NO_STATS
+  static bool isCompiled();
+
+  // The name of an operation, as in "calculatePayment"
+  static const char *getOpName(int op);
+
+  /**
+   * Count a call of op that took ns nanoseconds, on the calling thread
+   */
+  static void record(int op, uint64_t ns);
+
+  // The bucket of a value, and the largest value of a bucket
+  static int getBucket(uint64_t ns);
+  static uint64_t getBucketLimit(int bucket);
+
+  /**
+   * Write the stats of all of the threads, merged by operation. Operations
+   * never called are left out
+   */
+  static void write(std::ostream &os, FORMAT format);
+
+  /**
+   * Write the stats to fileName, "-" for stderr, replacing it. Throws
+   * runtime_error if the file cant be written
+   */
+  static void writeFile(const std::string &fileName, FORMAT format);
+
+  /**
+   * Write the stats to fileName on each SIGUSR1. SIGUSR1 is blocked in
+   * the calling thread, so call it before creating any other thread, which
+   * inherit the mask. Only the first call has an effect
+   */
+  static void writeOnSignal(const std::string &fileName, FORMAT format);
+
+  // Clear the stats of all of the threads, while none of them records
+  static void clear();
+
+private:
+  LoanStats(); // Cant initialize, only static members
+
+  static std::atomic<bool> enabled_;
+};
+
+/**
+ * Times the block it is declared in as op, if enabled when it starts
+ * and not inside another scope of the same thread
+ */
+class LoanStatsScope
+{
+public:
+  explicit inline LoanStatsScope(int op) :
+    op_(op),
+    enabled_(LoanStats::isEnabled() && !active_)
+  {
+    if(enabled_)
+    {
+      active_ = true;
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  inline ~LoanStatsScope()
+  {
+    if(enabled_)
+    {
+      std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start_;
+      LoanStats::record(op_, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+      active_ = false;
+    }
+  }
+
+private:
+  LoanStatsScope(); // Cant initialize default version
+  LoanStatsScope(const LoanStatsScope &);
+  LoanStatsScope &operator=(const LoanStatsScope &);
+
+  int op_;
+  bool enabled_;
+  std::chrono::steady_clock::time_point start_;
+
+  // A scope of the thread is being recorded
+  static thread_local bool active_;
+};
+
+#ifdef LOAN_NO_STATS
+  #define LOAN_STATS_SCOPE(op)
+#else
+  #define LOAN_STATS_SCOPE(op) LoanStatsScope loanStatsScope_(op)
+#endif
+
+#endif // LOANSTATS_H_INCLUDED
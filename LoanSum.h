@@ -0,0 +1,52 @@
+#ifndef LOANSUM_H_INCLUDED
+#define LOANSUM_H_INCLUDED
+
+/*
+Compensated summation, Neumaier's variant of Kahan summation: the rounding
+error of each addition is accumulated separately and added back at the
+end, so the sum of millions of amounts is as accurate as if each addition
+were exact, whatever their order and magnitudes. A plain double sum of
+10 million loans drifts by cents, a float sum by thousands.
+
+Two sums of parts of the values can be merged, as the per thread partial
+sums of a reduction.
+*/
+
+class LoanSum
+{
+public:
+  LoanSum() : sum_(0.0), compensation_(0.0) {}
+
+  inline void add(double value)
+  {
+    double sum = sum_ + value;
+
+    // The low order bits lost by the addition, of the smaller operand
+    if((sum_ >= 0.0 ? sum_ : -sum_) >= (value >= 0.0 ? value : -value))
+    {
+      compensation_ += (sum_ - sum) + value;
+    }
+    else
+    {
+      compensation_ += (value - sum) + sum_;
+    }
+
+    sum_ = sum;
+  }
+
+  inline void merge(const LoanSum &other)
+  {
+    add(other.sum_);
+    compensation_ += other.compensation_;
+  }
+
+  inline double getValue() const { return sum_ + compensation_; }
+
+  inline void clear() { sum_ = compensation_ = 0.0; }
+
+private:
+  double sum_;
+  double compensation_;
+};
+
+#endif // LOANSUM_H_INCLUDED
@@ -0,0 +1,476 @@
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+#include "LoanCalculator.h"
+#include "LoanSweep.h"
+
+using namespace std;
+
+// The tensor is calculated in chunks of whole rows of about this many
+// points, which bounds the memory of the results of very large grids
+static const size_t CHUNK_POINTS = 4*1024*1024;
+
+// The grid can have at most this many points
+static const double MAX_POINTS = 1e15;
+
+static const char *FIELD_NAMES[LOAN_RECORD_FIELDS] =
+{
+  "amount",
+  "interest",
+  "periodTotal",
+  "payment",
+  "periodElapsed",
+  "initialPayment",
+  "openingFee",
+  "openingPercent"
+};
+
+const size_t LoanSweep::TILE_SIZE;
+
+// The fields of LoanRecord.h that (1+i)^N and (1+i)^n depend on
+static inline bool isFactorField(int field)
+{
+  return (field == 1 || field == 2 || field == 4);
+}
+
+LoanSweep::LoanSweep(CALC_TYPE calcType, LoanBulk::PRECISION precision, int numThreads) :
+  calcType_(calcType),
+  precision_(precision),
+  pool_(numThreads),
+  rateTable_(NULL),
+  numResults_(0),
+  text_(pool_.getNumThreads())
+{
+  for(int field = 0; field < LOAN_RECORD_FIELDS; ++field)
+  {
+    values_[field] = 0.0;
+  }
+}
+
+const char *LoanSweep::getFieldName(int field)
+{
+  return (field >= 0 && field < LOAN_RECORD_FIELDS ? FIELD_NAMES[field] : "unknown");
+}
+
+void LoanSweep::setValues(const double values[LOAN_RECORD_FIELDS])
+{
+  for(int field = 0; field < LOAN_RECORD_FIELDS; ++field)
+  {
+    values_[field] = values[field];
+  }
+}
+
+void LoanSweep::addAxis(int field, double first, double last, double step)
+{
+  if(field < 0 || field >= LOAN_RECORD_FIELDS)
+  {
+    throw invalid_argument("Unknown loan field for a sweep");
+  }
+
+  for(size_t axis = 0; axis < axes_.size(); ++axis)
+  {
+    if(axes_[axis].field == field)
+    {
+      throw invalid_argument(string("The ") + FIELD_NAMES[field] + " is already swept");
+    }
+  }
+
+  // The steps to last, to within rounding, as 2 to 11.99 by 0.01
+  double steps = (last - first)/step;
+  if(!(steps >= 0.0) || isinf(steps) || step == 0.0)
+  {
+    throw invalid_argument(string("Invalid sweep range of the ") + FIELD_NAMES[field]);
+  }
+
+  double count = floor(steps + 1e-9) + 1.0;
+  if(count*max((double) getNumPoints(), 1.0) > MAX_POINTS)
+  {
+    throw invalid_argument("Too many points to sweep");
+  }
+
+  LoanSweepAxis newAxis;
+  newAxis.field = field;
+  newAxis.first = first;
+  newAxis.step = step;
+  newAxis.count = (size_t) count;
+  axes_.push_back(newAxis);
+
+  // As an amount or rate would be written, without the rounding of the steps
+  vector<string> text(newAxis.count);
+  char buffer[64];
+  for(size_t index = 0; index < newAxis.count; ++index)
+  {
+    snprintf(buffer, sizeof(buffer), "%.10g", newAxis.getValue(index));
+    text[index] = buffer;
+  }
+  axisText_.push_back(text);
+}
+
+size_t LoanSweep::getNumPoints() const
+{
+  if(axes_.empty())
+  {
+    return 0;
+  }
+
+  size_t points = 1;
+  for(size_t axis = 0; axis < axes_.size(); ++axis)
+  {
+    points *= axes_[axis].count;
+  }
+
+  return points;
+}
+
+//
+// Write value with decimals decimals, 2 or 4, as printf("%.*f") would.
+// Returns the length. The value is scaled and rounded to an integer,
+// which is the rounding of printf, that of the exact value, unless the
+// value is too large, invalid or within rounding of a tie, where printf
+// itself is used
+//
+static size_t formatFixed(char *buffer, double value, int decimals)
+{
+  static const double SCALES[] = {1.0, 1e1, 1e2, 1e3, 1e4};
+  static const uint64_t INTEGER_SCALES[] = {1, 10, 100, 1000, 10000};
+
+  double scaled = value*SCALES[decimals];
+  double rounded = nearbyint(scaled);
+  if(!(fabs(scaled) < 1e9) || fabs(fabs(scaled - rounded) - 0.5) < 1e-6)
+  {
+    return snprintf(buffer, 64, "%.*f", decimals, value);
+  }
+
+  uint64_t digits = (uint64_t) fabs(rounded);
+  uint64_t integer = digits/INTEGER_SCALES[decimals];
+  uint64_t fraction = digits%INTEGER_SCALES[decimals];
+
+  // The digits backwards, then reversed
+  char reversed[32];
+  size_t length = 0;
+  for(int digit = 0; digit < decimals; ++digit)
+  {
+    reversed[length++] = '0' + fraction%10;
+    fraction /= 10;
+  }
+  reversed[length++] = '.';
+  do
+  {
+    reversed[length++] = '0' + integer%10;
+    integer /= 10;
+  } while(integer > 0);
+  if(signbit(value))
+  {
+    reversed[length++] = '-';
+  }
+
+  for(size_t k = 0; k < length; ++k)
+  {
+    buffer[k] = reversed[length - 1 - k];
+  }
+
+  return length;
+}
+
+template <class Calculator>
+void LoanSweep::calculateTile(Calculator &calculator,
+                              size_t chunkRow,
+                              size_t firstRow, size_t lastRow,
+                              size_t firstColumn, size_t lastColumn)
+{
+  const size_t numAxes = axes_.size();
+  const LoanSweepAxis &lastAxis = axes_[numAxes - 1];
+  const size_t numColumns = lastAxis.count;
+
+  // The fields of each row of the tile, all but those of the last axis
+  double rowValues[TILE_SIZE][LOAN_RECORD_FIELDS];
+  for(size_t row = firstRow; row < lastRow; ++row)
+  {
+    double *values = rowValues[row - firstRow];
+    for(int field = 0; field < LOAN_RECORD_FIELDS; ++field)
+    {
+      values[field] = values_[field];
+    }
+
+    size_t index = chunkRow + row;
+    for(size_t axis = numAxes - 1; axis-- > 0; )
+    {
+      values[axes_[axis].field] = axes_[axis].getValue(index%axes_[axis].count);
+      index /= axes_[axis].count;
+    }
+  }
+
+  // Down the columns if the last axis changes the factors, else along the rows
+  bool byColumn = isFactorField(lastAxis.field);
+  size_t outerFirst = (byColumn ? firstColumn : firstRow);
+  size_t outerLast = (byColumn ? lastColumn : lastRow);
+  size_t innerFirst = (byColumn ? firstRow : firstColumn);
+  size_t innerLast = (byColumn ? lastRow : lastColumn);
+
+  // The results of the tile, by row then column, copied to the chunk
+  // once it is complete, so traversing by column doesnt write all over it
+  double tileResults[LOAN_RECORD_MAX_RESULTS][TILE_SIZE*TILE_SIZE];
+  uint8_t tileStatus[TILE_SIZE*TILE_SIZE];
+
+  double values[LOAN_RECORD_FIELDS];
+  double results[LOAN_RECORD_MAX_RESULTS];
+
+  for(size_t outer = outerFirst; outer < outerLast; ++outer)
+  {
+    for(size_t inner = innerFirst; inner < innerLast; ++inner)
+    {
+      size_t row = (byColumn ? inner : outer);
+      size_t column = (byColumn ? outer : inner);
+      size_t point = (row - firstRow)*TILE_SIZE + (column - firstColumn);
+
+      const double *tileValues = rowValues[row - firstRow];
+      for(int field = 0; field < LOAN_RECORD_FIELDS; ++field)
+      {
+        values[field] = tileValues[field];
+      }
+      values[lastAxis.field] = lastAxis.getValue(column);
+
+      try
+      {
+        calculateLoanRecord(calcType_, calculator, values, results);
+        for(int result = 0; result < numResults_; ++result)
+        {
+          tileResults[result][point] = results[result];
+        }
+        tileStatus[point] = 0;
+      }
+      catch(const exception &)
+      {
+        for(int result = 0; result < numResults_; ++result)
+        {
+          tileResults[result][point] = NAN;
+        }
+        tileStatus[point] = 1;
+      }
+    }
+  }
+
+  size_t numTileColumns = lastColumn - firstColumn;
+  for(size_t row = firstRow; row < lastRow; ++row)
+  {
+    size_t point = row*numColumns + firstColumn;
+    size_t tilePoint = (row - firstRow)*TILE_SIZE;
+    for(int result = 0; result < numResults_; ++result)
+    {
+      memcpy(&results_[result][point], &tileResults[result][tilePoint], numTileColumns*sizeof(double));
+    }
+    memcpy(&status_[point], &tileStatus[tilePoint], numTileColumns);
+  }
+}
+
+void LoanSweep::formatRows(size_t chunkRow, size_t firstRow, size_t lastRow, string &text) const
+{
+  const size_t numAxes = axes_.size();
+  const vector<uint32_t> columns(LoanBulk::getResultColumns(calcType_));
+  const size_t numColumns = axes_[numAxes - 1].count;
+  const vector<string> &lastText = axisText_[numAxes - 1];
+
+  string prefix;
+  vector<size_t> indexes(numAxes);
+  char buffer[128];
+
+  for(size_t row = firstRow; row < lastRow; ++row)
+  {
+    // The values of the axes but the last, the same for the whole row
+    size_t index = chunkRow + row;
+    for(size_t axis = numAxes - 1; axis-- > 0; )
+    {
+      indexes[axis] = index%axes_[axis].count;
+      index /= axes_[axis].count;
+    }
+
+    prefix.clear();
+    for(size_t axis = 0; axis + 1 < numAxes; ++axis)
+    {
+      prefix.append(axisText_[axis][indexes[axis]]).append(",");
+    }
+
+    for(size_t column = 0; column < numColumns; ++column)
+    {
+      size_t point = row*numColumns + column;
+      text.append(prefix).append(lastText[column]);
+
+      if(status_[point] != 0)
+      {
+        text.append(",error\n");
+        continue;
+      }
+
+      // Rates with 4 decimals, money and number of payments with 2, as the bulk mode
+      size_t length = 0;
+      for(size_t c = 0; c < columns.size(); ++c)
+      {
+        buffer[length++] = ',';
+        length += formatFixed(buffer + length, results_[c][point], (columns[c] == COLUMN_RATE ? 4 : 2));
+      }
+      buffer[length++] = '\n';
+      text.append(buffer, length);
+    }
+  }
+}
+
+template <class Calculator>
+size_t LoanSweep::calculateAll(ostream *os, LoanColumnWriter *writer)
+{
+  const vector<uint32_t> columns(LoanBulk::getResultColumns(calcType_));
+  numResults_ = columns.size();
+
+  if(writer != NULL)
+  {
+    writer->writeHeader(columns);
+  }
+  else
+  {
+    for(size_t axis = 0; axis < axes_.size(); ++axis)
+    {
+      *os << FIELD_NAMES[axes_[axis].field] << ",";
+    }
+    for(size_t c = 0; c < columns.size(); ++c)
+    {
+      *os << (c == 0 ? "" : ",") << getLoanColumnName(columns[c]);
+    }
+    *os << "\n";
+  }
+
+  const size_t numColumns = axes_.back().count;
+  const size_t numRows = getNumPoints()/numColumns;
+
+  // Whole tiles of rows per chunk, unless a single row is more than a chunk
+  size_t chunkRows = max(CHUNK_POINTS/numColumns, (size_t) 1);
+  if(chunkRows > TILE_SIZE)
+  {
+    chunkRows -= chunkRows%TILE_SIZE;
+  }
+
+  size_t errors = 0;
+  for(size_t chunkRow = 0; chunkRow < numRows; chunkRow += chunkRows)
+  {
+    size_t rows = min(chunkRows, numRows - chunkRow);
+    size_t points = rows*numColumns;
+    for(int result = 0; result < numResults_; ++result)
+    {
+      results_[result].resize(points);
+    }
+    status_.resize(points);
+
+    size_t tileRows = (rows + TILE_SIZE - 1)/TILE_SIZE;
+    size_t tileColumns = (numColumns + TILE_SIZE - 1)/TILE_SIZE;
+
+    pool_.parallelFor(tileRows*tileColumns, [&] (size_t begin, size_t end, int)
+    {
+      // Each thread has its own calculator, with its own derived values
+      Calculator calculator;
+      calculator.setRateTable(rateTable_);
+
+      for(size_t tile = begin; tile < end; ++tile)
+      {
+        size_t firstRow = (tile/tileColumns)*TILE_SIZE;
+        size_t firstColumn = (tile%tileColumns)*TILE_SIZE;
+        calculateTile(calculator, chunkRow,
+                      firstRow, min(firstRow + TILE_SIZE, rows),
+                      firstColumn, min(firstColumn + TILE_SIZE, numColumns));
+      }
+    });
+
+    for(size_t point = 0; point < points; ++point)
+    {
+      errors += status_[point];
+    }
+
+    if(writer != NULL)
+    {
+      writer->beginBlock(points);
+      for(int result = 0; result < numResults_; ++result)
+      {
+        writer->addColumnData(results_[result].data(), points*sizeof(double));
+        writer->endColumn();
+      }
+      writer->addColumnData(status_.data(), points);
+      writer->endColumn();
+      writer->endBlock();
+    }
+    else
+    {
+      // The ranges are in order, so are the buffers
+      for(size_t thread = 0; thread < text_.size(); ++thread)
+      {
+        text_[thread].clear();
+      }
+      pool_.parallelFor(rows, [&] (size_t begin, size_t end, int thread)
+      {
+        formatRows(chunkRow, begin, end, text_[thread]);
+      });
+      for(size_t thread = 0; thread < text_.size(); ++thread)
+      {
+        os->write(text_[thread].data(), text_[thread].size());
+      }
+    }
+  }
+
+  if(os != NULL)
+  {
+    os->flush();
+  }
+
+  return errors;
+}
+
+void LoanSweep::checkSweep() const
+{
+  if(calcType_ == CALC_SCHEDULE)
+  {
+    throw invalid_argument("The amortization schedule cant be swept");
+  }
+  if(calcType_ == CALC_UNKNOWN)
+  {
+    throw invalid_argument("Must set the calculation type for a sweep");
+  }
+  if(axes_.empty())
+  {
+    throw invalid_argument("Must set at least one range for a sweep");
+  }
+}
+
+size_t LoanSweep::calculate(ostream &os)
+{
+  checkSweep();
+
+  if(precision_ == LoanBulk::PRECISION_CENTS)
+  {
+    return calculateAll<LoanCalculatorCents>(&os, NULL);
+  }
+  else if(precision_ == LoanBulk::PRECISION_DOUBLE)
+  {
+    return calculateAll<LoanCalculatorDouble>(&os, NULL);
+  }
+
+  return calculateAll<LoanCalculator>(&os, NULL);
+}
+
+size_t LoanSweep::calculate(LoanColumnWriter &writer)
+{
+  checkSweep();
+
+  if(precision_ == LoanBulk::PRECISION_CENTS)
+  {
+    return calculateAll<LoanCalculatorCents>(NULL, &writer);
+  }
+  else if(precision_ == LoanBulk::PRECISION_DOUBLE)
+  {
+    return calculateAll<LoanCalculatorDouble>(NULL, &writer);
+  }
+
+  return calculateAll<LoanCalculator>(NULL, &writer);
+}
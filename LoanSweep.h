@@ -0,0 +1,147 @@
+#ifndef LOANSWEEP_H_INCLUDED
+#define LOANSWEEP_H_INCLUDED
+
+/*
+Parameter sweep, calculates one loan per point of the Cartesian grid of
+ranges of any of the fields of a loan record (LoanRecord.h), the other
+fields keeping the values set with setValues(), with a LoanThreadPool.
+
+The results form a tensor, with one dimension per axis in the order the
+axes were added, the last axis varying fastest, as in a C array:
+  point = ((i0*count1 + i1)*count2 + i2)...
+
+The tensor is seen as rows of the points of the last axis, and calculated
+in chunks of whole rows, each chunk in tiles of TILE_SIZE x TILE_SIZE
+points spread over the threads. The calculator only calculates (1+i)^N
+and (1+i)^n again when the rate or the periods change, see
+LoanCalculator.h, so a tile is traversed with the fields those depend on
+changing as rarely as possible: along the rows, or down the columns if
+the last axis is the rate or one of the periods. The results of a tile
+stay in the cache until it has been traversed.
+
+The results are written in tensor order, as CSV, one line per point with
+the values of the axes and the results, after a header line with their
+names, or to a column file, see LoanColumnFile.h, one block per chunk with
+the result columns only. A point that cant be calculated has "error" in
+place of its results, or NaN and a status of 1 in a column file.
+*/
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "LoanBulk.h"
+#include "LoanCalcType.h"
+#include "LoanColumnFile.h"
+#include "LoanRecord.h"
+#include "LoanThreadPool.h"
+
+class LoanRateTable;
+
+struct LoanSweepAxis
+{
+  int field;       // of LoanRecord.h
+  double first;
+  double step;
+  size_t count;
+
+  inline double getValue(size_t index) const { return first + index*step; }
+};
+
+class LoanSweep
+{
+public:
+  static const size_t TILE_SIZE = 64;
+
+  /**
+   * numThreads <= 0 uses one thread per core
+   */
+  LoanSweep(CALC_TYPE calcType, LoanBulk::PRECISION precision, int numThreads);
+  ~LoanSweep() {}
+
+  /**
+   * The values of the fields that arent swept, 0.0 by default
+   */
+  void setValues(const double values[LOAN_RECORD_FIELDS]);
+
+  /**
+   * Sweep field from first to last, inclusive, in steps of step. Throws
+   * invalid_argument if the field is already swept or the range is empty
+   */
+  void addAxis(int field, double first, double last, double step);
+
+  inline const std::vector<LoanSweepAxis> &getAxes() const { return axes_; }
+
+  // The number of points of the grid, 0 if there are no axes
+  size_t getNumPoints() const;
+
+  inline int getNumThreads() const { return pool_.getNumThreads(); }
+
+  /**
+   * Calculate the points on the grid of table with its factors, see
+   * LoanCalculator::setRateTable(), NULL by default
+   */
+  inline void setRateTable(const LoanRateTable *table) { rateTable_ = table; }
+
+  /**
+   * Calculate all of the points and write them to os as CSV. Returns the
+   * number of points that could not be calculated. Throws invalid_argument
+   * if the calculation type cant be swept or there are no axes
+   */
+  size_t calculate(std::ostream &os);
+
+  /**
+   * As above, writing the header and the results to a column file
+   * already opened. Throws runtime_error if the file cant be written
+   */
+  size_t calculate(LoanColumnWriter &writer);
+
+  // The name of a field of LoanRecord.h, as in "interest"
+  static const char *getFieldName(int field);
+
+private:
+  LoanSweep(); // Cant initialize default version
+  LoanSweep(const LoanSweep &);
+  LoanSweep &operator=(const LoanSweep &);
+
+  void checkSweep() const;
+
+  // Either os or writer is set
+  template <class Calculator>
+  size_t calculateAll(std::ostream *os, LoanColumnWriter *writer);
+
+  // Calculate the points of rows [firstRow, lastRow) and columns
+  // [firstColumn, lastColumn) of the chunk starting at row chunkRow
+  template <class Calculator>
+  void calculateTile(Calculator &calculator,
+                     size_t chunkRow,
+                     size_t firstRow, size_t lastRow,
+                     size_t firstColumn, size_t lastColumn);
+
+  // Append the CSV lines of rows [firstRow, lastRow) of the chunk starting at row chunkRow
+  void formatRows(size_t chunkRow, size_t firstRow, size_t lastRow, std::string &text) const;
+
+  CALC_TYPE calcType_;
+  LoanBulk::PRECISION precision_;
+  LoanThreadPool pool_;
+  const LoanRateTable *rateTable_;
+
+  double values_[LOAN_RECORD_FIELDS];
+  std::vector<LoanSweepAxis> axes_;
+
+  // The values of each axis formatted for the CSV output
+  std::vector<std::vector<std::string> > axisText_;
+
+  // The results of the current chunk, by point of the chunk
+  int numResults_;
+  std::vector<double> results_[LOAN_RECORD_MAX_RESULTS];
+  std::vector<uint8_t> status_;
+
+  // Per thread CSV text, reused for every chunk
+  std::vector<std::string> text_;
+};
+
+#endif // LOANSWEEP_H_INCLUDED
@@ -0,0 +1,349 @@
+#ifndef LOANTERMS_H_INCLUDED
+#define LOANTERMS_H_INCLUDED
+
+/*
+Stateless version of LoanCalculator: the inputs are a LoanTerms value,
+and each calculation is a free function of const terms returning its
+result by value, so any number of threads can calculate from the same
+terms, and the compiler can inline the calls into a loop over many loans.
+
+The results are those of the calculator with the same inputs set, to the
+bit, but as with calculateLoanRecord() every input is set, 0 by default,
+so none are missing. Nothing is thrown, a result carries a status:
+  LOAN_OK                  value is the result
+  LOAN_INVALID_FREQUENCY   periodsPerYear is less than 1
+  LOAN_NOT_FINITE          value is NaN or infinite, the inputs have no
+                           solution, as with a term of 0
+  LOAN_OUT_OF_RANGE        the amount doesnt fit in LoanCents, value is 0
+  LOAN_UNSUPPORTED_CALCULATION
+                           the calculation type isnt one of a record
+Otherwise the value is set whatever the status, as the calculator would
+return it. The inputs are converted as by the calculator setters, so
+loanRecordTerms() still throws for cents out of range, and so do the exact
+multiplications of LoanCents near its limits.
+
+The calculator remains for the rate tables, the rate schedules, the
+derived values reused from one calculation to the next and the stats of
+LoanStats.h, none of which are used here: each call calculates its pow(),
+and the interest rate is solved by LoanRateSolver::solveRate(), uncounted.
+*/
+
+#include <math.h>
+
+#include "LoanCalcType.h"
+#include "LoanFormulas.h"
+#include "LoanNumericPolicy.h"
+#include "LoanRateSolver.h"
+#include "LoanRecord.h"
+
+enum LOAN_STATUS
+{
+  LOAN_OK=0,
+  LOAN_INVALID_FREQUENCY,
+  LOAN_NOT_FINITE,
+  LOAN_OUT_OF_RANGE,
+  LOAN_UNSUPPORTED_CALCULATION
+};
+
+template <class T>
+struct LoanResult
+{
+  T value;
+  LOAN_STATUS status;
+
+  inline bool isOk() const { return status == LOAN_OK; }
+};
+
+/**
+ * The inputs of BasicLoanCalculator, see its setters in LoanCalculator.h
+ */
+template <class Policy>
+struct BasicLoanTerms
+{
+  typedef Policy NumericPolicy;
+  typedef typename Policy::Money Money;
+  typedef typename Policy::Real Real;
+
+  BasicLoanTerms() :
+    amount(),
+    initialPayment(),
+    interest(),
+    periodsPerYear(LOAN_MONTHLY),
+    payment(),
+    periodTotal(0),
+    periodElapsed(0),
+    openingFee(),
+    openingPercent()
+  {
+  }
+
+  Money amount;          // loan amount A
+  Money initialPayment;
+  Real interest;         // yearly, as 6.75
+  int periodsPerYear;    // LOAN_MONTHLY by default
+  Money payment;         // payment P
+  int periodTotal;       // total payment periods N
+  int periodElapsed;     // elapsed payment periods n
+  Money openingFee;
+  Real openingPercent;
+
+  // As 0.0675/12, in Real as the calculator stores it
+  inline Real getPeriodicInterest() const { return interest/100.0/periodsPerYear; }
+};
+
+typedef BasicLoanTerms<LoanFloatPolicy>  LoanTerms;
+typedef BasicLoanTerms<LoanDoublePolicy> LoanTermsDouble;
+typedef BasicLoanTerms<LoanCentsPolicy>  LoanTermsCents;
+
+/**
+ * The terms of a loan record, see LoanRecord.h
+ */
+template <class Policy>
+inline BasicLoanTerms<Policy> loanRecordTerms(const double values[LOAN_RECORD_FIELDS])
+{
+  BasicLoanTerms<Policy> terms;
+  terms.amount         = Policy::fromDouble(values[0]);
+  terms.interest       = values[1];
+  terms.periodTotal    = (int) values[2];
+  terms.payment        = Policy::fromDouble(values[3]);
+  terms.periodElapsed  = (int) values[4];
+  terms.initialPayment = Policy::fromDouble(values[5]);
+  terms.openingFee     = Policy::fromDouble(values[6]);
+  terms.openingPercent = values[7];
+  return terms;
+}
+
+//
+// The results, the status of the value as calculated in double, or as
+// converted to Money or Real, which may overflow a float
+//
+
+template <class Policy>
+inline LoanResult<typename Policy::Money> loanMoneyResult(double value)
+{
+  LoanResult<typename Policy::Money> result;
+  if(!Policy::isInRange(value))
+  {
+    result.value = typename Policy::Money();
+    result.status = (isfinite(value) ? LOAN_OUT_OF_RANGE : LOAN_NOT_FINITE);
+    return result;
+  }
+
+  result.value = Policy::fromDouble(value);
+  result.status = (isfinite(Policy::toDouble(result.value)) ? LOAN_OK : LOAN_NOT_FINITE);
+  return result;
+}
+
+template <class Real>
+inline LoanResult<Real> loanRealResult(Real value)
+{
+  LoanResult<Real> result;
+  result.value = value;
+  result.status = (isfinite(value) ? LOAN_OK : LOAN_NOT_FINITE);
+  return result;
+}
+
+/**
+ * The message of status, NULL if LOAN_OK
+ */
+inline const char *getLoanStatusMessage(LOAN_STATUS status)
+{
+  switch(status)
+  {
+    case LOAN_OK:                      return NULL;
+    case LOAN_INVALID_FREQUENCY:       return "Number of payments per year must be at least 1";
+    case LOAN_NOT_FINITE:              return "Result out of range";
+    case LOAN_OUT_OF_RANGE:            return "Loan amount out of range of the fixed point cents type";
+    case LOAN_UNSUPPORTED_CALCULATION: return "Unsupported calculation type for a loan record";
+  }
+
+  return "Invalid loan";
+}
+
+template <class T>
+inline LoanResult<T> loanInvalidResult(LOAN_STATUS status)
+{
+  LoanResult<T> result;
+  result.value = T();
+  result.status = status;
+  return result;
+}
+
+//
+// The calculations, as those of the calculator of the same name
+//
+
+/**
+ * The amount financed: amount - initial payment + opening fees
+ */
+template <class Policy>
+inline typename Policy::Money loanFinancedAmount(const BasicLoanTerms<Policy> &terms)
+{
+  typename Policy::Money totalAmount = terms.amount - terms.initialPayment;
+  return totalAmount + terms.openingFee + Policy::percentOf(totalAmount, terms.openingPercent);
+}
+
+/**
+ * Loan balance after n payments have been made:
+ *   B_n = A*(1+i)^n - (P/i)*((1+i)^n - 1)
+ */
+template <class Policy>
+inline LoanResult<typename Policy::Money> loanBalance(const BasicLoanTerms<Policy> &terms)
+{
+  if(terms.periodsPerYear < 1)
+  {
+    return loanInvalidResult<typename Policy::Money>(LOAN_INVALID_FREQUENCY);
+  }
+
+  typename Policy::Real i = terms.getPeriodicInterest();
+  return loanMoneyResult<Policy>(
+           loanBalance(Policy::toDouble(terms.amount), Policy::toDouble(terms.payment), i, terms.periodElapsed,
+                       loanGrowthFactor(i, terms.periodElapsed)));
+}
+
+/**
+ * Payment amount on a loan, of the financed amount:
+ *   P = i*A / (1 - (1+i)^-N)
+ */
+template <class Policy>
+inline LoanResult<typename Policy::Money> loanPayment(const BasicLoanTerms<Policy> &terms)
+{
+  if(terms.periodsPerYear < 1)
+  {
+    return loanInvalidResult<typename Policy::Money>(LOAN_INVALID_FREQUENCY);
+  }
+
+  typename Policy::Real i = terms.getPeriodicInterest();
+  return loanMoneyResult<Policy>(
+           loanPayment(Policy::toDouble(loanFinancedAmount(terms)), i, terms.periodTotal,
+                       loanGrowthFactor(i, -1*terms.periodTotal)));
+}
+
+/**
+ * Number of payments on a loan:
+ *   N = -log(1-i*A/P) / log(1+i)
+ */
+template <class Policy>
+inline LoanResult<typename Policy::Real> loanNumberPayments(const BasicLoanTerms<Policy> &terms)
+{
+  typedef typename Policy::Real Real;
+
+  if(terms.periodsPerYear < 1)
+  {
+    return loanInvalidResult<Real>(LOAN_INVALID_FREQUENCY);
+  }
+
+  return loanRealResult<Real>(
+           loanNumberPayments(Policy::toDouble(terms.amount), Policy::toDouble(terms.payment),
+                              terms.getPeriodicInterest()));
+}
+
+/**
+ * Original loan amount:
+ *   A = (P/i)*(1 - (1+i)^-N)
+ */
+template <class Policy>
+inline LoanResult<typename Policy::Money> loanAmount(const BasicLoanTerms<Policy> &terms)
+{
+  if(terms.periodsPerYear < 1)
+  {
+    return loanInvalidResult<typename Policy::Money>(LOAN_INVALID_FREQUENCY);
+  }
+
+  typename Policy::Real i = terms.getPeriodicInterest();
+  return loanMoneyResult<Policy>(
+           loanAmount(Policy::toDouble(terms.payment), i, terms.periodTotal, loanGrowthFactor(i, -1*terms.periodTotal)));
+}
+
+/**
+ * Yearly interest rate, solving P = i*A / (1 - (1+i)^-N) for i
+ */
+template <class Policy>
+inline LoanResult<typename Policy::Real> loanInterestRate(const BasicLoanTerms<Policy> &terms)
+{
+  typedef typename Policy::Real Real;
+
+  if(terms.periodsPerYear < 1)
+  {
+    return loanInvalidResult<Real>(LOAN_INVALID_FREQUENCY);
+  }
+
+  int iterations;
+  Real periodicInterest = LoanRateSolver::solveRate(Policy::toDouble(terms.amount), Policy::toDouble(terms.payment),
+                                                    terms.periodTotal, iterations);
+  return loanRealResult<Real>(periodicInterest*terms.periodsPerYear*100);
+}
+
+/**
+ * The effective interest rate, the rate of the payment of the financed
+ * amount on the amount less the initial payment
+ */
+template <class Policy>
+inline LoanResult<typename Policy::Real> loanEffectiveInterestRate(const BasicLoanTerms<Policy> &terms)
+{
+  typedef typename Policy::Real Real;
+
+  LoanResult<typename Policy::Money> payment = loanPayment(terms);
+  if(payment.status == LOAN_INVALID_FREQUENCY)
+  {
+    return loanInvalidResult<Real>(payment.status);
+  }
+
+  int iterations;
+  Real periodicInterest = LoanRateSolver::solveRate(Policy::toDouble(terms.amount - terms.initialPayment),
+                                                    Policy::toDouble(payment.value), terms.periodTotal, iterations);
+  return loanRealResult<Real>(periodicInterest*terms.periodsPerYear*100);
+}
+
+/**
+ * As calculateLoanRecord(), with no calculator. Returns the number of
+ * results, and sets status to that of the results
+ */
+template <class Policy>
+inline int calculateLoanTerms(CALC_TYPE calcType,
+                              const BasicLoanTerms<Policy> &terms,
+                              double results[LOAN_RECORD_MAX_RESULTS],
+                              LOAN_STATUS &status)
+{
+  if(calcType == CALC_BALANCE)
+  {
+    LoanResult<typename Policy::Money> balance = loanBalance(terms);
+    results[0] = Policy::toDouble(balance.value);
+    status = balance.status;
+    return 1;
+  }
+  else if(calcType == CALC_PAYMENT)
+  {
+    LoanResult<typename Policy::Money> payment = loanPayment(terms);
+    results[0] = Policy::toDouble(payment.value);
+    results[1] = Policy::toDouble(payment.value*terms.periodTotal);
+    status = payment.status;
+    return 2;
+  }
+  else if(calcType == CALC_NUMPAYMENTS)
+  {
+    LoanResult<typename Policy::Real> numberPayments = loanNumberPayments(terms);
+    results[0] = numberPayments.value;
+    status = numberPayments.status;
+    return 1;
+  }
+  else if(calcType == CALC_AMOUNT)
+  {
+    LoanResult<typename Policy::Money> amount = loanAmount(terms);
+    results[0] = Policy::toDouble(amount.value);
+    status = amount.status;
+    return 1;
+  }
+  else if(calcType == CALC_INTEREST)
+  {
+    LoanResult<typename Policy::Real> interest = loanInterestRate(terms);
+    results[0] = interest.value;
+    status = interest.status;
+    return 1;
+  }
+
+  status = LOAN_UNSUPPORTED_CALCULATION;
+  return 0;
+}
+
+#endif // LOANTERMS_H_INCLUDED
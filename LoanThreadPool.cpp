@@ -0,0 +1,118 @@
+
+#include "LoanThreadPool.h"
+
+using namespace std;
+
+LoanThreadPool::LoanThreadPool(int numThreads) :
+  numThreads_(numThreads > 0 ? numThreads : getHardwareThreads()),
+  task_(NULL),
+  count_(0),
+  generation_(0),
+  pending_(0),
+  stop_(false)
+{
+  // Thread 0 is the thread calling parallelFor()
+  for(int thread = 1; thread < numThreads_; ++thread)
+  {
+    threads_.push_back(std::thread(&LoanThreadPool::workerLoop, this, thread));
+  }
+}
+
+LoanThreadPool::~LoanThreadPool()
+{
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+  }
+  startCondition_.notify_all();
+
+  for(size_t i = 0; i < threads_.size(); ++i)
+  {
+    threads_[i].join();
+  }
+}
+
+int LoanThreadPool::getHardwareThreads()
+{
+  unsigned int cores = std::thread::hardware_concurrency();
+  return (cores == 0 ? 1 : (int) cores);
+}
+
+void LoanThreadPool::parallelFor(size_t count, const RangeTask &task)
+{
+  if(count == 0)
+  {
+    return;
+  }
+
+  {
+    lock_guard<mutex> lock(mutex_);
+    task_ = &task;
+    count_ = count;
+    pending_ = numThreads_ - 1;
+    error_ = exception_ptr();
+    ++generation_;
+  }
+  startCondition_.notify_all();
+
+  runRange(0);
+
+  unique_lock<mutex> lock(mutex_);
+  doneCondition_.wait(lock, [this] { return pending_ == 0; });
+  task_ = NULL;
+
+  if(error_)
+  {
+    exception_ptr error = error_;
+    error_ = exception_ptr();
+    rethrow_exception(error);
+  }
+}
+
+void LoanThreadPool::runRange(int thread)
+{
+  size_t begin = count_ * thread / numThreads_;
+  size_t end = count_ * (thread+1) / numThreads_;
+
+  try
+  {
+    if(begin < end)
+    {
+      (*task_)(begin, end, thread);
+    }
+  }
+  catch(...)
+  {
+    lock_guard<mutex> lock(mutex_);
+    if(!error_)
+    {
+      error_ = current_exception();
+    }
+  }
+}
+
+void LoanThreadPool::workerLoop(int thread)
+{
+  unsigned long lastGeneration = 0;
+
+  while(true)
+  {
+    {
+      unique_lock<mutex> lock(mutex_);
+      startCondition_.wait(lock, [&] { return stop_ || generation_ != lastGeneration; });
+      if(stop_)
+      {
+        return;
+      }
+      lastGeneration = generation_;
+    }
+
+    runRange(thread);
+
+    {
+      lock_guard<mutex> lock(mutex_);
+      --pending_;
+    }
+    doneCondition_.notify_one();
+  }
+}
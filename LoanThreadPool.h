@@ -0,0 +1,68 @@
+#ifndef LOANTHREADPOOL_H_INCLUDED
+#define LOANTHREADPOOL_H_INCLUDED
+
+/*
+Fixed size thread pool, used to split bulk calculations across cores.
+
+The threads are started once, in the constructor, and are reused by every
+call to parallelFor(). The calling thread takes part in the work as
+thread 0, so a pool of 1 thread starts no extra threads at all.
+*/
+
+#include <cstddef>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class LoanThreadPool
+{
+public:
+  typedef std::function<void(size_t begin, size_t end, int thread)> RangeTask;
+
+  /**
+   * numThreads <= 0 uses one thread per core
+   */
+  LoanThreadPool(int numThreads);
+  ~LoanThreadPool();
+
+  inline int getNumThreads() const { return numThreads_; }
+
+  /**
+   * Split [0, count) into numThreads contiguous ranges, in order, so thread
+   * t always gets a range before thread t+1, and call task(begin, end, t)
+   * for each of them. Returns once all of the ranges have been processed.
+   * If a task throws, the first exception is rethrown here.
+   */
+  void parallelFor(size_t count, const RangeTask &task);
+
+  // The number of cores, at least 1
+  static int getHardwareThreads();
+
+private:
+  LoanThreadPool(); // Cant initialize default version
+  LoanThreadPool(const LoanThreadPool &);
+  LoanThreadPool &operator=(const LoanThreadPool &);
+
+  void workerLoop(int thread);
+  void runRange(int thread);
+
+  int numThreads_;
+  std::vector<std::thread> threads_;
+
+  std::mutex mutex_;
+  std::condition_variable startCondition_;
+  std::condition_variable doneCondition_;
+
+  // The current parallelFor(), guarded by mutex_
+  const RangeTask *task_;
+  size_t count_;
+  unsigned long generation_;
+  int pending_;
+  bool stop_;
+  std::exception_ptr error_;
+};
+
+#endif // LOANTHREADPOOL_H_INCLUDED
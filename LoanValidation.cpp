@@ -0,0 +1,183 @@
+
+#include <string.h>
+
+#include "LoanValidation.h"
+#include "LoanVector.h"
+
+uint32_t getLoanRecordChecks(CALC_TYPE calcType)
+{
+  if(calcType == CALC_BALANCE)
+  {
+    return LOAN_CHECK_RATE | LOAN_CHECK_ELAPSED;
+  }
+  else if(calcType == CALC_PAYMENT || calcType == CALC_AMOUNT)
+  {
+    return LOAN_CHECK_RATE | LOAN_CHECK_TERM;
+  }
+  else if(calcType == CALC_NUMPAYMENTS)
+  {
+    return LOAN_CHECK_RATE | LOAN_CHECK_PAYOFF;
+  }
+  else if(calcType == CALC_INTEREST)
+  {
+    return LOAN_CHECK_TERM | LOAN_CHECK_POSITIVE;
+  }
+
+  return 0;
+}
+
+//
+// 2 records at a time, in the vectors of LoanVector.h, one SSE2 instruction
+// per operation on x86_64. The checks are and'ed and or'ed as masks
+//
+
+static const int LANES = 2;
+
+static LOAN_VECTOR_INLINE Double2 load2(const double *values)
+{
+  Double2 v;
+  memcpy(&v, values, sizeof(v));
+  return v;
+}
+
+static LOAN_VECTOR_INLINE Double2 broadcast2(double value)
+{
+  Double2 v = {value, value};
+  return v;
+}
+
+// |x| <= max, false for NaN
+static LOAN_VECTOR_INLINE Mask2 isWithin2(Double2 x, Double2 max)
+{
+  return (x <= max) & (x >= -max);
+}
+
+// The flag in the lanes where valid is false
+static LOAN_VECTOR_INLINE Mask2 flagIfNot2(Mask2 valid, long long flag)
+{
+  return ~valid & flag;
+}
+
+static LOAN_VECTOR_INLINE void validate2(uint32_t checks,
+                                             double maxAmount,
+                                             const double *const fields[LOAN_RECORD_FIELDS],
+                                             size_t k,
+                                             uint8_t *invalid)
+{
+  // The bits of the checks not done are masked out, rather than skipped
+  const long long rateMask     = ((checks & LOAN_CHECK_RATE) ? LOAN_INVALID_RATE : 0);
+  const long long termMask     = ((checks & LOAN_CHECK_TERM) ? LOAN_INVALID_TERM : 0);
+  const long long elapsedMask  = ((checks & LOAN_CHECK_ELAPSED) ? LOAN_INVALID_ELAPSED : 0);
+  const long long payoffMask   = ((checks & LOAN_CHECK_PAYOFF) ? LOAN_INVALID_PAYOFF : 0);
+  const long long positiveMask = ((checks & LOAN_CHECK_POSITIVE) ? LOAN_INVALID_NOT_POSITIVE : 0);
+
+  const Double2 zero = broadcast2(0.0);
+  const Double2 maxMoney = broadcast2(maxAmount);
+  // The periods are cast to int
+  const Double2 maxPeriod = broadcast2(2147483647.0);
+
+  Double2 amount         = load2(fields[0] + k);
+  Double2 interest       = load2(fields[1] + k);
+  Double2 periodTotal    = load2(fields[2] + k);
+  Double2 payment        = load2(fields[3] + k);
+  Double2 periodElapsed  = load2(fields[4] + k);
+  Double2 initialPayment = load2(fields[5] + k);
+  Double2 openingFee     = load2(fields[6] + k);
+  Double2 openingPercent = load2(fields[7] + k);
+
+  Double2 i = interest/100.0/(double) LOAN_MONTHLY;
+
+  Mask2 amounts = isWithin2(amount, maxMoney) & isWithin2(initialPayment, maxMoney) &
+                  isWithin2(openingFee, maxMoney) & isWithin2(openingPercent, maxMoney);
+  Mask2 rate = (i > broadcast2(-1.0)) & (i <= maxMoney);
+  Mask2 term = (periodTotal >= broadcast2(1.0)) & (periodTotal <= maxPeriod);
+  Mask2 elapsed = (periodElapsed >= zero) & (periodElapsed <= maxPeriod);
+  Mask2 payoff = (payment > zero) & (i*amount < payment);
+  Mask2 positive = (amount > zero) & (payment > zero);
+
+  Mask2 flags = flagIfNot2(amounts, LOAN_INVALID_AMOUNT) |
+                flagIfNot2(isWithin2(payment, maxMoney), LOAN_INVALID_PAYMENT) |
+                flagIfNot2(rate, rateMask) |
+                flagIfNot2(term, termMask) |
+                flagIfNot2(elapsed, elapsedMask) |
+                flagIfNot2(payoff, payoffMask) |
+                flagIfNot2(positive, positiveMask);
+
+  for(int lane = 0; lane < LANES; ++lane)
+  {
+    invalid[lane] |= (uint8_t) flags[lane];
+  }
+}
+
+void validateLoanRecords(uint32_t checks,
+                         double maxAmount,
+                         size_t count,
+                         const double *const fields[LOAN_RECORD_FIELDS],
+                         uint8_t *invalid)
+{
+  size_t k = 0;
+  for(; k + LANES <= count; k += LANES)
+  {
+    validate2(checks, maxAmount, fields, k, invalid + k);
+  }
+
+  // The last record, padded
+  if(k < count)
+  {
+    double tail[LOAN_RECORD_FIELDS][LANES];
+    const double *tailFields[LOAN_RECORD_FIELDS];
+    uint8_t tailInvalid[LANES] = {0};
+    for(int field = 0; field < LOAN_RECORD_FIELDS; ++field)
+    {
+      for(int lane = 0; lane < LANES; ++lane)
+      {
+        tail[field][lane] = (k + lane < count ? fields[field][k + lane] : 0.0);
+      }
+      tailFields[field] = tail[field];
+    }
+
+    validate2(checks, maxAmount, tailFields, 0, tailInvalid);
+    for(size_t lane = 0; k + lane < count; ++lane)
+    {
+      invalid[k + lane] |= tailInvalid[lane];
+    }
+  }
+}
+
+const char *getLoanInvalidMessage(uint8_t invalid)
+{
+  if(invalid & LOAN_INVALID_RECORD)
+  {
+    return "Invalid record";
+  }
+  else if(invalid & LOAN_INVALID_AMOUNT)
+  {
+    return "Amount, initial payment or opening fee out of range";
+  }
+  else if(invalid & LOAN_INVALID_RATE)
+  {
+    return "Interest rate out of range";
+  }
+  else if(invalid & LOAN_INVALID_TERM)
+  {
+    return "Total period must be at least 1";
+  }
+  else if(invalid & LOAN_INVALID_ELAPSED)
+  {
+    return "Elapsed period must not be negative";
+  }
+  else if(invalid & LOAN_INVALID_PAYMENT)
+  {
+    return "Payment out of range";
+  }
+  else if(invalid & LOAN_INVALID_PAYOFF)
+  {
+    return "Payment too small to pay off the loan";
+  }
+  else if(invalid & LOAN_INVALID_NOT_POSITIVE)
+  {
+    return "Amount and payment must be more than 0";
+  }
+
+  return NULL;
+}
@@ -0,0 +1,79 @@
+#ifndef LOANVALIDATION_H_INCLUDED
+#define LOANVALIDATION_H_INCLUDED
+
+/*
+Validation of loan records before they are calculated, see LoanRecord.h,
+so the records that would give NaN, divide by 0 or make the calculator
+throw are reported, and the others are calculated with no checks.
+
+The records are validated in blocks, the fields of a block as one array
+per field, 2 records at a time in vectors, with no branches: every check
+of every record is calculated, and the failures or'ed into a byte of
+LOAN_INVALID bits per record. The checks depend on the calculation type,
+as the formulas of LoanCalculator.h:
+  LOAN_CHECK_RATE      the periodic rate is more than -1, as (1+i)^N, 0%
+                       loans are calculated as in LoanFormulas.h
+  LOAN_CHECK_TERM      the total period is at least 1, as (1+i)^-N
+  LOAN_CHECK_ELAPSED   the elapsed period isnt negative
+  LOAN_CHECK_PAYOFF    the payment is more than the interest of the first
+                       period, as log(1-i*A/P)
+  LOAN_CHECK_POSITIVE  the amount and the payment are positive, for the
+                       rate solver
+and the money amounts and the percentage are always checked to be finite
+and within getMaxAmount() of the numeric policy. The periodic rate is that
+of monthly payments, as a record is.
+*/
+
+#include <stdint.h>
+
+#include <cstddef>
+
+#include "LoanCalcType.h"
+#include "LoanRecord.h"
+
+enum LOAN_INVALID
+{
+  LOAN_VALID=0,
+  LOAN_INVALID_RECORD=1,      // not a record of numbers, set when parsed
+  LOAN_INVALID_AMOUNT=2,
+  LOAN_INVALID_RATE=4,
+  LOAN_INVALID_TERM=8,
+  LOAN_INVALID_ELAPSED=16,
+  LOAN_INVALID_PAYMENT=32,
+  LOAN_INVALID_PAYOFF=64,
+  LOAN_INVALID_NOT_POSITIVE=128
+};
+
+enum LOAN_CHECK
+{
+  LOAN_CHECK_RATE=1,
+  LOAN_CHECK_TERM=2,
+  LOAN_CHECK_ELAPSED=4,
+  LOAN_CHECK_PAYOFF=8,
+  LOAN_CHECK_POSITIVE=16
+};
+
+/**
+ * The LOAN_CHECK bits a record of calcType needs, 0 for the types that
+ * arent calculated from a record
+ */
+uint32_t getLoanRecordChecks(CALC_TYPE calcType);
+
+/**
+ * Validate count records, fields[f][k] being field f of record k. The
+ * failed checks are or'ed into invalid[k], which may already have
+ * LOAN_INVALID_RECORD set, maxAmount is getMaxAmount() of the policy the
+ * records will be calculated with
+ */
+void validateLoanRecords(uint32_t checks,
+                         double maxAmount,
+                         size_t count,
+                         const double *const fields[LOAN_RECORD_FIELDS],
+                         uint8_t *invalid);
+
+/**
+ * The message of the lowest bit set in invalid, NULL if LOAN_VALID
+ */
+const char *getLoanInvalidMessage(uint8_t invalid);
+
+#endif // LOANVALIDATION_H_INCLUDED
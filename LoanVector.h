@@ -0,0 +1,28 @@
+#ifndef LOANVECTOR_H_INCLUDED
+#define LOANVECTOR_H_INCLUDED
+
+/*
+The GCC vector extension types of the vectorized loops of the .cpp files,
+LoanValidation.cpp, LoanSimulation.cpp and LoanMathKernels.cpp. Only
+included by .cpp files, as it turns a warning off for the rest of the
+file.
+
+The vectors are of 16 bytes, one SSE2 register on x86_64, as wider vectors
+are operated on a lane at a time without AVX. A comparison of Double2 gives
+-1 in each lane where it holds, a Mask2. LoanMathKernels.cpp has its own
+wider types, for the kernels compiled for AVX2 and AVX-512.
+*/
+
+#include <stdint.h>
+
+// The vector helpers are static and always inlined, so they never pass
+// vectors across a call boundary and the vector ABI warnings do not apply
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+#define LOAN_VECTOR_INLINE inline __attribute__((always_inline))
+
+typedef double  Double2 __attribute__((vector_size(16)));
+typedef int64_t Mask2   __attribute__((vector_size(16)));
+typedef int32_t Int2    __attribute__((vector_size(8)));
+
+#endif // LOANVECTOR_H_INCLUDED
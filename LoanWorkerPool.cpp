@@ -0,0 +1,414 @@
+
+#include <math.h>
+
+#include <exception>
+#include <stdexcept>
+
+#include "LoanBatch.h"
+#include "LoanCalculator.h"
+#include "LoanCounter.h"
+#include "LoanWorkerPool.h"
+
+using namespace std;
+
+// Empty queue polls before a worker sleeps
+static const int SPIN_COUNT = 64;
+
+// The calculations of a record that LoanBatch calculates too
+static const CALC_TYPE BATCH_CALC_TYPES[] =
+{
+  CALC_PAYMENT, CALC_BALANCE, CALC_NUMPAYMENTS, CALC_AMOUNT, CALC_INTEREST
+};
+static const int NUM_BATCH_CALC_TYPES = sizeof(BATCH_CALC_TYPES)/sizeof(BATCH_CALC_TYPES[0]);
+
+struct LoanWorkerPool::Worker
+{
+  explicit Worker(size_t maxBatch) :
+    items(maxBatch),
+    grouped(maxBatch),
+    amount(maxBatch),
+    interest(maxBatch),
+    payment(maxBatch),
+    initialPayment(maxBatch),
+    openingFee(maxBatch),
+    openingPercent(maxBatch),
+    periodTotal(maxBatch),
+    periodElapsed(maxBatch),
+    output(maxBatch)
+  {
+    completed.store(0, memory_order_relaxed);
+    batches.store(0, memory_order_relaxed);
+    for(int bucket = 0; bucket < LoanWorkerPoolMetrics::BATCH_SIZE_BUCKETS; ++bucket)
+    {
+      batchSizes[bucket].store(0, memory_order_relaxed);
+    }
+  }
+
+  LoanCalculator floatCalculator;
+  LoanCalculatorDouble doubleCalculator;
+  LoanCalculatorCents centsCalculator;
+  LoanBatch batch;
+
+  // The current batch, and the group of it calculated with batch
+  vector<Item> items;
+  vector<char> grouped;
+  vector<size_t> group;
+  vector<float> amount;
+  vector<float> interest;
+  vector<float> payment;
+  vector<float> initialPayment;
+  vector<float> openingFee;
+  vector<float> openingPercent;
+  vector<int> periodTotal;
+  vector<int> periodElapsed;
+  vector<float> output;
+  LoanWorkResult result;
+
+  // Only written by the worker, read by getMetrics()
+  atomic<uint64_t> completed;
+  atomic<uint64_t> batches;
+  atomic<uint64_t> batchSizes[LoanWorkerPoolMetrics::BATCH_SIZE_BUCKETS];
+};
+
+// A result that is NaN or inf is an error, whatever the precision, as the
+// cents, which throw if out of range
+static void checkResults(LoanWorkResult &result)
+{
+  for(uint32_t r = 0; r < result.numResults; ++r)
+  {
+    if(!isfinite(result.results[r]))
+    {
+      result.status = 1;
+      result.numResults = 0;
+      result.message = "Result out of range";
+      return;
+    }
+  }
+}
+
+static void completePromise(const LoanWorkResult &result, void *context)
+{
+  promise<LoanWorkResult> *resultPromise = (promise<LoanWorkResult> *) context;
+  resultPromise->set_value(result);
+  delete resultPromise;
+}
+
+LoanWorkerPool::LoanWorkerPool(int numThreads, size_t capacity, size_t maxBatch) :
+  queue_(capacity),
+  maxBatch_(maxBatch)
+{
+  if(maxBatch < 1)
+  {
+    throw invalid_argument("The batches must be of at least 1 request");
+  }
+
+  sleepers_.store(0, memory_order_relaxed);
+  stop_.store(false, memory_order_relaxed);
+  rejected_.store(0, memory_order_relaxed);
+
+  if(numThreads <= 0)
+  {
+    numThreads = (int) (thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1);
+  }
+  for(int t = 0; t < numThreads; ++t)
+  {
+    workers_.push_back(new Worker(maxBatch_));
+  }
+  for(int t = 0; t < numThreads; ++t)
+  {
+    threads_.push_back(thread(&LoanWorkerPool::workerLoop, this, ref(*workers_[t])));
+  }
+}
+
+LoanWorkerPool::~LoanWorkerPool()
+{
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_.store(true);
+  }
+  condition_.notify_all();
+
+  for(size_t t = 0; t < threads_.size(); ++t)
+  {
+    threads_[t].join();
+  }
+  for(size_t t = 0; t < workers_.size(); ++t)
+  {
+    delete workers_[t];
+  }
+}
+
+bool LoanWorkerPool::trySubmit(const LoanWorkRequest &request, LoanWorkCallback callback, void *context)
+{
+  Item item;
+  item.request = request;
+  item.callback = callback;
+  item.context = context;
+
+  if(!queue_.tryPush(item))
+  {
+    rejected_.fetch_add(1, memory_order_relaxed);
+    return false;
+  }
+
+  // Either a worker going to sleep sees the request, or it is seen to sleep,
+  // see waitForBatch()
+  atomic_thread_fence(memory_order_seq_cst);
+  if(sleepers_.load(memory_order_relaxed) > 0)
+  {
+    lock_guard<mutex> lock(mutex_);
+    condition_.notify_one();
+  }
+
+  return true;
+}
+
+void LoanWorkerPool::submit(const LoanWorkRequest &request, LoanWorkCallback callback, void *context)
+{
+  Item item;
+  item.request = request;
+  item.callback = callback;
+  item.context = context;
+
+  while(!queue_.tryPush(item))
+  {
+    this_thread::yield();
+  }
+
+  atomic_thread_fence(memory_order_seq_cst);
+  if(sleepers_.load(memory_order_relaxed) > 0)
+  {
+    lock_guard<mutex> lock(mutex_);
+    condition_.notify_one();
+  }
+}
+
+future<LoanWorkResult> LoanWorkerPool::submit(const LoanWorkRequest &request)
+{
+  promise<LoanWorkResult> *resultPromise = new promise<LoanWorkResult>;
+  future<LoanWorkResult> result = resultPromise->get_future();
+  submit(request, completePromise, resultPromise);
+  return result;
+}
+
+void LoanWorkerPool::getMetrics(LoanWorkerPoolMetrics &metrics) const
+{
+  metrics.queueDepth = queue_.getSize();
+  metrics.queueCapacity = queue_.getCapacity();
+  metrics.completed = metrics.batches = 0;
+  metrics.rejected = rejected_.load(memory_order_relaxed);
+  for(int bucket = 0; bucket < LoanWorkerPoolMetrics::BATCH_SIZE_BUCKETS; ++bucket)
+  {
+    metrics.batchSizes[bucket] = 0;
+  }
+
+  for(size_t t = 0; t < workers_.size(); ++t)
+  {
+    const Worker &worker = *workers_[t];
+    metrics.completed += worker.completed.load(memory_order_relaxed);
+    metrics.batches += worker.batches.load(memory_order_relaxed);
+    for(int bucket = 0; bucket < LoanWorkerPoolMetrics::BATCH_SIZE_BUCKETS; ++bucket)
+    {
+      metrics.batchSizes[bucket] += worker.batchSizes[bucket].load(memory_order_relaxed);
+    }
+  }
+}
+
+void LoanWorkerPool::workerLoop(Worker &worker)
+{
+  size_t count;
+  while((count = waitForBatch(worker)) > 0)
+  {
+    calculateBatch(worker, count);
+  }
+}
+
+/**
+ * The next batch, as many requests as are queued up to maxBatch_, 0 once
+ * stopped with no more requests
+ */
+size_t LoanWorkerPool::waitForBatch(Worker &worker)
+{
+  for(;;)
+  {
+    for(int spin = 0; spin < SPIN_COUNT; ++spin)
+    {
+      size_t count = queue_.popBatch(&worker.items[0], maxBatch_);
+      if(count > 0)
+      {
+        return count;
+      }
+      if(stop_.load(memory_order_relaxed))
+      {
+        return 0;
+      }
+      this_thread::yield();
+    }
+
+    // Seen to sleep before looking at the queue again, so a request submitted
+    // after this look wakes it, holding the lock until it waits
+    unique_lock<mutex> lock(mutex_);
+    sleepers_.fetch_add(1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    size_t count = queue_.popBatch(&worker.items[0], maxBatch_);
+    if(count == 0 && !stop_.load(memory_order_relaxed))
+    {
+      condition_.wait(lock);
+    }
+    sleepers_.fetch_sub(1, memory_order_relaxed);
+
+    if(count > 0)
+    {
+      return count;
+    }
+  }
+}
+
+void LoanWorkerPool::calculateBatch(Worker &worker, size_t count)
+{
+  // Every float request of these types is calculated with LoanBatch, whatever
+  // the size of its batch, so its results dont depend on how busy the pool is
+  worker.grouped.assign(count, 0);
+  for(int type = 0; type < NUM_BATCH_CALC_TYPES; ++type)
+  {
+    worker.group.clear();
+    for(size_t k = 0; k < count; ++k)
+    {
+      const LoanWorkRequest &request = worker.items[k].request;
+      if(request.precision == 0 && request.calcType == (uint32_t) BATCH_CALC_TYPES[type])
+      {
+        worker.group.push_back(k);
+        worker.grouped[k] = 1;
+      }
+    }
+
+    if(!worker.group.empty())
+    {
+      calculateGroup(worker, BATCH_CALC_TYPES[type]);
+    }
+  }
+
+  for(size_t k = 0; k < count; ++k)
+  {
+    if(!worker.grouped[k])
+    {
+      calculateSingle(worker, worker.items[k]);
+    }
+  }
+
+  int bucket = 0;
+  while(bucket < LoanWorkerPoolMetrics::BATCH_SIZE_BUCKETS - 1 && ((size_t) 2 << bucket) <= count)
+  {
+    ++bucket;
+  }
+  loanIncrement(worker.completed, count);
+  loanIncrement(worker.batches, 1);
+  loanIncrement(worker.batchSizes[bucket], 1);
+}
+
+/**
+ * The requests of worker.group, all float and of calcType, with LoanBatch,
+ * each field converted as calculateLoanRecord() converts it
+ */
+void LoanWorkerPool::calculateGroup(Worker &worker, CALC_TYPE calcType)
+{
+  size_t count = worker.group.size();
+  for(size_t j = 0; j < count; ++j)
+  {
+    const double *fields = worker.items[worker.group[j]].request.fields;
+    worker.amount[j]         = (float) fields[0];
+    worker.interest[j]       = (float) fields[1];
+    worker.periodTotal[j]    = (int) fields[2];
+    worker.payment[j]        = (float) fields[3];
+    worker.periodElapsed[j]  = (int) fields[4];
+    worker.initialPayment[j] = (float) fields[5];
+    worker.openingFee[j]     = (float) fields[6];
+    worker.openingPercent[j] = (float) fields[7];
+  }
+
+  LoanBatch &batch = worker.batch;
+  batch.reset();
+  batch.setInputs(count, &worker.amount[0], &worker.interest[0], &worker.periodTotal[0], &worker.periodElapsed[0]);
+  batch.setInitialPayments(&worker.initialPayment[0]);
+  batch.setOpeningFees(&worker.openingFee[0]);
+  batch.setOpeningPercents(&worker.openingPercent[0]);
+  if(calcType != CALC_PAYMENT)
+  {
+    batch.setPayments(&worker.payment[0]);
+  }
+
+  float *output = &worker.output[0];
+  batch.setOutputs(calcType == CALC_PAYMENT ? output : NULL,
+                   calcType == CALC_BALANCE ? output : NULL,
+                   calcType == CALC_NUMPAYMENTS ? output : NULL,
+                   calcType == CALC_AMOUNT ? output : NULL,
+                   calcType == CALC_INTEREST ? output : NULL);
+
+  LoanWorkResult &result = worker.result;
+  string failure;
+  try
+  {
+    batch.calculate();
+  }
+  catch(const exception &e)
+  {
+    failure = e.what();
+  }
+
+  for(size_t j = 0; j < count; ++j)
+  {
+    result.status = (failure.empty() ? 0 : 1);
+    result.numResults = 0;
+    result.message = failure;
+    if(result.status == 0)
+    {
+      result.results[0] = output[j];
+      result.numResults = 1;
+      if(calcType == CALC_PAYMENT)
+      {
+        // In float, as the calculator multiplies its Money
+        result.results[1] = (float) (output[j]*worker.periodTotal[j]);
+        result.numResults = 2;
+      }
+      checkResults(result);
+    }
+
+    const Item &item = worker.items[worker.group[j]];
+    item.callback(result, item.context);
+  }
+}
+
+void LoanWorkerPool::calculateSingle(Worker &worker, const Item &item)
+{
+  LoanWorkResult &result = worker.result;
+  result.status = 0;
+  result.numResults = 0;
+  result.message.clear();
+
+  try
+  {
+    CALC_TYPE calcType = (CALC_TYPE) item.request.calcType;
+    if(item.request.precision == 2)
+    {
+      result.numResults = calculateLoanRecord(calcType, worker.centsCalculator, item.request.fields, result.results);
+    }
+    else if(item.request.precision == 1)
+    {
+      result.numResults = calculateLoanRecord(calcType, worker.doubleCalculator, item.request.fields, result.results);
+    }
+    else
+    {
+      result.numResults = calculateLoanRecord(calcType, worker.floatCalculator, item.request.fields, result.results);
+    }
+    checkResults(result);
+  }
+  catch(const exception &e)
+  {
+    result.status = 1;
+    result.numResults = 0;
+    result.message = e.what();
+  }
+
+  item.callback(result, item.context);
+}
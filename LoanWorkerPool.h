@@ -0,0 +1,148 @@
+#ifndef LOANWORKERPOOL_H_INCLUDED
+#define LOANWORKERPOOL_H_INCLUDED
+
+/*
+Pool of calculation workers fed by a bounded lock-free queue, for a
+service in which many threads quote single loans at once. A calculator
+isnt thread safe, its inputs are set one by one before calculating, so
+instead of a calculator per request, or a lock around one, the requests
+are queued (LoanRequestQueue.h) and each worker owns its calculators.
+
+A worker takes the requests in batches of up to maxBatch, as many as are
+queued, so a batch is larger the busier the pool is. The float requests
+of a batch are grouped by calculation type and calculated with LoanBatch,
+the (1+i)^-N of a whole group in one vectorized call, the others one at a
+time with calculateLoanRecord(), see LoanRecord.h. The float results are
+those of LoanBatch, within a few float ulp of those of LoanCalculator. The
+requests are as those of LoanServer, a record of 8 fields, the type and
+the precision. A result that is NaN or inf, in any precision, completes
+its request with an error.
+
+Each request is completed by its callback, called by the worker once its
+batch is calculated, which must be quick and must not submit to the pool,
+or by a std::future. A worker with no requests spins a little, then
+sleeps until a request is submitted. The producers only take a lock to
+wake a worker that sleeps.
+
+The metrics are counted by each worker, and merged by getMetrics(): the
+queue depth, the requests completed, and the number of batches of each
+size, in powers of 2, from which the mean batch size.
+*/
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LoanRecord.h"
+#include "LoanRequestQueue.h"
+
+struct LoanWorkRequest
+{
+  uint32_t calcType;   // CALC_TYPE
+  uint32_t precision;  // 0 float, 1 double, 2 cents, as in LoanServerRequest
+  double fields[LOAN_RECORD_FIELDS];
+};
+
+struct LoanWorkResult
+{
+  uint32_t status;     // 0 OK, 1 error
+  uint32_t numResults;
+  double results[LOAN_RECORD_MAX_RESULTS];
+  std::string message; // the error, if status is not 0
+};
+
+typedef void (*LoanWorkCallback)(const LoanWorkResult &result, void *context);
+
+struct LoanWorkerPoolMetrics
+{
+  // Batches of 1, 2-3, 4-7, ... requests
+  static const int BATCH_SIZE_BUCKETS = 16;
+
+  size_t queueDepth;
+  size_t queueCapacity;
+  uint64_t completed;
+  uint64_t rejected;   // by trySubmit(), the queue being full
+  uint64_t batches;
+  uint64_t batchSizes[BATCH_SIZE_BUCKETS];
+
+  inline double getMeanBatchSize() const { return (batches > 0 ? (double) completed/batches : 0.0); }
+};
+
+class LoanWorkerPool
+{
+public:
+  /**
+   * numThreads <= 0 uses one thread per core, the queue holds capacity
+   * requests, rounded up to a power of 2, and a worker takes at most
+   * maxBatch at a time
+   */
+  LoanWorkerPool(int numThreads, size_t capacity = 4096, size_t maxBatch = 64);
+
+  /**
+   * Completes the requests still queued, then stops the workers
+   */
+  ~LoanWorkerPool();
+
+  inline int getNumThreads() const    { return (int) workers_.size(); }
+  inline size_t getMaxBatch() const   { return maxBatch_; }
+  inline size_t getQueueDepth() const { return queue_.getSize(); }
+
+  /**
+   * Queue request, to be completed by callback(result, context). Returns
+   * false if the queue is full
+   */
+  bool trySubmit(const LoanWorkRequest &request, LoanWorkCallback callback, void *context);
+
+  /**
+   * As trySubmit(), yielding until the queue has room
+   */
+  void submit(const LoanWorkRequest &request, LoanWorkCallback callback, void *context);
+
+  /**
+   * As submit(), completing the future
+   */
+  std::future<LoanWorkResult> submit(const LoanWorkRequest &request);
+
+  void getMetrics(LoanWorkerPoolMetrics &metrics) const;
+
+private:
+  LoanWorkerPool(); // Cant initialize default version
+  LoanWorkerPool(const LoanWorkerPool &);
+  LoanWorkerPool &operator=(const LoanWorkerPool &);
+
+  struct Item
+  {
+    LoanWorkRequest request;
+    LoanWorkCallback callback;
+    void *context;
+  };
+
+  struct Worker;
+
+  void workerLoop(Worker &worker);
+  size_t waitForBatch(Worker &worker);
+  void calculateBatch(Worker &worker, size_t count);
+  void calculateGroup(Worker &worker, CALC_TYPE calcType);
+  void calculateSingle(Worker &worker, const Item &item);
+
+  LoanRequestQueue<Item> queue_;
+  size_t maxBatch_;
+  std::vector<Worker *> workers_;
+  std::vector<std::thread> threads_;
+
+  // Waking the sleeping workers
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::atomic<int> sleepers_;
+  std::atomic<bool> stop_;
+  std::atomic<uint64_t> rejected_;
+};
+
+#endif // LOANWORKERPOOL_H_INCLUDED
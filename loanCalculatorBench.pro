@@ -0,0 +1,17 @@
+######################################################################
+# The benchmarks of the loan calculations, see LoanCalculatorBench.cpp
+# Build with: qmake loanCalculatorBench.pro && make, after loancalc.pro
+######################################################################
+
+TEMPLATE = app
+TARGET = loanCalculatorBench
+CONFIG -= qt
+CONFIG += console thread
+DEPENDPATH += .
+INCLUDEPATH += .
+QMAKE_CXXFLAGS += -std=c++11
+LIBS += -L. -lloancalc
+PRE_TARGETDEPS += libloancalc.a
+
+# Input
+SOURCES += LoanCalculatorBench.cpp
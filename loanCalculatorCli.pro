@@ -0,0 +1,18 @@
+######################################################################
+# The command line loan calculator, without the GUI or Qt
+# Build with: qmake loanCalculatorCli.pro && make, after loancalc.pro
+######################################################################
+
+TEMPLATE = app
+TARGET = loanCalculatorCli
+CONFIG -= qt
+CONFIG += console thread
+DEPENDPATH += .
+INCLUDEPATH += . ../cmdLineParser
+QMAKE_CXXFLAGS += -std=c++11
+LIBS += -L. -lloancalc -L../cmdLineParser -lCmdLineParser
+PRE_TARGETDEPS += libloancalc.a
+
+# Input
+HEADERS += LoanCalculatorCli.h
+SOURCES += LoanCalculatorCliMain.cpp LoanCalculatorCli.cpp
@@ -6,7 +6,10 @@ TEMPLATE = app
 TARGET = 
 DEPENDPATH += .
 INCLUDEPATH += .
+QMAKE_CXXFLAGS += -std=c++11
+LIBS += -L. -lloancalc
+PRE_TARGETDEPS += libloancalc.a
 
-# Input
-HEADERS += LoanCalcQtMainWindow.h LoanCalculator.h
-SOURCES += LoanCalcQtMainWindow.cpp LoanCalculator.cpp LoanCalculatorMain.cpp
+# Input, the calculations are in libloancalc, see loancalc.pro
+HEADERS += LoanCalcQtMainWindow.h LoanCalculatorCli.h
+SOURCES += LoanCalcQtMainWindow.cpp LoanCalculatorCli.cpp LoanCalculatorMain.cpp
@@ -0,0 +1,18 @@
+######################################################################
+# libloancalc, the calculations, bulk and server modes without Qt.
+# Build it first with: qmake loancalc.pro && make
+######################################################################
+
+TEMPLATE = lib
+TARGET = loancalc
+CONFIG -= qt
+CONFIG += staticlib thread
+DEPENDPATH += .
+INCLUDEPATH += .
+QMAKE_CXXFLAGS += -std=c++11
+# Compiles the instrumentation out of the hot paths, see LoanStats.h
+# DEFINES += LOAN_NO_STATS
+
+# Input
+HEADERS += LoanCalculator.h LoanTerms.h LoanConstexprMath.h LoanFormulas.h LoanProducts.h LoanBatch.h LoanMathKernels.h LoanRateSolver.h LoanRateTable.h LoanRateSchedule.h LoanCents.h LoanNumericPolicy.h LoanSchedule.h LoanCalcType.h LoanArena.h LoanVector.h LoanCounter.h LoanThreadPool.h LoanMappedFile.h LoanColumnFile.h LoanRecord.h LoanBulk.h LoanValidation.h LoanSum.h LoanPortfolio.h LoanStats.h LoanQuoteCache.h LoanSweep.h LoanRandom.h LoanSimulation.h LoanServer.h LoanRequestQueue.h LoanWorkerPool.h
+SOURCES += LoanCalculator.cpp LoanBatch.cpp LoanMathKernels.cpp LoanRateSolver.cpp LoanRateTable.cpp LoanRateSchedule.cpp LoanCents.cpp LoanSchedule.cpp LoanArena.cpp LoanThreadPool.cpp LoanMappedFile.cpp LoanColumnFile.cpp LoanBulk.cpp LoanValidation.cpp LoanPortfolio.cpp LoanStats.cpp LoanQuoteCache.cpp LoanSweep.cpp LoanSimulation.cpp LoanServer.cpp LoanWorkerPool.cpp